@@ -211,6 +211,8 @@ namespace diy
         using Block = typename detail::block_traits<Callback>::type;
         const LBCallback<Block>& f_ = f;
 
+        size_t remote_links = master.remote_links();
+
         // compile my work info
         detail::WorkInfo my_work_info = { master.communicator().rank(), -1, 0, 0, static_cast<int>(master.size()) };
         for (auto i = 0; i < master.size(); i++)
@@ -246,6 +248,74 @@ namespace diy
 
         // fix links
         fix_links(master, dynamic_assigner);
+
+        master.log->info("[{}] Load balancing: {} remote links before, {} after", master.communicator().rank(), remote_links, master.remote_links());
+    }
+
+    // load balancing using collective method, reassigning all the blocks at once
+    template<class Callback>
+    void load_balance_collective(Master&                          master,             // diy master
+                                 DynamicAssigner&                 dynamic_assigner,   // diy dynamic assigner
+                                 const Callback&                  f,                  // callback to get work for a block
+                                 std::vector<detail::MoveInfo>&   moved_blocks,       // (output) blocks that were moved
+                                 CollectiveBalance                algorithm,          // how to compute the new assignment
+                                 float                            max_migration = 1.0f) // fraction of the blocks, by count, allowed to move (0.0 - 1.0)
+    {
+        // assert that master.destroyer() exists, will be needed for moving blocks
+        if (!master.destroyer())
+        {
+            fmt::print(stderr, "DIY error: Master must have a block destroyer function in order to use load balancing. Please define one.\n");
+            abort();
+        }
+
+        using Block = typename detail::block_traits<Callback>::type;
+        const LBCallback<Block>& f_ = f;
+
+        size_t remote_links = master.remote_links();
+
+        // gather the work of all the blocks, and their neighbors if the balance weighs them
+        std::vector<Work> my_work(master.size());
+        for (auto i = 0; i < master.size(); i++)
+            my_work[i] = f_(static_cast<Block*>(master.block(i)), master.gid(i));
+
+        std::vector<detail::BlockWork>  all_blocks;
+        detail::gather_block_work(master, my_work, all_blocks);
+        if (algorithm == CollectiveBalance::diffusion && master.balance_locality() > 0)
+            detail::gather_block_neighbors(master, all_blocks);
+
+        // decide what to move where; every process computes the same moves
+        std::vector<detail::MoveInfo>   all_move_info;
+        detail::decide_moves(all_blocks, master.communicator().size(), algorithm, max_migration, master.balance_locality(), all_move_info);
+
+        detail::move_blocks(master, all_move_info);
+
+        // record the move for later record keeping
+        // keep the moved blocks record with the destination proc, since that's where the block will be
+        for (auto& m : all_move_info)
+            if (master.communicator().rank() == m.dst_proc)
+                moved_blocks.push_back(m);
+
+        // fix links
+        fix_links(master, dynamic_assigner);
+
+        master.log->info("[{}] Load balancing: {} remote links before, {} after", master.communicator().rank(), remote_links, master.remote_links());
+    }
+
+    // load balancing using collective method, with the block costs measured by master
+    inline void load_balance_collective(Master&                          master,
+                                        DynamicAssigner&                 dynamic_assigner,
+                                        std::vector<detail::MoveInfo>&   moved_blocks)
+    {
+        load_balance_collective(master, dynamic_assigner, master.measured_work(), moved_blocks);
+    }
+
+    inline void load_balance_collective(Master&                          master,
+                                        DynamicAssigner&                 dynamic_assigner,
+                                        std::vector<detail::MoveInfo>&   moved_blocks,
+                                        CollectiveBalance                algorithm,
+                                        float                            max_migration = 1.0f)
+    {
+        load_balance_collective(master, dynamic_assigner, master.measured_work(), moved_blocks, algorithm, max_migration);
     }
 
     // load balancing using sampling method
@@ -267,12 +337,15 @@ namespace diy
         using Block = typename detail::block_traits<Callback>::type;
         const LBCallback<Block>& f_ = f;
 
+        size_t remote_links = master.remote_links();
+
         // compile my work info
         detail::WorkInfo my_work_info = { master.communicator().rank(), -1, 0, 0, static_cast<int>(master.size()) };
+        std::vector<Work> my_work(master.size());
         for (auto i = 0; i < master.size(); i++)
         {
             Block* block = static_cast<Block*>(master.block(i));
-            Work w = f_(block, master.gid(i));
+            Work w = my_work[i] = f_(block, master.gid(i));
             my_work_info.proc_work += w;
             if (my_work_info.top_gid == -1 || my_work_info.top_work < w)
             {
@@ -295,7 +368,7 @@ namespace diy
 
         // move blocks
         detail::MoveInfo move_info;
-        detail::move_sample_blocks(master, aux_master, sample_work_info, my_work_info, quantile, move_info);
+        detail::move_sample_blocks(master, aux_master, sample_work_info, my_work_info, my_work, quantile, move_info);
 
         // record the move for later record keeping
         // keep the moved blocks record with the destination proc, since that's where the block will be
@@ -304,6 +377,57 @@ namespace diy
 
         // fix links
         fix_links(master, dynamic_assigner);
+
+        master.log->info("[{}] Load balancing: {} remote links before, {} after", master.communicator().rank(), remote_links, master.remote_links());
+    }
+
+    // load balancing using sampling method, with the block costs measured by master
+    inline void load_balance_sampling(Master&                         master,
+                                      DynamicAssigner&                dynamic_assigner,
+                                      std::vector<detail::MoveInfo>&  moved_blocks,
+                                      float                           sample_frac = 0.5f,
+                                      float                           quantile    = 0.8f)
+    {
+        load_balance_sampling(master, dynamic_assigner, master.measured_work(), moved_blocks, sample_frac, quantile);
+    }
+
+    // assigner that partitions the link graph of the blocks of master (collective); the blocks must have gids 0..n-1.
+    // Its assignment can seed a new decomposition, or the ranks of a DynamicAssigner to migrate the blocks to.
+    template<class Callback>
+    GraphAssigner graph_assigner(Master&                    master,
+                                 const Callback&            f,                  // callback to get work for a block
+                                 float                      imbalance = 0.05f)  // how far above the average work a process may go
+    {
+        using Block = typename detail::block_traits<Callback>::type;
+        const LBCallback<Block>& f_ = f;
+
+        std::vector<Work> my_work(master.size());
+        for (unsigned i = 0; i < master.size(); i++)
+            my_work[i] = f_(static_cast<Block*>(master.block(static_cast<int>(i))), master.gid(static_cast<int>(i)));
+
+        std::vector<detail::BlockWork>  all_blocks;
+        detail::gather_block_work(master, my_work, all_blocks);
+        detail::gather_block_neighbors(master, all_blocks);
+
+        std::vector<long long>              weights(all_blocks.size());
+        std::vector<GraphAssigner::Edge>    edges;
+        for (size_t i = 0; i < all_blocks.size(); i++)
+        {
+            if (all_blocks[i].gid != static_cast<int>(i))
+                throw std::runtime_error(fmt::format("graph_assigner() needs gids 0..{}, found {}", all_blocks.size() - 1, all_blocks[i].gid));
+            weights[i] = all_blocks[i].work;
+            for (size_t j : all_blocks[i].neighbors)
+                if (i < j)
+                    edges.emplace_back(static_cast<int>(i), static_cast<int>(j));
+        }
+
+        return GraphAssigner(master.communicator().size(), weights, edges, imbalance);
+    }
+
+    // assigner that partitions the link graph of the blocks of master, all of the same work
+    inline GraphAssigner graph_assigner(Master& master, float imbalance = 0.05f)
+    {
+        return graph_assigner(master, [](void*, int) -> Work { return 1; }, imbalance);
     }
 
 }
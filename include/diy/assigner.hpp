@@ -3,8 +3,15 @@
 
 #include <vector>
 #include <tuple>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
 
 #include "mpi.hpp"      // needed for DynamicAssigner
+#include "critical-resource.hpp"
+#include "detail/algorithms/graph-partition.hpp"
 
 namespace diy
 {
@@ -102,6 +109,114 @@ namespace diy
       void  local_gids(int rank, std::vector<int>& gids) const override;
   };
 
+  class SpaceFillingCurveAssigner: public StaticAssigner
+  {
+    public:
+     /**
+      * \ingroup Assignment
+      * \brief Assigns contiguous segments of a space-filling curve through the blocks of a regular
+      * decomposition to processes, so that the blocks of a process are close to each other (and most of their
+      * neighbors are local). `divisions` are those of the `RegularDecomposer`, whose gid order the assigner follows.
+      */
+      enum class Curve { hilbert, morton };
+
+      inline        SpaceFillingCurveAssigner(int size__, const std::vector<int>& divisions, Curve curve);
+
+      using StaticAssigner::size;
+      using StaticAssigner::nblocks;
+
+      //! O(log nblocks)
+      inline
+      int           rank(int gid) const override;
+      inline
+      void          local_gids(int rank, std::vector<int>& gids) const override;
+
+      //! the number of blocks is that of the divisions; setting it to anything else (unlike `io::read_blocks()`) throws
+      void          set_nblocks(int nblocks__) override { if (nblocks__ != nblocks()) throw std::runtime_error("The number of blocks of a SpaceFillingCurveAssigner is fixed by its divisions"); }
+
+      //! position of block gid along the curve
+      inline int    curve_position(int gid) const;
+      //! block at the given position along the curve
+      int           curve_block(int position) const     { return order_[position]; }
+
+      //! key of the block with the given coordinates along the curve through a cube of 2^bits blocks per side
+      static inline uint64_t
+                    hilbert_key(std::vector<unsigned> coords, unsigned bits);
+      static inline uint64_t
+                    morton_key(const std::vector<unsigned>& coords, unsigned bits);
+
+    private:
+      inline uint64_t   key(int gid) const;
+
+      std::vector<int>        divisions_;
+      std::vector<size_t>     axes_;                  // the dimensions with more than one division
+      unsigned                bits_ = 0;
+      Curve                   curve_;
+      std::vector<uint64_t>   keys_;                  // sorted
+      std::vector<int>        order_;                 // gids, in the order of keys_
+      ContiguousAssigner      positions_;             // assigns the positions along the curve
+  };
+
+  //! \ingroup Assignment
+  //! \brief Assigns segments of the Hilbert curve through the blocks of a regular decomposition
+  class HilbertAssigner: public SpaceFillingCurveAssigner
+  {
+    public:
+                    HilbertAssigner(int size__, const std::vector<int>& divisions):
+                      SpaceFillingCurveAssigner(size__, divisions, Curve::hilbert)      {}
+  };
+
+  //! \ingroup Assignment
+  //! \brief Assigns segments of the Morton (Z-order) curve through the blocks of a regular decomposition
+  class MortonAssigner: public SpaceFillingCurveAssigner
+  {
+    public:
+                    MortonAssigner(int size__, const std::vector<int>& divisions):
+                      SpaceFillingCurveAssigner(size__, divisions, Curve::morton)       {}
+  };
+
+  class GraphAssigner: public StaticAssigner
+  {
+    public:
+     /**
+      * \ingroup Assignment
+      * \brief Assigns blocks to processes by partitioning their communication graph: balances the weights of
+      * the blocks across the processes, while keeping the edges between them (e.g., their links) within the
+      * processes. Meant for irregular decompositions (AMR, k-d trees), where gid order says little about
+      * which blocks communicate. A built-in multilevel partitioner computes the assignment, the same on every
+      * process given the same graph. See `graph_assigner()` (in algorithms.hpp) for the graph of a `Master`.
+      */
+      using Edge = std::pair<int,int>;                  //!< pair of gids, in either order; repeat an edge to weigh it more
+
+      //! `weights[gid]` is the work of block gid; `imbalance` is how far above the average weight a process may go
+      inline        GraphAssigner(int size__, const std::vector<long long>& weights, const std::vector<Edge>& edges, float imbalance = 0.05f);
+
+      //! blocks of equal weight
+      inline        GraphAssigner(int size__, int nblocks__, const std::vector<Edge>& edges, float imbalance = 0.05f);
+
+      using StaticAssigner::size;
+      using StaticAssigner::nblocks;
+
+      int           rank(int gid) const override        { return ranks_[static_cast<size_t>(gid)]; }
+      inline
+      void          local_gids(int rank, std::vector<int>& gids) const override;
+
+      //! the number of blocks is that of the weights; setting it to anything else (unlike `io::read_blocks()`) throws
+      void          set_nblocks(int nblocks__) override { if (nblocks__ != nblocks()) throw std::runtime_error("The number of blocks of a GraphAssigner is fixed by its graph"); }
+
+      //! total weight of the edges between blocks assigned to different processes
+      long long     edge_cut() const                    { return edge_cut_; }
+      //! total weight of the blocks assigned to the process
+      long long     weight(int rank) const              { return weights_[static_cast<size_t>(rank)]; }
+
+    private:
+      inline void   partition(const std::vector<long long>& weights, const std::vector<Edge>& edges, float imbalance);
+
+      std::vector<int>        ranks_;                 // by gid
+      std::vector<long long>  weights_;               // by rank
+      long long               edge_cut_ = 0;
+  };
+
   class DynamicAssigner: public Assigner
   {
     public:
@@ -129,10 +244,37 @@ namespace diy
       std::tuple<int,int>
                     rank_offset(int gid) const                                          { return std::make_tuple(gid / div_, gid % div_); }
 
+      //! The ranks looked up are cached until the epoch changes. `set_rank()`, `set_ranks()`, and `set_nblocks()`
+      //! start a new epoch; after another process changes the assignment, call `invalidate()` (the usual
+      //! pattern, where every process sets the ranks of its blocks and then synchronizes, needs nothing extra).
+      void          invalidate()                                                        { ++cache_.access()->epoch; }
+      unsigned      epoch() const                                                       { return cache_.const_access()->epoch; }
+
     private:
+      inline void   put_rank(const int& rk, int gid);
+
+      struct Cache
+      {
+        struct Entry { int rank; unsigned epoch; };
+
+        std::unordered_map<int, Entry>  entries;
+        unsigned                        epoch = 0;
+
+        bool        find(int gid, int& rk) const
+        {
+          auto it = entries.find(gid);
+          if (it == entries.end() || it->second.epoch != epoch)
+            return false;
+          rk = it->second.rank;
+          return true;
+        }
+        void        insert(int gid, int rk, unsigned epoch_)                            { entries[gid] = Entry { rk, epoch_ }; }
+      };
+
       mpi::communicator         comm_;
       int                       div_;
       mutable mpi::window<int>  rank_map_;
+      mutable critical_resource<Cache>  cache_;
   };
 }
 
@@ -180,6 +322,180 @@ local_gids(int rank_, std::vector<int>& gids) const
   }
 }
 
+diy::SpaceFillingCurveAssigner::
+SpaceFillingCurveAssigner(int size__, const std::vector<int>& divisions, Curve curve):
+  StaticAssigner(size__, 0), divisions_(divisions), curve_(curve), positions_(size__, 0)
+{
+  long long n = 1;
+  int max_div = 1;
+  for (size_t i = 0; i < divisions_.size(); ++i)
+  {
+    if (divisions_[i] < 1)
+      throw std::runtime_error("SpaceFillingCurveAssigner needs the divisions in every dimension");
+    n *= divisions_[i];
+    if (divisions_[i] > 1)
+      axes_.push_back(i);
+    max_div = (std::max)(max_div, divisions_[i]);
+  }
+  while ((1 << bits_) < max_div)
+    ++bits_;
+  if (axes_.size() * bits_ > 64)
+    throw std::runtime_error("Too many blocks for a 64-bit SpaceFillingCurveAssigner key");
+  Assigner::set_nblocks(static_cast<int>(n));
+  positions_ = ContiguousAssigner(size__, nblocks());
+
+  std::vector<std::pair<uint64_t,int>> blocks(nblocks());
+  for (int gid = 0; gid < nblocks(); ++gid)
+    blocks[gid] = std::make_pair(key(gid), gid);
+  std::sort(blocks.begin(), blocks.end());
+
+  keys_.resize(blocks.size());
+  order_.resize(blocks.size());
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    keys_[i]  = blocks[i].first;
+    order_[i] = blocks[i].second;
+  }
+}
+
+uint64_t
+diy::SpaceFillingCurveAssigner::
+key(int gid) const
+{
+  // coordinates as in RegularDecomposer::gid_to_coords(), without the dimensions of one division
+  std::vector<unsigned> coords;
+  coords.reserve(axes_.size());
+  size_t a = 0;
+  for (size_t i = 0; i < divisions_.size(); ++i)
+  {
+    int c = gid % divisions_[i];
+    gid /= divisions_[i];
+    if (a < axes_.size() && axes_[a] == i)
+    {
+      coords.push_back(static_cast<unsigned>(c));
+      ++a;
+    }
+  }
+  return curve_ == Curve::hilbert ? hilbert_key(std::move(coords), bits_) : morton_key(coords, bits_);
+}
+
+int
+diy::SpaceFillingCurveAssigner::
+curve_position(int gid) const
+{
+  return static_cast<int>(std::lower_bound(keys_.begin(), keys_.end(), key(gid)) - keys_.begin());
+}
+
+int
+diy::SpaceFillingCurveAssigner::
+rank(int gid) const
+{
+  return positions_.rank(curve_position(gid));
+}
+
+void
+diy::SpaceFillingCurveAssigner::
+local_gids(int rank_, std::vector<int>& gids) const
+{
+  std::vector<int> positions;
+  positions_.local_gids(rank_, positions);
+  for (int p : positions)
+    gids.push_back(order_[p]);
+}
+
+// Skilling's transpose of the coordinates into the Hilbert index ("Programming the Hilbert curve", 2004),
+// with the bits of the index interleaved, most significant first
+uint64_t
+diy::SpaceFillingCurveAssigner::
+hilbert_key(std::vector<unsigned> x, unsigned bits)
+{
+  size_t n = x.size();
+  if (bits == 0 || n == 0)
+    return 0;
+
+  unsigned m = 1u << (bits - 1);
+
+  // inverse undo
+  for (unsigned q = m; q > 1; q >>= 1)
+  {
+    unsigned p = q - 1;
+    for (size_t i = 0; i < n; ++i)
+    {
+      if (x[i] & q)
+        x[0] ^= p;                              // invert
+      else
+      {
+        unsigned t = (x[0] ^ x[i]) & p;         // exchange
+        x[0] ^= t;
+        x[i] ^= t;
+      }
+    }
+  }
+
+  // Gray encode
+  for (size_t i = 1; i < n; ++i)
+    x[i] ^= x[i-1];
+  unsigned t = 0;
+  for (unsigned q = m; q > 1; q >>= 1)
+    if (x[n-1] & q)
+      t ^= q - 1;
+  for (size_t i = 0; i < n; ++i)
+    x[i] ^= t;
+
+  return morton_key(x, bits);
+}
+
+uint64_t
+diy::SpaceFillingCurveAssigner::
+morton_key(const std::vector<unsigned>& x, unsigned bits)
+{
+  uint64_t key = 0;
+  for (unsigned b = bits; b-- > 0; )
+    for (size_t i = 0; i < x.size(); ++i)
+      key = (key << 1) | ((x[i] >> b) & 1u);
+  return key;
+}
+
+diy::GraphAssigner::
+GraphAssigner(int size__, const std::vector<long long>& weights, const std::vector<Edge>& edges, float imbalance):
+  StaticAssigner(size__, static_cast<int>(weights.size()))
+{
+  partition(weights, edges, imbalance);
+}
+
+diy::GraphAssigner::
+GraphAssigner(int size__, int nblocks__, const std::vector<Edge>& edges, float imbalance):
+  StaticAssigner(size__, nblocks__)
+{
+  partition(std::vector<long long>(static_cast<size_t>(nblocks__), 1), edges, imbalance);
+}
+
+void
+diy::GraphAssigner::
+partition(const std::vector<long long>& weights, const std::vector<Edge>& edges, float imbalance)
+{
+  for (auto& e : edges)
+    if (e.first < 0 || e.second < 0 || e.first >= nblocks() || e.second >= nblocks())
+      throw std::runtime_error("GraphAssigner edge between gids outside [0, nblocks)");
+
+  detail::PartitionGraph graph = detail::make_partition_graph(weights, edges);
+  ranks_    = detail::partition_graph(graph, size(), imbalance);
+  edge_cut_ = detail::edge_cut(graph, ranks_);
+
+  weights_.assign(static_cast<size_t>(size()), 0);
+  for (size_t gid = 0; gid < ranks_.size(); ++gid)
+    weights_[static_cast<size_t>(ranks_[gid])] += weights[gid];
+}
+
+void
+diy::GraphAssigner::
+local_gids(int rank_, std::vector<int>& gids) const
+{
+  for (size_t gid = 0; gid < ranks_.size(); ++gid)
+    if (ranks_[gid] == rank_)
+      gids.push_back(static_cast<int>(gid));
+}
+
 void
 diy::DynamicAssigner::
 set_nblocks(int nblocks__)
@@ -190,68 +506,125 @@ set_nblocks(int nblocks__)
     rank_map_.unlock_all();
     rank_map_ = mpi::window<int>(comm_, div_);
     rank_map_.lock_all(mpi::nocheck);
+
+    auto cache = cache_.access();
+    cache->entries.clear();
+    ++cache->epoch;
 }
 
 std::tuple<bool,int>
 diy::DynamicAssigner::
 get_rank(int& rk, int gid) const
 {
-    // TODO: check if the gid is in cache
-
     int r,offset;
     std::tie(r,offset) = rank_offset(gid);
 
+    if (cache_.const_access()->find(gid, rk))
+        return std::make_tuple(true, r);
+
     rank_map_.get(rk, r, offset);
 
-    return std::make_tuple(false, r);        // false indicates that the data wasn't read from cache
+    return std::make_tuple(false, r);        // false indicates that the data wasn't read from cache, and rk is valid only after a flush
 }
 
 int
 diy::DynamicAssigner::
 rank(int gid) const
 {
+    unsigned current = epoch();
+
     int rk;
     auto cached_gidrk = get_rank(rk, gid);
-    int gidrk = std::get<1>(cached_gidrk);
+    if (std::get<0>(cached_gidrk))
+        return rk;
 
+    int gidrk = std::get<1>(cached_gidrk);
     rank_map_.flush_local(gidrk);
 
+    cache_.access()->insert(gid, rk, current);
+
     return rk;
 }
 
-
 std::vector<int>
 diy::DynamicAssigner::
 ranks(const std::vector<int>& gids) const
 {
-    bool all_cached = true;
     std::vector<int> result(gids.size(), -1);
-    for (size_t i = 0; i < gids.size(); ++i)
+    std::vector<int> missing;
+    unsigned current;
+    {
+        auto cache = cache_.const_access();
+        current = cache->epoch;
+        for (size_t i = 0; i < gids.size(); ++i)
+            if (!cache->find(gids[i], result[i]))
+                missing.push_back(gids[i]);
+    }
+    if (missing.empty())
+        return result;
+
+    // consecutive gids on the same target rank sit next to each other in the window: fetch each run with one get
+    std::sort(missing.begin(), missing.end());
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+
+    std::vector<std::tuple<int,int>>    runs;               // (first gid, count)
+    for (int gid : missing)
     {
-        auto cached_gidrk = get_rank(result[i], gids[i]);
-        bool cached = std::get<0>(cached_gidrk);
-        all_cached  &= cached;
+        if (!runs.empty())
+        {
+            int first = std::get<0>(runs.back()), count = std::get<1>(runs.back());
+            if (gid == first + count && gid / div_ == first / div_)
+            {
+                ++std::get<1>(runs.back());
+                continue;
+            }
+        }
+        runs.emplace_back(gid, 1);
     }
 
-    if (!all_cached)
-        rank_map_.flush_local_all();
+    std::vector<std::vector<int>>       fetched(runs.size());
+    for (size_t i = 0; i < runs.size(); ++i)
+    {
+        int r,offset;
+        std::tie(r,offset) = rank_offset(std::get<0>(runs[i]));
+        fetched[i].resize(std::get<1>(runs[i]));
+        rank_map_.get(fetched[i], r, offset);
+    }
+    rank_map_.flush_local_all();
+
+    auto cache = cache_.access();
+    for (size_t i = 0; i < runs.size(); ++i)
+        for (int j = 0; j < std::get<1>(runs[i]); ++j)
+            cache->insert(std::get<0>(runs[i]) + j, fetched[i][j], current);
+
+    for (size_t i = 0; i < gids.size(); ++i)
+        if (result[i] == -1)
+            result[i] = cache->entries[gids[i]].rank;
 
     return result;
 }
 
 void
 diy::DynamicAssigner::
-set_rank(const int& rk, int gid, bool flush)
+put_rank(const int& rk, int gid)
 {
-    // TODO: update cache
-
     int r,offset;
     std::tie(r,offset) = rank_offset(gid);
 
     rank_map_.put(rk, r, offset);
+}
+
+void
+diy::DynamicAssigner::
+set_rank(const int& rk, int gid, bool flush)
+{
+    put_rank(rk, gid);
 
     if (flush)
-        rank_map_.flush(r);
+        rank_map_.flush(std::get<0>(rank_offset(gid)));
+
+    auto cache = cache_.access();
+    cache->insert(gid, rk, ++cache->epoch);
 }
 
 void
@@ -259,8 +632,13 @@ diy::DynamicAssigner::
 set_ranks(const std::vector<std::tuple<int,int>>& rank_gids)
 {
     for (auto& rg : rank_gids)
-        set_rank(std::get<0>(rg), std::get<1>(rg), false);
+        put_rank(std::get<0>(rg), std::get<1>(rg));
     rank_map_.flush_all();
+
+    auto cache = cache_.access();
+    ++cache->epoch;
+    for (auto& rg : rank_gids)
+        cache->insert(std::get<1>(rg), std::get<0>(rg), cache->epoch);
 }
 
 #endif
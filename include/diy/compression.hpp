@@ -0,0 +1,296 @@
+#ifndef DIY_COMPRESSION_HPP
+#define DIY_COMPRESSION_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(DIY_HAS_ZSTD)
+#include <zstd.h>
+#endif
+
+#if defined(DIY_HAS_LZ4)
+#include <lz4.h>
+#endif
+
+namespace diy
+{
+  //! Compresses and decompresses byte streams. \ingroup Serialization
+  //! Codecs are stateless and may be shared between threads.
+  struct Codec
+  {
+    virtual             ~Codec()                                                            =default;
+    virtual std::string name() const                                                        =0;
+
+    //! append the compressed version of `count` bytes from `in` to `out`
+    virtual void        compress(const char* in, size_t count, std::vector<char>& out) const    =0;
+
+    //! decompress `count` bytes from `in` into `out`; `out_count` is the size of the original data
+    virtual void        decompress(const char* in, size_t count, char* out, size_t out_count) const =0;
+  };
+
+  //! Built-in LZ77-style byte compressor (LZ4-like sequence format); fast, without external dependencies.
+  struct LZCodec: public Codec
+  {
+    std::string         name() const override                                               { return "lz"; }
+    inline void         compress(const char* in, size_t count, std::vector<char>& out) const override;
+    inline void         decompress(const char* in, size_t count, char* out, size_t out_count) const override;
+
+    private:
+      static const size_t   min_match   = 4;
+      static const size_t   max_offset  = 65535;
+      static const int      hash_log    = 14;
+
+      static uint32_t       read32(const char* p)                                           { uint32_t x; std::memcpy(&x, p, sizeof(x)); return x; }
+      static uint32_t       hash(uint32_t x)                                                { return (x * 2654435761U) >> (32 - hash_log); }
+      static void           put_length(size_t len, std::vector<char>& out)                  { for (; len >= 255; len -= 255) out.push_back(static_cast<char>(255)); out.push_back(static_cast<char>(len)); }
+      inline static void    put_sequence(const char* literals, size_t nliterals, size_t offset, size_t match, std::vector<char>& out);
+  };
+
+  //! Byte-shuffle (and optional byte-wise delta) filter for arrays of fixed-size values, e.g., floats,
+  //! followed by another codec. Grouping the bytes of equal significance together exposes
+  //! the redundancy in exponents and high-order mantissa bits of smoothly varying fields.
+  struct ShuffleCodec: public Codec
+  {
+                        ShuffleCodec(size_t type_size_ = sizeof(float),
+                                     bool   delta_     = true,
+                                     std::shared_ptr<Codec> next_ = std::make_shared<LZCodec>()):
+                            type_size(type_size_), delta(delta_), next(next_)               { if (type_size == 0) throw std::invalid_argument("ShuffleCodec needs a type size of at least 1"); }
+
+    std::string         name() const override                                               { return "shuffle" + std::to_string(type_size) + (delta ? "+delta" : "") + "+" + next->name(); }
+    inline void         compress(const char* in, size_t count, std::vector<char>& out) const override;
+    inline void         decompress(const char* in, size_t count, char* out, size_t out_count) const override;
+
+    size_t                  type_size;
+    bool                    delta;
+    std::shared_ptr<Codec>  next;
+  };
+
+#if defined(DIY_HAS_ZSTD)
+  //! Codec backed by the system zstd library.
+  struct ZstdCodec: public Codec
+  {
+                        ZstdCodec(int level_ = 1): level(level_)                            {}
+
+    std::string         name() const override                                               { return "zstd"; }
+
+    void                compress(const char* in, size_t count, std::vector<char>& out) const override
+    {
+        size_t start = out.size();
+        out.resize(start + ZSTD_compressBound(count));
+        size_t n = ZSTD_compress(&out[start], out.size() - start, in, count, level);
+        if (ZSTD_isError(n))
+            throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(n));
+        out.resize(start + n);
+    }
+
+    void                decompress(const char* in, size_t count, char* out, size_t out_count) const override
+    {
+        size_t n = ZSTD_decompress(out, out_count, in, count);
+        if (ZSTD_isError(n) || n != out_count)
+            throw std::runtime_error("zstd decompression failed");
+    }
+
+    int                 level;
+  };
+#endif
+
+#if defined(DIY_HAS_LZ4)
+  //! Codec backed by the system lz4 library.
+  struct LZ4Codec: public Codec
+  {
+    std::string         name() const override                                               { return "lz4"; }
+
+    void                compress(const char* in, size_t count, std::vector<char>& out) const override
+    {
+        if (count > static_cast<size_t>(LZ4_MAX_INPUT_SIZE))
+            throw std::runtime_error("Input is too large for lz4");
+        size_t start = out.size();
+        out.resize(start + static_cast<size_t>(LZ4_compressBound(static_cast<int>(count))));
+        int n = LZ4_compress_default(in, &out[start], static_cast<int>(count), static_cast<int>(out.size() - start));
+        if (n <= 0)
+            throw std::runtime_error("lz4 compression failed");
+        out.resize(start + static_cast<size_t>(n));
+    }
+
+    void                decompress(const char* in, size_t count, char* out, size_t out_count) const override
+    {
+        int n = LZ4_decompress_safe(in, out, static_cast<int>(count), static_cast<int>(out_count));
+        if (n < 0 || static_cast<size_t>(n) != out_count)
+            throw std::runtime_error("lz4 decompression failed");
+    }
+  };
+#endif
+
+  //! The fastest codec available: lz4 or zstd, if DIY was built with them, the built-in LZ otherwise.
+  inline std::shared_ptr<Codec> default_codec()
+  {
+#if defined(DIY_HAS_LZ4)
+    return std::make_shared<LZ4Codec>();
+#elif defined(DIY_HAS_ZSTD)
+    return std::make_shared<ZstdCodec>();
+#else
+    return std::make_shared<LZCodec>();
+#endif
+  }
+}
+
+// Sequence format: token (literal length << 4 | (match length - 4)), with
+// lengths >= 15 continued in 255-terminated bytes; literals; 2-byte offset;
+// the stream ends with a sequence of literals only.
+void
+diy::LZCodec::
+put_sequence(const char* literals, size_t nliterals, size_t offset, size_t match, std::vector<char>& out)
+{
+    size_t ml = match ? match - min_match : 0;
+    out.push_back(static_cast<char>(((nliterals < 15 ? nliterals : 15) << 4) | (ml < 15 ? ml : 15)));
+    if (nliterals >= 15)
+        put_length(nliterals - 15, out);
+    out.insert(out.end(), literals, literals + nliterals);
+
+    if (!match)
+        return;
+
+    out.push_back(static_cast<char>(offset & 0xff));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (ml >= 15)
+        put_length(ml - 15, out);
+}
+
+void
+diy::LZCodec::
+compress(const char* in, size_t count, std::vector<char>& out) const
+{
+    if (count == 0)
+        return;
+
+    out.reserve(out.size() + count / 2 + 16);
+
+    std::vector<uint32_t> table(size_t(1) << hash_log, 0);     // position + 1 of the last occurrence of a hash
+
+    size_t anchor = 0, ip = 0;
+    while (ip + min_match <= count)
+    {
+        uint32_t  x = read32(in + ip);
+        uint32_t& h = table[hash(x)];
+        size_t    candidate = h;
+        h = static_cast<uint32_t>(ip + 1);
+
+        if (candidate && ip - (candidate - 1) <= max_offset && read32(in + candidate - 1) == x)
+        {
+            size_t m   = candidate - 1;
+            size_t len = min_match;
+            while (ip + len < count && in[m + len] == in[ip + len])
+                ++len;
+
+            put_sequence(in + anchor, ip - anchor, ip - m, len, out);
+            ip    += len;
+            anchor = ip;
+        } else
+            ip += 1 + ((ip - anchor) >> 6);                     // skip faster through incompressible data
+    }
+
+    if (anchor < count)
+        put_sequence(in + anchor, count - anchor, 0, 0, out);
+}
+
+void
+diy::LZCodec::
+decompress(const char* in, size_t count, char* out, size_t out_count) const
+{
+    auto corrupt = []() { throw std::runtime_error("Corrupt LZ stream"); };
+
+    const unsigned char* ip  = reinterpret_cast<const unsigned char*>(in);
+    const unsigned char* end = ip + count;
+    size_t op = 0;
+
+    auto get_length = [&](size_t len)
+    {
+        if (len < 15)
+            return len;
+        unsigned char b;
+        do
+        {
+            if (ip == end) corrupt();
+            b = *ip++;
+            len += b;
+        } while (b == 255);
+        return len;
+    };
+
+    while (op < out_count)
+    {
+        if (ip == end) corrupt();
+        unsigned char token = *ip++;
+
+        size_t nliterals = get_length(token >> 4);
+        if (nliterals > static_cast<size_t>(end - ip) || nliterals > out_count - op) corrupt();
+        std::memcpy(out + op, ip, nliterals);
+        ip += nliterals;
+        op += nliterals;
+
+        if (op == out_count)
+            break;
+
+        if (end - ip < 2) corrupt();
+        size_t offset = static_cast<size_t>(ip[0]) | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        size_t len = get_length(token & 0xf) + min_match;
+        if (offset == 0 || offset > op || len > out_count - op) corrupt();
+
+        // byte by byte: the match may overlap the output being produced
+        const char* match = out + op - offset;
+        for (size_t i = 0; i < len; ++i)
+            out[op + i] = match[i];
+        op += len;
+    }
+}
+
+void
+diy::ShuffleCodec::
+compress(const char* in, size_t count, std::vector<char>& out) const
+{
+    size_t n = count / type_size;              // number of values; the remaining bytes are copied as is
+    std::vector<char> shuffled(count);
+    for (size_t b = 0; b < type_size; ++b)
+    {
+        char* plane = &shuffled[b * n];
+        char  prev  = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            char x = in[i * type_size + b];
+            plane[i] = delta ? static_cast<char>(x - prev) : x;
+            prev = x;
+        }
+    }
+    std::copy(in + n * type_size, in + count, shuffled.begin() + static_cast<std::ptrdiff_t>(n * type_size));
+
+    next->compress(shuffled.data(), count, out);
+}
+
+void
+diy::ShuffleCodec::
+decompress(const char* in, size_t count, char* out, size_t out_count) const
+{
+    std::vector<char> shuffled(out_count);
+    next->decompress(in, count, shuffled.data(), out_count);
+
+    size_t n = out_count / type_size;
+    for (size_t b = 0; b < type_size; ++b)
+    {
+        const char* plane = &shuffled[b * n];
+        char        prev  = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            char x = delta ? static_cast<char>(plane[i] + prev) : plane[i];
+            out[i * type_size + b] = x;
+            prev = x;
+        }
+    }
+    std::copy(shuffled.begin() + static_cast<std::ptrdiff_t>(n * type_size), shuffled.end(), out + n * type_size);
+}
+
+#endif
@@ -3,12 +3,15 @@
 
 #include <vector>
 #include <algorithm>
+#include <functional>
 #include <iostream>
 #include <cmath>
 #include <sstream>
 #include <stdexcept>
+#include <type_traits>
 
 #include "link.hpp"
+#include "thread.hpp"
 #include "assigner.hpp"
 #include "master.hpp"
 
@@ -158,6 +161,9 @@ namespace detail
     typedef         std::vector<Coordinate>                         CoordinateVector;
     typedef         std::vector<int>                                DivisionsVector;
 
+    //! cost of a choice of divisions; see `min_halo()`
+    using DivisionsCost = std::function<double(const RegularDecomposer&, const DivisionsVector&)>;
+
     /// @param dim        dimensionality of the decomposition
     /// @param domain     bounds of global domain
     /// @param nblocks    total number of global blocks
@@ -166,16 +172,21 @@ namespace detail
     /// @param ghosts     indicates how many ghosts to use in each dimension
     /// @param divisions  indicates how many cuts to make along each dimension
     ///                   (0 means "no constraint," i.e., leave it up to the algorithm)
+    /// @param divisions_cost if given, the unconstrained divisions are those of least cost among all
+    ///                   the factorizations of the number of blocks (e.g., `min_halo`); otherwise the
+    ///                   factors go, largest first, to the dimension with the largest blocks
                     RegularDecomposer(int               dim_,
                                       const Bounds&     domain_,
                                       int               nblocks_,
-                                      BoolVector        share_face_ = BoolVector(),
-                                      BoolVector        wrap_       = BoolVector(),
-                                      CoordinateVector  ghosts_     = CoordinateVector(),
-                                      DivisionsVector   divisions_  = DivisionsVector()):
+                                      BoolVector        share_face_     = BoolVector(),
+                                      BoolVector        wrap_           = BoolVector(),
+                                      CoordinateVector  ghosts_         = CoordinateVector(),
+                                      DivisionsVector   divisions_      = DivisionsVector(),
+                                      DivisionsCost     divisions_cost_ = DivisionsCost()):
                       dim(dim_), domain(domain_), nblocks(nblocks_),
                       share_face(share_face_),
-                      wrap(wrap_), ghosts(ghosts_), divisions(divisions_)
+                      wrap(wrap_), ghosts(ghosts_), divisions(divisions_),
+                      divisions_cost(divisions_cost_)
     {
       if ((int) share_face.size() < dim)  share_face.resize(dim);
       if ((int) wrap.size() < dim)        wrap.resize(dim);
@@ -210,6 +221,37 @@ namespace detail
 
     static void     factor(std::vector<unsigned>& factors, int n);
 
+    //! volume of the ghost regions of all the blocks, i.e., what one exchange of ghosts moves, for the given
+    //! divisions; without any ghosts, counts one layer of them (the area of the faces between the blocks)
+    double          halo_volume(const DivisionsVector& divs) const;
+    //! predicted bytes moved by one exchange of ghosts, with bytes_per_cell per unit of volume
+    double          halo_bytes(double bytes_per_cell = 1.) const                { return halo_volume(divisions) * bytes_per_cell; }
+
+    //! `DivisionsCost` that minimizes the halo volume
+    static double   min_halo(const RegularDecomposer& decomposer, const DivisionsVector& divs)     { return decomposer.halo_volume(divs); }
+
+    // Non-uniform split planes: the blocks keep their grid (links, gids, partners), but not their sizes
+
+    //! set the split planes along axis: divisions[axis] + 1 increasing coordinates, from domain.min[axis]
+    //! to domain.max[axis] (domain.max[axis] + 1 for discrete bounds); block c starts at planes[c]
+    void            set_cuts(int axis, const CoordinateVector& planes);
+    //! place the split planes along axis so that the slabs between them carry equal cost; histogram[j] is
+    //! the cost of the j-th of histogram.size() equal bins spanning the domain along axis
+    void            balance_cuts(int axis, const std::vector<double>& histogram);
+    //! place the split planes in every dimension from a coarse cost field, the cost of every cell of a grid
+    //! of the given shape spanning the domain (first dimension varying fastest), minimizing the largest block cost
+    void            balance_cuts(const std::vector<double>& cost, const DivisionsVector& shape);
+    //! cost of every block (by gid) under a coarse cost field, as in `balance_cuts()`; a cell counts for the block
+    //! that contains its center
+    std::vector<double> block_costs(const std::vector<double>& cost, const DivisionsVector& shape) const;
+
+    //! extent of block c along axis, with the uniform split or the cuts
+    Coordinate      block_from(int axis, int c) const;
+    Coordinate      block_to  (int axis, int c) const;
+    //! the blocks along axis that contain x are [block_lower(), block_upper()) (clamp to [0, divisions[axis]))
+    int             block_lower(int axis, Coordinate x) const;
+    int             block_upper(int axis, Coordinate x) const;
+
     // Point to GIDs functions
     template<class Point>
     void            point_to_gids(std::vector<int>& gids, const Point& p) const;
@@ -221,6 +263,20 @@ namespace detail
     template<class Point>
     int             num_gids(const Point& p) const;
 
+    //! batched `point_to_gid()`: gids[k] is the block containing point k (-1 outside the domain), for n points
+    //! with coordinate i of point k at columns[i][k]; splits batches of more than `min_batch` points per thread
+    //! among up to `threads` threads
+    template<class T>
+    void            points_to_gids(const T* const* columns, size_t n, int* gids, int threads = 1) const;
+    //! also fills ranks[k] = assigner.rank(gids[k]) (-1 outside the domain)
+    template<class T>
+    void            points_to_gids(const T* const* columns, size_t n, int* gids, const StaticAssigner& assigner, int* ranks, int threads = 1) const;
+    //! batched `point_to_gid()` of interleaved coordinates: point k at points[k*dim .. (k+1)*dim)
+    template<class T>
+    void            points_to_gids(const T* points, size_t n, int* gids, int threads = 1) const;
+
+    static const size_t min_batch = 16384;
+
     template<class Point>
     void            top_bottom(int& top, int& bottom, const Point& p, int axis) const;
 
@@ -232,7 +288,21 @@ namespace detail
     BoolVector        wrap;
     CoordinateVector  ghosts;
     DivisionsVector   divisions;
-
+    DivisionsCost     divisions_cost;
+    std::vector<CoordinateVector>   cuts;       //!< split planes, by dimension; empty for the uniform split
+
+    private:
+      bool          has_cuts(int axis) const                                    { return static_cast<int>(cuts.size()) > axis && !cuts[axis].empty(); }
+      Coordinate    domain_end(int axis) const                                  { return domain.max[axis] + (std::is_integral<Coordinate>::value ? 1 : 0); }
+      Coordinate    bin_boundary(int axis, double t, int nbins) const;
+      void          fix_cuts(CoordinateVector& planes) const;
+      void          bin_blocks(const DivisionsVector& shape, std::vector<DivisionsVector>& blocks) const;
+      CoordinateVector  bottleneck_cuts(int axis, const std::vector<double>& cost, const DivisionsVector& shape) const;
+
+      template<class T>
+      void          points_to_gids_chunk(const T* const* columns, size_t n, int* gids) const;
+      template<class F>
+      void          parallel_for(size_t n, int threads, const F& f) const;
   };
 
   /**
@@ -519,8 +589,8 @@ fill_bounds(Bounds& bounds,                  //!< (output) bounds
 {
   for (int i = 0; i < dim; ++i)
   {
-    bounds.min[i] = detail::BoundsHelper<Bounds>::from(coords[i], divisions[i], domain.min[i], domain.max[i], share_face[i]);
-    bounds.max[i] = detail::BoundsHelper<Bounds>::to  (coords[i], divisions[i], domain.min[i], domain.max[i], share_face[i]);
+    bounds.min[i] = block_from(i, coords[i]);
+    bounds.max[i] = block_to  (i, coords[i]);
   }
 
   if (!add_ghosts)
@@ -604,6 +674,58 @@ fill_divisions(std::vector<int>& divisions_) const
     if (c == (int) divisions_.size())               // nothing to do; user provided all divs
         return;
 
+    if (divisions_cost)
+    {
+        // try every way to spread the remaining blocks over the unconstrained dimensions
+        std::vector<int> free_dims;
+        for (int i = 0; i < dim; ++i)
+            if (divisions_[i] == 0)
+                free_dims.push_back(i);
+
+        // the blocks along dimension i must not be empty (only a problem for discrete bounds)
+        auto fits = [this](int i, int n)
+        {
+            return detail::BoundsHelper<Bounds>::to  (0, n, domain.min[i], domain.max[i], share_face[i]) >=
+                   detail::BoundsHelper<Bounds>::from(0, n, domain.min[i], domain.max[i], share_face[i]);
+        };
+
+        DivisionsVector candidate = divisions_, best;
+        double          best_cost = 0;
+        std::function<void(size_t, int)> search = [&](size_t k, int rest)
+        {
+            int i = free_dims[k];
+            if (k + 1 == free_dims.size())
+            {
+                if (!fits(i, rest))
+                    return;
+                candidate[i] = rest;
+                double cost = divisions_cost(*this, candidate);
+                if (best.empty() || cost < best_cost)
+                {
+                    best      = candidate;
+                    best_cost = cost;
+                }
+                return;
+            }
+            for (int n = 1; n <= rest; ++n)
+                if (rest % n == 0 && fits(i, n))
+                {
+                    candidate[i] = n;
+                    search(k + 1, rest / n);
+                }
+        };
+        search(0, nblocks / prod);
+
+        if (best.empty())
+        {
+            std::ostringstream oss;
+            oss << "Unable to decompose domain into " << nblocks << " blocks";
+            throw std::runtime_error(oss.str());
+        }
+        divisions_ = best;
+        return;
+    }
+
     // factor number of blocks left in unconstrained dimensions
     // factorization is sorted from smallest to largest factors
     std::vector<unsigned> factors;
@@ -683,6 +805,355 @@ factor(std::vector<unsigned>& factors, int n)
     }
 }
 
+template<class Bounds>
+double
+diy::RegularDecomposer<Bounds>::
+halo_volume(const DivisionsVector& divs) const
+{
+    bool no_ghosts = true;
+    for (int i = 0; i < dim; ++i)
+        if (ghosts[i] != 0)
+            no_ghosts = false;
+
+    // the blocks form a grid, so the total volume of the blocks with their ghosts is a product over the dimensions
+    // of their extents with the ghosts on the sides that have neighbors
+    double with_ghosts = 1, without_ghosts = 1;
+    for (int i = 0; i < dim; ++i)
+    {
+        double extent = static_cast<double>(domain.max[i] - domain.min[i]) + (std::is_integral<Coordinate>::value ? 1 : 0);
+        double ghost  = no_ghosts ? 1 : static_cast<double>(ghosts[i]);
+        int    sides  = 2*(divs[i] - 1) + (wrap[i] ? 2 : 0);
+        with_ghosts    *= extent + ghost * sides;
+        without_ghosts *= extent;
+    }
+    return with_ghosts - without_ghosts;
+}
+
+template<class Bounds>
+typename diy::RegularDecomposer<Bounds>::Coordinate
+diy::RegularDecomposer<Bounds>::
+block_from(int axis, int c) const
+{
+    if (!has_cuts(axis))
+        return detail::BoundsHelper<Bounds>::from(c, divisions[axis], domain.min[axis], domain.max[axis], share_face[axis]);
+    return cuts[axis][c];
+}
+
+template<class Bounds>
+typename diy::RegularDecomposer<Bounds>::Coordinate
+diy::RegularDecomposer<Bounds>::
+block_to(int axis, int c) const
+{
+    if (!has_cuts(axis))
+        return detail::BoundsHelper<Bounds>::to(c, divisions[axis], domain.min[axis], domain.max[axis], share_face[axis]);
+    if (!std::is_integral<Coordinate>::value)
+        return cuts[axis][c + 1];
+    if (c == divisions[axis] - 1)
+        return domain.max[axis];
+    return cuts[axis][c + 1] - (share_face[axis] ? 0 : 1);
+}
+
+template<class Bounds>
+int
+diy::RegularDecomposer<Bounds>::
+block_lower(int axis, Coordinate x) const
+{
+    if (!has_cuts(axis))
+        return detail::BoundsHelper<Bounds>::lower(x, divisions[axis], domain.min[axis], domain.max[axis], share_face[axis]);
+
+    // the last block starting at or before x, or the one before it, if they share x
+    const CoordinateVector& planes = cuts[axis];
+    int c = static_cast<int>(std::upper_bound(planes.begin(), planes.end(), x) - planes.begin()) - 1;
+    if (c > 0 && planes[c] == x && (share_face[axis] || !std::is_integral<Coordinate>::value))
+        --c;
+    return c;
+}
+
+template<class Bounds>
+int
+diy::RegularDecomposer<Bounds>::
+block_upper(int axis, Coordinate x) const
+{
+    if (!has_cuts(axis))
+        return detail::BoundsHelper<Bounds>::upper(x, divisions[axis], domain.min[axis], domain.max[axis], share_face[axis]);
+
+    const CoordinateVector& planes = cuts[axis];
+    return static_cast<int>(std::upper_bound(planes.begin(), planes.end(), x) - planes.begin());
+}
+
+template<class Bounds>
+void
+diy::RegularDecomposer<Bounds>::
+set_cuts(int axis, const CoordinateVector& planes)
+{
+    if (static_cast<int>(planes.size()) != divisions[axis] + 1)
+        throw std::runtime_error("Number of cuts doesn't match the divisions");
+    if (planes.front() != domain.min[axis] || planes.back() != domain_end(axis))
+        throw std::runtime_error("Cuts don't span the domain");
+    for (size_t c = 1; c < planes.size(); ++c)
+        if (planes[c] <= planes[c-1])
+            throw std::runtime_error("Cuts must be increasing");
+
+    if (static_cast<int>(cuts.size()) < dim)
+        cuts.resize(dim);
+    cuts[axis] = planes;
+}
+
+// coordinate at t of nbins bins spanning the domain along axis
+template<class Bounds>
+typename diy::RegularDecomposer<Bounds>::Coordinate
+diy::RegularDecomposer<Bounds>::
+bin_boundary(int axis, double t, int nbins) const
+{
+    double x = static_cast<double>(domain.min[axis]) + static_cast<double>(domain_end(axis) - domain.min[axis]) * t / nbins;
+    return static_cast<Coordinate>(std::is_integral<Coordinate>::value ? std::floor(x + .5) : x);
+}
+
+// leave at least one cell between discrete cuts
+template<class Bounds>
+void
+diy::RegularDecomposer<Bounds>::
+fix_cuts(CoordinateVector& planes) const
+{
+    if (!std::is_integral<Coordinate>::value)
+        return;
+
+    size_t n = planes.size();
+    for (size_t c = 1; c + 1 < n; ++c)
+        planes[c] = (std::max)(planes[c], static_cast<Coordinate>(planes[c-1] + 1));
+    for (size_t c = n - 2; c > 0; --c)
+        planes[c] = (std::min)(planes[c], static_cast<Coordinate>(planes[c+1] - 1));
+}
+
+template<class Bounds>
+void
+diy::RegularDecomposer<Bounds>::
+balance_cuts(int axis, const std::vector<double>& histogram)
+{
+    int n = static_cast<int>(histogram.size());
+    int d = divisions[axis];
+    if (n == 0)
+        throw std::runtime_error("Empty cost histogram");
+
+    std::vector<double> prefix(n + 1, 0);
+    for (int j = 0; j < n; ++j)
+        prefix[j+1] = prefix[j] + histogram[j];
+    double total = prefix[n];
+
+    // cut where the cumulative cost reaches c/d of the total, spreading the cost of a bin evenly within it
+    CoordinateVector planes(d + 1);
+    planes[0] = domain.min[axis];
+    planes[d] = domain_end(axis);
+    int j = 0;
+    for (int c = 1; c < d; ++c)
+    {
+        double t;
+        if (total <= 0)
+            t = static_cast<double>(n) * c / d;
+        else
+        {
+            double target = total * c / d;
+            while (j + 1 < n && prefix[j+1] < target)
+                ++j;
+            t = j + (histogram[j] > 0 ? (std::min)(1., (target - prefix[j]) / histogram[j]) : 0);
+        }
+        planes[c] = bin_boundary(axis, t, n);
+    }
+    fix_cuts(planes);
+    set_cuts(axis, planes);
+}
+
+// the block of every bin (by its center) of a grid of the given shape, along each axis
+template<class Bounds>
+void
+diy::RegularDecomposer<Bounds>::
+bin_blocks(const DivisionsVector& shape, std::vector<DivisionsVector>& blocks) const
+{
+    blocks.resize(dim);
+    for (int axis = 0; axis < dim; ++axis)
+    {
+        blocks[axis].resize(shape[axis]);
+        for (int j = 0; j < shape[axis]; ++j)
+        {
+            double     x      = static_cast<double>(domain.min[axis]) + static_cast<double>(domain_end(axis) - domain.min[axis]) * (j + .5) / shape[axis];
+            Coordinate center = static_cast<Coordinate>(std::is_integral<Coordinate>::value ? std::floor(x) : x);
+            blocks[axis][j]   = (std::max)(0, (std::min)(divisions[axis] - 1, block_upper(axis, center) - 1));
+        }
+    }
+}
+
+template<class Bounds>
+std::vector<double>
+diy::RegularDecomposer<Bounds>::
+block_costs(const std::vector<double>& cost, const DivisionsVector& shape) const
+{
+    std::vector<DivisionsVector> blocks;
+    bin_blocks(shape, blocks);
+
+    std::vector<double> costs(nblocks, 0);
+    DivisionsVector cell(dim, 0), coords(dim);
+    for (size_t k = 0; k < cost.size(); ++k)
+    {
+        for (int i = 0; i < dim; ++i)
+            coords[i] = blocks[i][cell[i]];
+        costs[coords_to_gid(coords)] += cost[k];
+
+        for (int i = 0; i < dim && ++cell[i] == shape[i]; ++i)
+            cell[i] = 0;
+    }
+    return costs;
+}
+
+// cuts along axis, at the boundaries of the bins, that minimize the cost of the most expensive block, keeping
+// the other cuts: bisect on the largest cost, packing as many bins into every slab as it allows
+template<class Bounds>
+typename diy::RegularDecomposer<Bounds>::CoordinateVector
+diy::RegularDecomposer<Bounds>::
+bottleneck_cuts(int axis, const std::vector<double>& cost, const DivisionsVector& shape) const
+{
+    std::vector<DivisionsVector> blocks;
+    bin_blocks(shape, blocks);
+
+    // cost of every bin along axis in every column of blocks across it
+    int    nbins   = shape[axis];
+    int    d       = divisions[axis];
+    size_t columns = static_cast<size_t>(nblocks / d);
+    std::vector<double> bins(nbins * columns, 0);
+    DivisionsVector cell(dim, 0);
+    for (size_t k = 0; k < cost.size(); ++k)
+    {
+        size_t column = 0;
+        for (int i = dim - 1; i >= 0; --i)
+            if (i != axis)
+                column = column * divisions[i] + blocks[i][cell[i]];
+        bins[cell[axis] * columns + column] += cost[k];
+
+        for (int i = 0; i < dim && ++cell[i] == shape[i]; ++i)
+            cell[i] = 0;
+    }
+
+    // first bins of the slabs, packed under the largest cost
+    auto pack = [&](double largest, std::vector<int>& starts)
+    {
+        std::vector<double> sums(columns, 0);
+        starts.assign(1, 0);
+        for (int j = 0; j < nbins; ++j)
+        {
+            const double* bin = &bins[j * columns];
+            bool fits = true;
+            for (size_t b = 0; b < columns && fits; ++b)
+                fits = sums[b] + bin[b] <= largest;
+            if (!fits && j > 0)
+            {
+                starts.push_back(j);
+                std::fill(sums.begin(), sums.end(), 0.);
+            }
+            for (size_t b = 0; b < columns; ++b)
+                sums[b] += bin[b];
+        }
+        return static_cast<int>(starts.size());
+    };
+
+    double lo = 0, hi = 0;
+    for (double x : bins)
+        lo = (std::max)(lo, x);
+    std::vector<double> totals(columns, 0);
+    for (int j = 0; j < nbins; ++j)
+        for (size_t b = 0; b < columns; ++b)
+            totals[b] += bins[j * columns + b];
+    for (double x : totals)
+        hi = (std::max)(hi, x);
+
+    std::vector<int> starts;
+    if (pack(lo, starts) <= d)
+        hi = lo;
+    for (int iteration = 0; iteration < 64 && hi - lo > 1e-9 * hi; ++iteration)
+    {
+        double mid = (lo + hi) / 2;
+        if (pack(mid, starts) <= d)
+            hi = mid;
+        else
+            lo = mid;
+    }
+    pack(hi, starts);
+
+    // fewer slabs than divisions: split the widest ones
+    while (static_cast<int>(starts.size()) < d)
+    {
+        size_t widest = 0;
+        int    width  = 0;
+        for (size_t s = 0; s < starts.size(); ++s)
+        {
+            int w = (s + 1 < starts.size() ? starts[s+1] : nbins) - starts[s];
+            if (w > width)
+            {
+                widest = s;
+                width  = w;
+            }
+        }
+        starts.insert(starts.begin() + widest + 1, starts[widest] + width / 2);
+    }
+
+    CoordinateVector planes(d + 1);
+    for (int c = 0; c < d; ++c)
+        planes[c] = bin_boundary(axis, starts[c], nbins);
+    planes[0] = domain.min[axis];
+    planes[d] = domain_end(axis);
+    fix_cuts(planes);
+    return planes;
+}
+
+template<class Bounds>
+void
+diy::RegularDecomposer<Bounds>::
+balance_cuts(const std::vector<double>& cost, const DivisionsVector& shape)
+{
+    size_t ncells = 1;
+    for (int i = 0; i < dim; ++i)
+        ncells *= static_cast<size_t>(shape.at(i));
+    if (static_cast<int>(shape.size()) != dim || ncells != cost.size() || ncells == 0)
+        throw std::runtime_error("Cost field doesn't match its shape");
+
+    // start from the marginal costs along each axis
+    for (int axis = 0; axis < dim; ++axis)
+    {
+        std::vector<double> histogram(shape[axis], 0);
+        DivisionsVector cell(dim, 0);
+        for (size_t k = 0; k < ncells; ++k)
+        {
+            histogram[cell[axis]] += cost[k];
+            for (int i = 0; i < dim && ++cell[i] == shape[i]; ++i)
+                cell[i] = 0;
+        }
+        balance_cuts(axis, histogram);
+    }
+
+    // then move the cuts of one axis at a time to shrink the most expensive block, while that helps
+    auto largest = [&]() { std::vector<double> costs = block_costs(cost, shape); return *std::max_element(costs.begin(), costs.end()); };
+    double best = largest();
+    for (int round = 0; round < 4; ++round)
+    {
+        bool improved = false;
+        for (int axis = 0; axis < dim; ++axis)
+        {
+            if (divisions[axis] == 1 || shape[axis] < divisions[axis])
+                continue;
+
+            CoordinateVector previous = cuts[axis];
+            set_cuts(axis, bottleneck_cuts(axis, cost, shape));
+            double x = largest();
+            if (x < best)
+            {
+                best     = x;
+                improved = true;
+            } else
+                cuts[axis] = previous;
+        }
+        if (!improved)
+            break;
+    }
+}
+
 // Point to GIDs
 // TODO: add an optional ghosts argument to ignore ghosts (if we want to find the true owners, or something like that)
 template<class Bounds>
@@ -739,7 +1210,7 @@ point_to_gid(const Point& p) const
       else if (x < domain.min[axis] || x > domain.max[axis])
           return -1;
 
-      int bottom  = detail::BoundsHelper<Bounds>::lower(x, divisions[axis], domain.min[axis], domain.max[axis], share_face[axis]);
+      int bottom  = block_lower(axis, x);
           bottom  = (std::max)(0, (std::min)(divisions[axis] - 1, bottom));
 
       // coupled with coords_to_gid
@@ -793,8 +1264,8 @@ top_bottom(int& top, int& bottom, const Point& p, int axis) const
         Coordinate l_wrapped = l - static_cast<Coordinate>(l_shift) * period;
         Coordinate r_wrapped = r - static_cast<Coordinate>(r_shift) * period;
 
-        bottom = l_shift * divisions[axis] + detail::BoundsHelper<Bounds>::lower(l_wrapped, divisions[axis], domain.min[axis], domain.max[axis], share_face[axis]);
-        top    = r_shift * divisions[axis] + detail::BoundsHelper<Bounds>::upper(r_wrapped, divisions[axis], domain.min[axis], domain.max[axis], share_face[axis]);
+        bottom = l_shift * divisions[axis] + block_lower(axis, l_wrapped);
+        top    = r_shift * divisions[axis] + block_upper(axis, r_wrapped);
 
         if (top - bottom > divisions[axis])
         {
@@ -803,13 +1274,190 @@ top_bottom(int& top, int& bottom, const Point& p, int axis) const
         }
     } else
     {
-        top     = detail::BoundsHelper<Bounds>::upper(r, divisions[axis], domain.min[axis], domain.max[axis], share_face[axis]);
-        bottom  = detail::BoundsHelper<Bounds>::lower(l, divisions[axis], domain.min[axis], domain.max[axis], share_face[axis]);
+        top     = block_upper(axis, r);
+        bottom  = block_lower(axis, l);
         bottom  = (std::max)(0, bottom);
         top     = (std::min)(divisions[axis], top);
     }
 }
 
+// point_to_gid() of up to chunk points at a time, one axis at a time, with branch-free loops along the points
+// (that the compiler can vectorize)
+template<class Bounds>
+template<class T>
+void
+diy::RegularDecomposer<Bounds>::
+points_to_gids_chunk(const T* const* columns, size_t n, int* gids) const
+{
+    static const size_t chunk = 256;
+
+    Coordinate      x[chunk];
+    int             c[chunk];
+    unsigned char   outside[chunk];
+
+    for (size_t start = 0; start < n; start += chunk)
+    {
+        size_t m = (std::min)(chunk, n - start);
+        int*   g = gids + start;
+        for (size_t k = 0; k < m; ++k)
+        {
+            g[k]       = 0;
+            outside[k] = 0;
+        }
+
+        for (int axis = dim - 1; axis >= 0; --axis)
+        {
+            const T*    column = columns[axis] + start;
+            int         d      = divisions[axis];
+            Coordinate  min    = domain.min[axis],
+                        max    = domain.max[axis];
+
+            for (size_t k = 0; k < m; ++k)
+                x[k] = static_cast<Coordinate>(column[k]);
+
+            if (wrap[axis])
+                for (size_t k = 0; k < m; ++k)
+                    x[k] = detail::normalize_wrap(x[k], min, max);
+            else
+                for (size_t k = 0; k < m; ++k)
+                    outside[k] |= static_cast<unsigned char>((x[k] < min) | (x[k] > max));
+
+            // block_lower(), for the points inside the domain
+            if (has_cuts(axis))
+            {
+                const Coordinate* planes = cuts[axis].data();
+                bool              shared = share_face[axis] || !std::is_integral<Coordinate>::value;
+                for (size_t k = 0; k < m; ++k)
+                {
+                    const Coordinate* base = planes;
+                    for (size_t len = static_cast<size_t>(d) + 1; len > 1; len -= len / 2)
+                        base = base[len / 2] <= x[k] ? base + len / 2 : base;
+                    int ck = static_cast<int>(base - planes);
+                    c[k]   = (shared && ck > 0 && *base == x[k]) ? ck - 1 : ck;
+                }
+            } else if (std::is_integral<Coordinate>::value)
+            {
+                Coordinate width  = (max - min + 1) / d;
+                double     inv    = 1. / static_cast<double>(width);
+                bool       shared = share_face[axis];
+                for (size_t k = 0; k < m; ++k)
+                {
+                    Coordinate offset = x[k] - min;
+                    int r = static_cast<int>(static_cast<double>(offset) * inv);        // exact after the corrections
+                    r = (static_cast<Coordinate>(r) * width > offset)       ? r - 1 : r;
+                    r = (static_cast<Coordinate>(r + 1) * width <= offset)  ? r + 1 : r;
+                    r = r >= d ? d - 1 : r;
+                    c[k] = (shared && r > 0 && offset == static_cast<Coordinate>(r) * width) ? r - 1 : r;
+                }
+            } else
+            {
+                // truncation is floor for the points inside the domain
+                Coordinate width = (max - min) / static_cast<Coordinate>(d);
+                for (size_t k = 0; k < m; ++k)
+                {
+                    int r = static_cast<int>((x[k] - min) / width);
+                    c[k] = (min + static_cast<Coordinate>(r) * width == x[k]) ? r - 1 : r;
+                }
+            }
+
+            // coupled with coords_to_gid
+            for (size_t k = 0; k < m; ++k)
+            {
+                int ck = c[k] < 0 ? 0 : (c[k] >= d ? d - 1 : c[k]);
+                g[k] = g[k] * d + ck;
+            }
+        }
+
+        for (size_t k = 0; k < m; ++k)
+            g[k] = outside[k] ? -1 : g[k];
+    }
+}
+
+// f(begin, end) over [0, n), split among up to threads threads, each with at least min_batch elements
+template<class Bounds>
+template<class F>
+void
+diy::RegularDecomposer<Bounds>::
+parallel_for(size_t n, int threads, const F& f) const
+{
+    size_t nthreads = (std::max)(size_t(1), (std::min)(static_cast<size_t>((std::max)(threads, 1)), n / min_batch));
+    if (nthreads == 1)
+    {
+        f(size_t(0), n);
+        return;
+    }
+
+    std::vector<diy::thread> workers;
+    size_t per_thread = (n + nthreads - 1) / nthreads;
+    for (size_t t = 1; t < nthreads; ++t)
+    {
+        size_t begin = t * per_thread, end = (std::min)(n, begin + per_thread);
+        workers.emplace_back([&f,begin,end]() { f(begin, end); });
+    }
+    f(size_t(0), (std::min)(n, per_thread));
+    for (auto& w : workers)
+        w.join();
+}
+
+template<class Bounds>
+template<class T>
+void
+diy::RegularDecomposer<Bounds>::
+points_to_gids(const T* const* columns, size_t n, int* gids, int threads) const
+{
+    parallel_for(n, threads, [&](size_t begin, size_t end)
+    {
+        std::vector<const T*> shifted(dim);
+        for (int i = 0; i < dim; ++i)
+            shifted[i] = columns[i] + begin;
+        points_to_gids_chunk(shifted.data(), end - begin, gids + begin);
+    });
+}
+
+template<class Bounds>
+template<class T>
+void
+diy::RegularDecomposer<Bounds>::
+points_to_gids(const T* const* columns, size_t n, int* gids, const StaticAssigner& assigner, int* ranks, int threads) const
+{
+    parallel_for(n, threads, [&](size_t begin, size_t end)
+    {
+        std::vector<const T*> shifted(dim);
+        for (int i = 0; i < dim; ++i)
+            shifted[i] = columns[i] + begin;
+        points_to_gids_chunk(shifted.data(), end - begin, gids + begin);
+        for (size_t k = begin; k < end; ++k)
+            ranks[k] = gids[k] < 0 ? -1 : assigner.rank(gids[k]);
+    });
+}
+
+template<class Bounds>
+template<class T>
+void
+diy::RegularDecomposer<Bounds>::
+points_to_gids(const T* points, size_t n, int* gids, int threads) const
+{
+    static const size_t chunk = 256;
+
+    parallel_for(n, threads, [&](size_t begin, size_t end)
+    {
+        // transpose a chunk at a time into columns
+        std::vector<T>          buffer(chunk * dim);
+        std::vector<const T*>   columns(dim);
+        for (int i = 0; i < dim; ++i)
+            columns[i] = &buffer[i * chunk];
+
+        for (size_t start = begin; start < end; start += chunk)
+        {
+            size_t m = (std::min)(chunk, end - start);
+            for (size_t k = 0; k < m; ++k)
+                for (int i = 0; i < dim; ++i)
+                    buffer[i * chunk + k] = points[(start + k) * dim + i];
+            points_to_gids_chunk(columns.data(), m, gids + start);
+        }
+    });
+}
+
 // find lowest gid that owns a particular point
 template<class Bounds>
 template<class Point>
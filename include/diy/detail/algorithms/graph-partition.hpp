@@ -0,0 +1,453 @@
+#ifndef DIY_DETAIL_ALGORITHMS_GRAPH_PARTITION_HPP
+#define DIY_DETAIL_ALGORITHMS_GRAPH_PARTITION_HPP
+
+#include <algorithm>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace diy
+{
+
+namespace detail
+{
+    // Multilevel k-way graph partitioning: coarsen by heavy-edge matching, split the coarsest graph
+    // by recursive bisection, then project back level by level, refining the boundary greedily.
+    // Deterministic, so that every process computes the same partition from the same graph.
+
+    // undirected graph in compressed sparse row form: the neighbors of v are adjncy[xadj[v] .. xadj[v+1])
+    struct PartitionGraph
+    {
+        std::vector<size_t>     xadj;
+        std::vector<int>        adjncy;
+        std::vector<long long>  adjwgt;
+        std::vector<long long>  vwgt;
+
+        int         size() const            { return static_cast<int>(vwgt.size()); }
+        long long   total_weight() const    { long long w = 0; for (long long x : vwgt) w += x; return w; }
+    };
+
+    // edges may repeat (their weights add up) and go in either direction; self-loops are dropped
+    inline PartitionGraph   make_partition_graph(const std::vector<long long>& vwgt, const std::vector<std::pair<int,int>>& edges)
+    {
+        int n = static_cast<int>(vwgt.size());
+
+        std::vector<std::pair<int,int>> directed;
+        directed.reserve(2*edges.size());
+        for (auto& e : edges)
+        {
+            if (e.first == e.second || e.first < 0 || e.second < 0 || e.first >= n || e.second >= n)
+                continue;
+            directed.emplace_back(e.first, e.second);
+            directed.emplace_back(e.second, e.first);
+        }
+        std::sort(directed.begin(), directed.end());
+
+        PartitionGraph g;
+        g.vwgt = vwgt;
+        g.xadj.assign(static_cast<size_t>(n) + 1, 0);
+        for (size_t i = 0; i < directed.size(); ++i)
+        {
+            if (i > 0 && directed[i] == directed[i-1])
+            {
+                ++g.adjwgt.back();
+                continue;
+            }
+            g.adjncy.push_back(directed[i].second);
+            g.adjwgt.push_back(1);
+            ++g.xadj[static_cast<size_t>(directed[i].first) + 1];
+        }
+        for (size_t v = 0; v < static_cast<size_t>(n); ++v)
+            g.xadj[v+1] += g.xadj[v];
+        return g;
+    }
+
+    // visit the vertices in the order of increasing degree, matching each with the unmatched neighbor
+    // across the heaviest edge, as long as the pair weighs at most max_vwgt;
+    // fills the coarse vertex of every vertex and returns the number of coarse vertices
+    inline int  match_heavy_edges(const PartitionGraph& g, long long max_vwgt, std::vector<int>& cmap)
+    {
+        int n = g.size();
+        std::vector<int> order(static_cast<size_t>(n));
+        for (int v = 0; v < n; ++v)
+            order[static_cast<size_t>(v)] = v;
+        std::stable_sort(order.begin(), order.end(), [&g](int u, int v)
+                         { return g.xadj[static_cast<size_t>(u)+1] - g.xadj[static_cast<size_t>(u)] < g.xadj[static_cast<size_t>(v)+1] - g.xadj[static_cast<size_t>(v)]; });
+
+        std::vector<int> match(static_cast<size_t>(n), -1);
+        for (int v : order)
+        {
+            if (match[static_cast<size_t>(v)] != -1)
+                continue;
+
+            int       mate = v;
+            long long best = -1;
+            for (size_t e = g.xadj[static_cast<size_t>(v)]; e < g.xadj[static_cast<size_t>(v)+1]; ++e)
+            {
+                int u = g.adjncy[e];
+                if (match[static_cast<size_t>(u)] == -1 && g.adjwgt[e] > best &&
+                    g.vwgt[static_cast<size_t>(u)] + g.vwgt[static_cast<size_t>(v)] <= max_vwgt)
+                {
+                    mate = u;
+                    best = g.adjwgt[e];
+                }
+            }
+            match[static_cast<size_t>(v)]    = mate;
+            match[static_cast<size_t>(mate)] = v;
+        }
+
+        cmap.assign(static_cast<size_t>(n), -1);
+        int cn = 0;
+        for (int v = 0; v < n; ++v)
+            if (cmap[static_cast<size_t>(v)] == -1)
+            {
+                cmap[static_cast<size_t>(v)] = cmap[static_cast<size_t>(match[static_cast<size_t>(v)])] = cn;
+                ++cn;
+            }
+        return cn;
+    }
+
+    // collapse the vertices with the same coarse vertex, adding up their weights and those of their edges
+    inline PartitionGraph   contract(const PartitionGraph& g, const std::vector<int>& cmap, int cn)
+    {
+        int n = g.size();
+
+        // fine vertices, grouped by coarse vertex
+        std::vector<size_t> first(static_cast<size_t>(cn) + 1, 0);
+        for (int v = 0; v < n; ++v)
+            ++first[static_cast<size_t>(cmap[static_cast<size_t>(v)]) + 1];
+        for (size_t c = 0; c < static_cast<size_t>(cn); ++c)
+            first[c+1] += first[c];
+        std::vector<int>    members(static_cast<size_t>(n));
+        std::vector<size_t> next(first.begin(), first.end() - 1);
+        for (int v = 0; v < n; ++v)
+            members[next[static_cast<size_t>(cmap[static_cast<size_t>(v)])]++] = v;
+
+        PartitionGraph c;
+        c.vwgt.assign(static_cast<size_t>(cn), 0);
+        c.xadj.reserve(static_cast<size_t>(cn) + 1);
+        c.xadj.push_back(0);
+
+        std::vector<int>        marker(static_cast<size_t>(cn), -1);
+        std::vector<size_t>     position(static_cast<size_t>(cn));
+        for (int cv = 0; cv < cn; ++cv)
+        {
+            for (size_t i = first[static_cast<size_t>(cv)]; i < first[static_cast<size_t>(cv)+1]; ++i)
+            {
+                size_t v = static_cast<size_t>(members[i]);
+                c.vwgt[static_cast<size_t>(cv)] += g.vwgt[v];
+                for (size_t e = g.xadj[v]; e < g.xadj[v+1]; ++e)
+                {
+                    int cu = cmap[static_cast<size_t>(g.adjncy[e])];
+                    if (cu == cv)
+                        continue;
+                    if (marker[static_cast<size_t>(cu)] != cv)
+                    {
+                        marker[static_cast<size_t>(cu)]   = cv;
+                        position[static_cast<size_t>(cu)] = c.adjncy.size();
+                        c.adjncy.push_back(cu);
+                        c.adjwgt.push_back(0);
+                    }
+                    c.adjwgt[position[static_cast<size_t>(cu)]] += g.adjwgt[e];
+                }
+            }
+            c.xadj.push_back(c.adjncy.size());
+        }
+        return c;
+    }
+
+    // total weight of the edges between different parts
+    inline long long    edge_cut(const PartitionGraph& g, const std::vector<int>& part)
+    {
+        long long cut = 0;
+        for (size_t v = 0; v < static_cast<size_t>(g.size()); ++v)
+            for (size_t e = g.xadj[v]; e < g.xadj[v+1]; ++e)
+                if (part[v] != part[static_cast<size_t>(g.adjncy[e])])
+                    cut += g.adjwgt[e];
+        return cut / 2;
+    }
+
+    // greedy boundary refinement: move vertices to the neighboring part that reduces the cut the most,
+    // without pushing that part above its maximum weight; vertices of parts above their maximum move even
+    // at a loss, to any neighboring part that ends up lighter than the one they leave
+    inline void     refine_partition(const PartitionGraph& g, const std::vector<long long>& max_weights, std::vector<int>& part, int passes = 8)
+    {
+        size_t n = static_cast<size_t>(g.size());
+        std::vector<long long> weights(max_weights.size(), 0);
+        for (size_t v = 0; v < n; ++v)
+            weights[static_cast<size_t>(part[v])] += g.vwgt[v];
+
+        std::vector<long long>  connection(max_weights.size(), 0);
+        std::vector<int>        touched;
+        for (int pass = 0; pass < passes; ++pass)
+        {
+            bool moved = false;
+            for (size_t v = 0; v < n; ++v)
+            {
+                size_t    from     = static_cast<size_t>(part[v]);
+                long long internal = 0;
+                touched.clear();
+                for (size_t e = g.xadj[v]; e < g.xadj[v+1]; ++e)
+                {
+                    int p = part[static_cast<size_t>(g.adjncy[e])];
+                    if (static_cast<size_t>(p) == from)
+                        internal += g.adjwgt[e];
+                    else
+                    {
+                        if (connection[static_cast<size_t>(p)] == 0)
+                            touched.push_back(p);
+                        connection[static_cast<size_t>(p)] += g.adjwgt[e];
+                    }
+                }
+
+                long long w         = g.vwgt[v];
+                bool      over      = weights[from] > max_weights[from];
+                int       best      = -1;
+                long long best_gain = 0;
+                for (int p : touched)
+                {
+                    size_t    to   = static_cast<size_t>(p);
+                    long long gain = connection[to] - internal;
+                    long long to_w = weights[to] + w;
+                    bool acceptable = (to_w <= max_weights[to] && (gain > 0 || (gain == 0 && to_w < weights[from]))) ||
+                                      (over && to_w < weights[from]);
+                    if (acceptable && (best == -1 || gain > best_gain ||
+                                       (gain == best_gain && weights[to] < weights[static_cast<size_t>(best)])))
+                    {
+                        best      = p;
+                        best_gain = gain;
+                    }
+                }
+                for (int p : touched)
+                    connection[static_cast<size_t>(p)] = 0;
+
+                if (best != -1)
+                {
+                    part[v] = best;
+                    weights[from] -= w;
+                    weights[static_cast<size_t>(best)] += w;
+                    moved = true;
+                }
+            }
+            if (!moved)
+                break;
+        }
+    }
+
+    // the subgraph induced by the vertices with part[v] == p; ids maps its vertices to those of g
+    inline PartitionGraph   induced_subgraph(const PartitionGraph& g, const std::vector<int>& part, int p, std::vector<int>& ids)
+    {
+        std::vector<int> local(static_cast<size_t>(g.size()), -1);
+        ids.clear();
+        for (int v = 0; v < g.size(); ++v)
+            if (part[static_cast<size_t>(v)] == p)
+            {
+                local[static_cast<size_t>(v)] = static_cast<int>(ids.size());
+                ids.push_back(v);
+            }
+
+        PartitionGraph sub;
+        sub.xadj.push_back(0);
+        for (int v : ids)
+        {
+            sub.vwgt.push_back(g.vwgt[static_cast<size_t>(v)]);
+            for (size_t e = g.xadj[static_cast<size_t>(v)]; e < g.xadj[static_cast<size_t>(v)+1]; ++e)
+            {
+                int u = local[static_cast<size_t>(g.adjncy[e])];
+                if (u == -1)
+                    continue;
+                sub.adjncy.push_back(u);
+                sub.adjwgt.push_back(g.adjwgt[e]);
+            }
+            sub.xadj.push_back(sub.adjncy.size());
+        }
+        return sub;
+    }
+
+    // the last vertex reached by a breadth-first search from s, twice over: far from most of its component
+    inline int  pseudo_peripheral_vertex(const PartitionGraph& g, int s)
+    {
+        std::vector<int>  order;
+        std::vector<bool> visited;
+        for (int round = 0; round < 2; ++round)
+        {
+            order.assign(1, s);
+            visited.assign(static_cast<size_t>(g.size()), false);
+            visited[static_cast<size_t>(s)] = true;
+            for (size_t head = 0; head < order.size(); ++head)
+            {
+                size_t v = static_cast<size_t>(order[head]);
+                for (size_t e = g.xadj[v]; e < g.xadj[v+1]; ++e)
+                {
+                    int u = g.adjncy[e];
+                    if (!visited[static_cast<size_t>(u)])
+                    {
+                        visited[static_cast<size_t>(u)] = true;
+                        order.push_back(u);
+                    }
+                }
+            }
+            s = order.back();
+        }
+        return s;
+    }
+
+    // grow part 0 from seed up to about target weight, adding the frontier vertex with the most edge weight
+    // into part 0 (minus the weight out of it) each time; the rest is part 1. When the component of seed
+    // runs out, continues from the lowest vertex not yet in part 0.
+    inline std::vector<int> grow_bisection(const PartitionGraph& g, int seed, long long target)
+    {
+        size_t n = static_cast<size_t>(g.size());
+        std::vector<int>        part(n, 1);
+        std::vector<long long>  gain(n, 0);
+        for (size_t v = 0; v < n; ++v)
+            for (size_t e = g.xadj[v]; e < g.xadj[v+1]; ++e)
+                gain[v] -= g.adjwgt[e];
+
+        std::priority_queue<std::pair<long long,int>>   frontier;       // (gain, -v); entries with an old gain are skipped
+        frontier.emplace(gain[static_cast<size_t>(seed)], -seed);
+
+        long long weight = 0;
+        size_t    next   = 0;
+        while (weight < target)
+        {
+            size_t v;
+            if (frontier.empty())
+            {
+                while (next < n && part[next] == 0)
+                    ++next;
+                if (next == n)
+                    break;
+                v = next;
+            } else
+            {
+                std::pair<long long,int> top = frontier.top();
+                frontier.pop();
+                v = static_cast<size_t>(-top.second);
+                if (part[v] == 0 || top.first != gain[v])
+                    continue;
+            }
+
+            // stop short of the target, if that's closer
+            if (weight + g.vwgt[v] - target > target - weight)
+                break;
+
+            part[v] = 0;
+            weight += g.vwgt[v];
+            for (size_t e = g.xadj[v]; e < g.xadj[v+1]; ++e)
+            {
+                size_t u = static_cast<size_t>(g.adjncy[e]);
+                gain[u] += 2*g.adjwgt[e];
+                if (part[u] == 1)
+                    frontier.emplace(gain[u], -static_cast<int>(u));
+            }
+        }
+        return part;
+    }
+
+    // split into parts 0 and 1, weighing target and the rest: the best of a few refined bisections,
+    // grown from different seeds
+    inline std::vector<int> bisect(const PartitionGraph& g, long long target, float imbalance)
+    {
+        static const int tries = 4;
+
+        int       n     = g.size();
+        long long total = g.total_weight();
+        std::vector<long long> max_weights { std::max(target,         static_cast<long long>(target * (1. + imbalance))),
+                                             std::max(total - target, static_cast<long long>((total - target) * (1. + imbalance))) };
+
+        std::vector<int>    best;
+        long long           best_cut = -1;
+        for (int t = 0; t < std::min(tries, n); ++t)
+        {
+            std::vector<int> part = grow_bisection(g, pseudo_peripheral_vertex(g, static_cast<int>(static_cast<long long>(t) * n / tries)), target);
+            refine_partition(g, max_weights, part);
+            long long cut = edge_cut(g, part);
+            if (best_cut == -1 || cut < best_cut)
+            {
+                best.swap(part);
+                best_cut = cut;
+            }
+        }
+        return best;
+    }
+
+    // recursive bisection into the parts first .. first + k - 1, of equal weight; ids maps the vertices of g to part
+    inline void     recursive_bisection(const PartitionGraph& g, const std::vector<int>& ids, int first, int k, float imbalance, std::vector<int>& part)
+    {
+        if (k == 1 || g.size() == 0)
+        {
+            for (int v : ids)
+                part[static_cast<size_t>(v)] = first;
+            return;
+        }
+
+        int k0 = k / 2;
+        std::vector<int> side = bisect(g, g.total_weight() * k0 / k, imbalance);
+        for (int s = 0; s < 2; ++s)
+        {
+            std::vector<int> sub_ids;
+            PartitionGraph sub = induced_subgraph(g, side, s, sub_ids);
+            for (int& v : sub_ids)
+                v = ids[static_cast<size_t>(v)];
+            recursive_bisection(sub, sub_ids, s == 0 ? first : first + k0, s == 0 ? k0 : k - k0, imbalance, part);
+        }
+    }
+
+    // assigns every vertex to one of k parts, each weighing at most (1 + imbalance) of the average (as far as the
+    // vertex weights allow), minimizing the weight of the edges between different parts
+    inline std::vector<int> partition_graph(PartitionGraph graph, int k, float imbalance)
+    {
+        int n = graph.size();
+        if (k <= 1 || n == 0)
+            return std::vector<int>(static_cast<size_t>(n), 0);
+
+        imbalance = std::max(imbalance, 0.f);
+        long long total = graph.total_weight();
+        if (total == 0)
+        {
+            graph.vwgt.assign(graph.vwgt.size(), 1);
+            total = n;
+        }
+        long long average  = (total + k - 1) / k;
+        long long max_part = std::max(average, static_cast<long long>(average * (1. + imbalance)));
+
+        // coarsen until there are a few vertices per part, or the matching stalls
+        int coarsest_size = std::max(20*k, 100);
+        std::vector<PartitionGraph>     levels(1, graph);
+        std::vector<std::vector<int>>   cmaps;
+        while (levels.back().size() > coarsest_size)
+        {
+            std::vector<int> cmap;
+            int cn = match_heavy_edges(levels.back(), std::max<long long>(1, 3*total / (2*coarsest_size)), cmap);
+            if (cn > levels.back().size() * 19 / 20)
+                break;
+            PartitionGraph coarse = contract(levels.back(), cmap, cn);
+            levels.push_back(std::move(coarse));
+            cmaps.push_back(std::move(cmap));
+        }
+
+        const PartitionGraph& coarsest = levels.back();
+        std::vector<int> ids(static_cast<size_t>(coarsest.size())), part(ids.size());
+        for (size_t v = 0; v < ids.size(); ++v)
+            ids[v] = static_cast<int>(v);
+        recursive_bisection(coarsest, ids, 0, k, imbalance, part);
+
+        std::vector<long long> max_weights(static_cast<size_t>(k), max_part);
+        refine_partition(coarsest, max_weights, part);
+        for (size_t l = cmaps.size(); l > 0; --l)
+        {
+            const std::vector<int>& cmap = cmaps[l-1];
+            std::vector<int> fine(cmap.size());
+            for (size_t v = 0; v < cmap.size(); ++v)
+                fine[v] = part[static_cast<size_t>(cmap[v])];
+            part.swap(fine);
+            refine_partition(levels[l-1], max_weights, part);
+        }
+        return part;
+    }
+}
+
+}
+
+#endif
@@ -1,12 +1,24 @@
 #pragma once
 
 #include <queue>
+#include <set>
+#include <map>
+#include <limits>
+#include <tuple>
 #include "load-balance.hpp"
 #include "diy/mpi/collectives.hpp"
 
 namespace diy
 {
 
+//! Algorithm that `load_balance_collective()` uses to reassign all the blocks at once
+enum class CollectiveBalance
+{
+    lpt,                // longest processing time first: heaviest block to the lightest process
+    karmarkar_karp,     // multiway largest differencing
+    diffusion,          // move blocks from the heaviest to the lightest process while that improves the balance
+};
+
 namespace detail
 {
 
@@ -86,20 +98,16 @@ inline void move_block(diy::Master&            master,
 
     if (master.communicator().rank() == move_info.src_proc)
     {
+        // move the block, its measured cost, and its link from src to dst proc, in one message
+        MigratedBlocks migrated(master);
         diy::MemoryBuffer bb;
+        diy::save(bb, master.block_cost(move_info.move_gid));
+        migrated.save(move_info.move_gid, bb);
 
-        // move the block from src to dst proc
-        void* send_b = master.block(master.lid(move_info.move_gid));
-        master.saver()(send_b, bb);
-        master.communicator().send(move_info.dst_proc, 0, bb.buffer);
-
-        // move the link for the moving block
-        diy::Link* send_link = master.link(master.lid(move_info.move_gid));
-        diy::LinkFactory::save(bb, send_link);
-        master.communicator().send(move_info.dst_proc, 0, bb.buffer);
-
-        // remove the block from the master
-        master.destroyer()(master.release(move_info.move_gid));
+        std::vector<mpi::request> requests;
+        isend_with_blobs(master.communicator(), move_info.dst_proc, 0, bb, requests);
+        for (auto& r : requests)
+            r.wait();
 
         // debug
         // fmt::print(stderr, "move_block(): moving gid {} from proc {} to proc {}\n", move_info.move_gid, move_info.src_proc, move_info.dst_proc);
@@ -107,20 +115,459 @@ inline void move_block(diy::Master&            master,
     else if (master.communicator().rank() == move_info.dst_proc)
     {
         diy::MemoryBuffer bb;
+        recv_with_blobs(master.communicator(), move_info.src_proc, 0, bb);
+
+        double cost;
+        diy::load(bb, cost);
+        load_migrated_block(master, move_info.move_gid, bb);
+        if (cost > 0)
+            master.set_block_cost(move_info.move_gid, cost);
+    }
+}
+
+// work of one block, gathered from all processes
+struct BlockWork
+{
+    int     gid;
+    int     proc;               // current owner
+    Work    work;
+    std::vector<size_t> neighbors;  // indices of its link neighbors in the gathered blocks; see gather_block_neighbors()
+};
+
+// gather the work of every block on every process
+inline void gather_block_work(diy::Master&              master,
+                              const std::vector<Work>&  my_work,            // work of my blocks, by lid
+                              std::vector<BlockWork>&   all_blocks)         // (output) all blocks, sorted by gid
+{
+    std::vector<int> my_gids(master.size());
+    for (unsigned i = 0; i < master.size(); i++)
+        my_gids[i] = master.gid(i);
+
+    std::vector<std::vector<int>>   all_gids;
+    std::vector<std::vector<Work>>  all_work;
+    diy::mpi::all_gather(master.communicator(), my_gids, all_gids);
+    diy::mpi::all_gather(master.communicator(), my_work, all_work);
+
+    all_blocks.clear();
+    for (int proc = 0; proc < static_cast<int>(all_gids.size()); proc++)
+        for (size_t i = 0; i < all_gids[proc].size(); i++)
+            all_blocks.push_back(BlockWork { all_gids[proc][i], proc, all_work[proc][i], {} });
+
+    // every process must reach the same decision: fix the order
+    std::sort(all_blocks.begin(), all_blocks.end(),
+              [](const BlockWork& a, const BlockWork& b) { return a.gid < b.gid; });
+}
+
+// gather the link neighbors of every block, after gather_block_work()
+inline void gather_block_neighbors(diy::Master&             master,
+                                   std::vector<BlockWork>&  all_blocks)
+{
+    // [nneighbors, gids...] for every local block, by lid
+    std::vector<int> my_neighbors;
+    for (unsigned i = 0; i < master.size(); i++)
+    {
+        const Link* link = master.link(static_cast<int>(i));
+        my_neighbors.push_back(link->size());
+        for (int j = 0; j < link->size(); j++)
+            my_neighbors.push_back(link->target(j).gid);
+    }
+
+    std::vector<std::vector<int>> all_gids, all_neighbors;
+    std::vector<int> my_gids(master.size());
+    for (unsigned i = 0; i < master.size(); i++)
+        my_gids[i] = master.gid(static_cast<int>(i));
+    diy::mpi::all_gather(master.communicator(), my_gids, all_gids);
+    diy::mpi::all_gather(master.communicator(), my_neighbors, all_neighbors);
+
+    auto index = [&all_blocks](int gid)
+    {
+        return static_cast<size_t>(std::lower_bound(all_blocks.begin(), all_blocks.end(), gid,
+                                                    [](const BlockWork& b, int g) { return b.gid < g; }) - all_blocks.begin());
+    };
+
+    for (size_t proc = 0; proc < all_gids.size(); proc++)
+    {
+        size_t k = 0;
+        for (int gid : all_gids[proc])
+        {
+            auto& neighbors = all_blocks[index(gid)].neighbors;
+            int n = all_neighbors[proc][k++];
+            for (int j = 0; j < n; j++)
+            {
+                size_t nbr = index(all_neighbors[proc][k++]);
+                if (nbr < all_blocks.size())
+                    neighbors.push_back(nbr);
+            }
+        }
+    }
+}
+
+// blocks in the order of decreasing work, ties by gid
+inline std::vector<size_t> heaviest_first(const std::vector<BlockWork>& blocks)
+{
+    std::vector<size_t> order(blocks.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b)
+              { return blocks[a].work > blocks[b].work || (blocks[a].work == blocks[b].work && blocks[a].gid < blocks[b].gid); });
+    return order;
+}
+
+// LPT: assign the blocks, heaviest first, to the bin with the least work; returns the bin of every block
+inline std::vector<int> partition_lpt(const std::vector<BlockWork>& blocks, int nprocs)
+{
+    std::vector<int> bins(blocks.size());
+
+    using BinLoad = std::pair<long long, int>;      // (work, bin)
+    std::priority_queue<BinLoad, std::vector<BinLoad>, std::greater<BinLoad>> loads;
+    for (int i = 0; i < nprocs; i++)
+        loads.push(BinLoad(0, i));
+
+    for (size_t i : heaviest_first(blocks))
+    {
+        BinLoad l = loads.top();
+        loads.pop();
+        bins[i] = l.second;
+        l.first += blocks[i].work;
+        loads.push(l);
+    }
+
+    return bins;
+}
+
+// Karmarkar-Karp: start with a partial partition per block, repeatedly combine the two with the largest spread,
+// pairing the heaviest subsets of one with the lightest of the other; returns the bin of every block
+inline std::vector<int> partition_karmarkar_karp(const std::vector<BlockWork>& blocks, int nprocs)
+{
+    struct Subset
+    {
+        long long           work;
+        std::vector<size_t> blocks;
+    };
+
+    // subsets sorted by decreasing work; only the nonempty ones are stored, the rest (up to nprocs) are empty
+    struct Partition
+    {
+        std::vector<Subset> subsets;
+        long long           spread(int k) const     { return subsets.front().work - (static_cast<int>(subsets.size()) < k ? 0 : subsets.back().work); }
+    };
+
+    std::vector<Partition> partitions(blocks.size());
+    for (size_t i = 0; i < blocks.size(); i++)
+        partitions[i].subsets.push_back(Subset { static_cast<long long>(blocks[i].work), std::vector<size_t>(1, i) });
+
+    // largest spread first, ties by the order the partitions were created
+    using Entry = std::tuple<long long, long long, size_t>;            // (spread, -creation, index)
+    std::priority_queue<Entry> queue;
+    long long created = 0;
+    for (size_t i = 0; i < partitions.size(); i++)
+        queue.push(Entry(partitions[i].spread(nprocs), -created++, i));
+
+    while (queue.size() > 1)
+    {
+        size_t a = std::get<2>(queue.top()); queue.pop();
+        size_t b = std::get<2>(queue.top()); queue.pop();
+
+        auto& x = partitions[a].subsets;
+        auto& y = partitions[b].subsets;
+        std::vector<Subset> combined;
+        for (int i = 0; i < nprocs; i++)
+        {
+            int j = nprocs - 1 - i;
+            bool in_x = i < static_cast<int>(x.size()), in_y = j < static_cast<int>(y.size());
+            if (!in_x && !in_y)
+                continue;
 
-        // move the block from src to dst proc
-        void* recv_b = master.creator()();
-        master.communicator().recv(move_info.src_proc, 0, bb.buffer);
-        master.loader()(recv_b, bb);
+            Subset s { 0, {} };
+            if (in_x)
+            {
+                s.work += x[i].work;
+                s.blocks.swap(x[i].blocks);
+            }
+            if (in_y)
+            {
+                s.work += y[j].work;
+                s.blocks.insert(s.blocks.end(), y[j].blocks.begin(), y[j].blocks.end());
+            }
+            combined.push_back(std::move(s));
+        }
+        std::stable_sort(combined.begin(), combined.end(), [](const Subset& u, const Subset& v) { return u.work > v.work; });
 
-        // move the link for the moving block
-        diy::Link* recv_link;
-        master.communicator().recv(move_info.src_proc, 0, bb.buffer);
-        recv_link = diy::LinkFactory::load(bb);
+        x.swap(combined);
+        std::vector<Subset>().swap(y);
+        queue.push(Entry(partitions[a].spread(nprocs), -created++, a));
+    }
 
-        // add the block to the master
-        master.add(move_info.move_gid, recv_b, recv_link);
+    std::vector<int> bins(blocks.size());
+    if (!queue.empty())
+    {
+        auto& subsets = partitions[std::get<2>(queue.top())].subsets;
+        for (size_t i = 0; i < subsets.size(); i++)
+            for (size_t b : subsets[i].blocks)
+                bins[b] = static_cast<int>(i);
+    }
+    return bins;
+}
+
+// bins are interchangeable: give each one to the process that already holds the most of its work
+inline std::vector<int> match_bins(const std::vector<BlockWork>& blocks, const std::vector<int>& bins, int nprocs)
+{
+    std::map<std::pair<int,int>, long long> overlap;           // (bin, proc) -> work
+    for (size_t i = 0; i < blocks.size(); i++)
+        overlap[std::make_pair(bins[i], blocks[i].proc)] += blocks[i].work + 1;     // + 1: count the blocks with no work
+
+    using Candidate = std::tuple<long long, int, int>;          // (overlap, bin, proc)
+    std::vector<Candidate> candidates;
+    for (auto& x : overlap)
+        candidates.emplace_back(x.second, x.first.first, x.first.second);
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b)
+              { return std::get<0>(a) > std::get<0>(b) || (std::get<0>(a) == std::get<0>(b) && a < b); });
+
+    std::vector<int> proc_of_bin(nprocs, -1), bin_of_proc(nprocs, -1);
+    for (auto& c : candidates)
+    {
+        int bin = std::get<1>(c), proc = std::get<2>(c);
+        if (proc_of_bin[bin] == -1 && bin_of_proc[proc] == -1)
+        {
+            proc_of_bin[bin]  = proc;
+            bin_of_proc[proc] = bin;
+        }
     }
+
+    int proc = 0;
+    for (int bin = 0; bin < nprocs; bin++)
+        if (proc_of_bin[bin] == -1)
+        {
+            while (bin_of_proc[proc] != -1)
+                proc++;
+            proc_of_bin[bin]  = proc;
+            bin_of_proc[proc] = bin;
+        }
+
+    std::vector<int> dst(blocks.size());
+    for (size_t i = 0; i < blocks.size(); i++)
+        dst[i] = proc_of_bin[bins[i]];
+    return dst;
+}
+
+// if there are more than max_moves moves to the new assignment, keep max_moves of them, heaviest first,
+// skipping those that would leave the destination heavier than the source was
+inline void cap_moves(const std::vector<BlockWork>& blocks, std::vector<int>& dst, int nprocs, size_t max_moves)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < blocks.size(); i++)
+        count += dst[i] != blocks[i].proc;
+    if (count <= max_moves)
+        return;
+
+    std::vector<long long> load(nprocs, 0);
+    std::vector<int>       nblocks(nprocs, 0);
+    for (auto& b : blocks)
+    {
+        load[b.proc] += b.work;
+        nblocks[b.proc]++;
+    }
+
+    size_t moves = 0;
+    for (size_t i : heaviest_first(blocks))
+    {
+        int src = blocks[i].proc;
+        if (dst[i] == src)
+            continue;
+
+        long long w = blocks[i].work;
+        if (moves < max_moves && load[dst[i]] + w <= load[src] && nblocks[src] > 1)
+        {
+            load[src] -= w;     nblocks[src]--;
+            load[dst[i]] += w;  nblocks[dst[i]]++;
+            moves++;
+        } else
+            dst[i] = src;
+    }
+}
+
+// diffusion: move a block from the heaviest process to the lightest one, the heaviest block that
+// reduces the larger of their loads, until there is no such block; returns the destination of every block
+// with locality > 0, the block is the best by move_score() among those that reduce the larger load
+inline std::vector<int> partition_diffusion(const std::vector<BlockWork>& blocks, int nprocs, size_t max_moves, float locality = 0)
+{
+    std::vector<int>                            dst(blocks.size());
+    std::vector<long long>                      load(nprocs, 0);
+    std::vector<std::set<std::pair<Work,int>>>  held(nprocs);            // (work, index in blocks)
+    for (size_t i = 0; i < blocks.size(); i++)
+    {
+        dst[i] = blocks[i].proc;
+        load[dst[i]] += blocks[i].work;
+        held[dst[i]].insert(std::make_pair(blocks[i].work, static_cast<int>(i)));
+    }
+
+    std::set<std::pair<long long,int>> loads;                           // (load, proc)
+    for (int i = 0; i < nprocs; i++)
+        loads.insert(std::make_pair(load[i], i));
+
+    for (size_t moves = 0; moves < max_moves && nprocs > 1; moves++)
+    {
+        int src = loads.rbegin()->second, to = loads.begin()->second;
+        long long gap = load[src] - load[to];
+        if (gap <= 1 || held[src].size() < 2)                             // don't leave a process with no blocks
+            break;
+
+        // heaviest block with 0 < work < gap
+        auto it = held[src].lower_bound(std::make_pair(static_cast<Work>(std::min<long long>(gap, std::numeric_limits<Work>::max())), -1));
+        if (it == held[src].begin())
+            break;
+        --it;
+        if (it->first == 0)
+            break;
+
+        if (locality > 0)
+        {
+            auto score = [&](const std::pair<Work,int>& candidate)
+            {
+                auto& b = blocks[candidate.second];
+                int on_dst = 0, on_src = 0;
+                for (size_t n : b.neighbors)
+                {
+                    on_dst += dst[n] == to;
+                    on_src += dst[n] == src;
+                }
+                return move_score(candidate.first, it->first, on_dst, on_src, static_cast<int>(b.neighbors.size()), locality);
+            };
+
+            auto best = it;
+            double best_score = score(*best);
+            for (auto c = held[src].begin(); c != it; ++c)
+            {
+                if (c->first == 0)
+                    continue;
+                double s = score(*c);
+                if (s > best_score)
+                {
+                    best       = c;
+                    best_score = s;
+                }
+            }
+            it = best;
+        }
+
+        auto block = *it;
+        held[src].erase(it);
+        held[to].insert(block);
+        dst[block.second] = to;
+
+        loads.erase(std::make_pair(load[src], src));
+        loads.erase(std::make_pair(load[to], to));
+        load[src] -= block.first;
+        load[to]  += block.first;
+        loads.insert(std::make_pair(load[src], src));
+        loads.insert(std::make_pair(load[to], to));
+    }
+
+    return dst;
+}
+
+// work of the heaviest process, with the blocks on the given processes
+inline long long max_load(const std::vector<BlockWork>& blocks, const std::vector<int>& procs, int nprocs)
+{
+    std::vector<long long> load(nprocs, 0);
+    for (size_t i = 0; i < blocks.size(); i++)
+        load[procs[i]] += blocks[i].work;
+    return load.empty() ? 0 : *std::max_element(load.begin(), load.end());
+}
+
+// decide the moves of all the blocks at once
+// the migration cap counts blocks, not bytes: their sizes are not known until they are serialized
+inline void decide_moves(const std::vector<BlockWork>&  all_blocks,
+                         int                            nprocs,
+                         CollectiveBalance              algorithm,
+                         float                          max_migration,      // fraction of the blocks allowed to move
+                         float                          locality,           // weight of the link neighbors in the choice of blocks (diffusion only)
+                         std::vector<MoveInfo>&         all_move_info)      // (output) moves, by gid
+{
+    size_t max_moves = static_cast<size_t>(std::max(0.f, max_migration) * static_cast<float>(all_blocks.size()));
+
+    std::vector<int> current(all_blocks.size());
+    for (size_t i = 0; i < all_blocks.size(); i++)
+        current[i] = all_blocks[i].proc;
+
+    std::vector<int> dst;
+    if (algorithm == CollectiveBalance::diffusion)
+        dst = partition_diffusion(all_blocks, nprocs, max_moves, locality);
+    else
+    {
+        std::vector<int> bins = algorithm == CollectiveBalance::lpt ?
+                                partition_lpt(all_blocks, nprocs) :
+                                partition_karmarkar_karp(all_blocks, nprocs);
+        dst = match_bins(all_blocks, bins, nprocs);
+        cap_moves(all_blocks, dst, nprocs, max_moves);
+
+        // the partition starts from scratch: keep the current assignment unless it lightens the heaviest process
+        if (max_load(all_blocks, dst, nprocs) >= max_load(all_blocks, current, nprocs))
+            dst = current;
+    }
+
+    all_move_info.clear();
+    for (size_t i = 0; i < all_blocks.size(); i++)
+        if (dst[i] != all_blocks[i].proc)
+            all_move_info.emplace_back(all_blocks[i].gid, all_blocks[i].proc, dst[i]);
+}
+
+// move all the blocks at once, with their measured costs: one message (plus the blobs) between every pair of processes
+// that exchange blocks; the blocks are serialized straight into it and loaded from it in place
+inline void move_blocks(diy::Master&                    master,
+                        const std::vector<MoveInfo>&    all_move_info)
+{
+    static const int tag = 0;
+    int rank = master.communicator().rank();
+
+    std::map<int, std::vector<int>> outgoing;           // dst proc -> gids
+    std::set<int>                   incoming;           // src procs
+    for (auto& m : all_move_info)
+    {
+        if (m.src_proc == rank)
+            outgoing[m.dst_proc].push_back(m.move_gid);
+        else if (m.dst_proc == rank)
+            incoming.insert(m.src_proc);
+    }
+
+    MigratedBlocks                      migrated(master);
+    std::vector<diy::MemoryBuffer>      buffers(outgoing.size());
+    std::vector<diy::mpi::request>      requests;
+    size_t i = 0;
+    for (auto& x : outgoing)
+    {
+        diy::MemoryBuffer& bb = buffers[i++];
+        diy::save(bb, x.second.size());
+        for (int gid : x.second)
+        {
+            diy::save(bb, gid);
+            diy::save(bb, master.block_cost(gid));
+            migrated.save(gid, bb);
+        }
+        isend_with_blobs(master.communicator(), x.first, tag, bb, requests);
+    }
+
+    for (int src : incoming)
+    {
+        diy::MemoryBuffer bb;
+        recv_with_blobs(master.communicator(), src, tag, bb);
+
+        size_t n;
+        diy::load(bb, n);
+        for (size_t j = 0; j < n; j++)
+        {
+            int     gid;
+            double  cost;
+            diy::load(bb, gid);
+            diy::load(bb, cost);
+            load_migrated_block(master, gid, bb);
+            if (cost > 0)
+                master.set_block_cost(gid, cost);
+        }
+    }
+
+    for (auto& r : requests)
+        r.wait();
 }
 
 }   // namespace detail
@@ -99,11 +99,12 @@ inline void exchange_sample_work_info(diy::Master&             master,
 }
 
 // send block
-inline void send_block(AuxBlock*,                                              // local block (unused)
+inline void send_block(AuxBlock*                           ab,                 // local block
                        const diy::Master::ProxyWithLink&   cp,                 // communication proxy for neighbor blocks
                        diy::Master&                        master,             // real master with multiple blocks per process
                        const std::vector<WorkInfo>&        sample_work_info,   // sampled work info
                        const WorkInfo&                     my_work_info,       // my work info
+                       const std::vector<Work>&            my_work,            // work of my blocks, by lid
                        float                               quantile)           // quantile cutoff above which to move blocks (0.0 - 1.0)
 {
     if (!sample_work_info.size())                   // do nothing in the degenerate case (1 or 2 total mpi ranks)
@@ -132,35 +133,50 @@ inline void send_block(AuxBlock*,                                              /
         auto src_work_info = my_work_info;
         auto dst_work_info = sample_work_info[target];
 
+        // with locality, any block that improves the load balance is a candidate, the best by local_move_score() wins
+        if (master.balance_locality() > 0 && src_work_info.proc_work > dst_work_info.proc_work)
+        {
+            Work gap = src_work_info.proc_work - dst_work_info.proc_work, heaviest = NO_WORK;
+            for (Work w : my_work)
+                if (w < gap)
+                    heaviest = std::max(heaviest, w);
+
+            double best_score = 0;
+            src_work_info.top_gid = NO_GID;
+            for (int lid = 0; lid < static_cast<int>(my_work.size()); lid++)
+            {
+                if (my_work[lid] >= gap)
+                    continue;
+                double score = local_move_score(master, master.gid(lid), my_work[lid], heaviest, dst_work_info.proc_rank);
+                if (src_work_info.top_gid == NO_GID || score > best_score)
+                {
+                    src_work_info.top_gid  = master.gid(lid);
+                    src_work_info.top_work = my_work[lid];
+                    best_score             = score;
+                }
+            }
+        }
+
         // sanity check that the move makes sense
-        if (src_work_info.proc_work - dst_work_info.proc_work > src_work_info.top_work &&   // improve load balance
+        if (src_work_info.top_gid != NO_GID &&
+                src_work_info.proc_work - dst_work_info.proc_work > src_work_info.top_work &&   // improve load balance
                 src_work_info.proc_rank != dst_work_info.proc_rank &&                       // not self
                 src_work_info.nlids > 1)                                                    // don't leave a proc with no blocks
         {
 
-            move_info.move_gid = my_work_info.top_gid;
+            move_info.move_gid = src_work_info.top_gid;
             move_info.src_proc = my_work_info.proc_rank;
             move_info.dst_proc = sample_work_info[target].proc_rank;
 
             // destination in aux_master, where gid = proc
             diy::BlockID dest_block = {move_info.dst_proc, move_info.dst_proc};
 
-            // enqueue the gid of the moving block
+            // enqueue the gid of the moving block, and its measured cost
             cp.enqueue(dest_block, move_info.move_gid);
+            cp.enqueue(dest_block, master.block_cost(move_info.move_gid));
 
-            // enqueue the block
-            void* send_b = master.block(master.lid(move_info.move_gid));
-            diy::MemoryBuffer bb;
-            master.saver()(send_b, bb);
-            cp.enqueue(dest_block, bb.buffer);
-
-            // enqueue the link for the block
-            diy::Link* send_link = master.link(master.lid(move_info.move_gid));
-            diy::LinkFactory::save(bb, send_link);
-            cp.enqueue(dest_block, bb.buffer);
-
-            // remove the block from the master
-            master.destroyer()(master.release(move_info.move_gid));
+            // serialize the link and the block straight into the outgoing queue, and remove the block from the master
+            ab->migrated.save(move_info.move_gid, cp.outgoing(dest_block));
 
             // debug
             // fmt::print(stderr, "move_block(): moving gid {} from proc {} to proc {}\n", move_info.move_gid, move_info.src_proc, move_info.dst_proc);
@@ -183,23 +199,16 @@ inline void recv_block(AuxBlock*,                                      // local
         int gid = incoming_gids[i];
         if (cp.incoming(gid).size())
         {
-            // dequeue the gid of the moving block
+            // dequeue the gid of the moving block, and its measured cost
             int move_gid;
+            double cost;
             cp.dequeue(gid, move_gid);
+            cp.dequeue(gid, cost);
 
-            // dequeue the block
-            void* recv_b = master.creator()();
-            diy::MemoryBuffer bb;
-            cp.dequeue(gid, bb.buffer);
-            master.loader()(recv_b, bb);
-
-            // dequeue the link
-            diy::Link* recv_link;
-            cp.dequeue(gid, bb.buffer);
-            recv_link = diy::LinkFactory::load(bb);
-
-            // add block to the master
-            master.add(move_gid, recv_b, recv_link);
+            // load the link and the block in place from the incoming queue, and add them to the master
+            load_migrated_block(master, move_gid, cp.incoming(gid));
+            if (cost > 0)
+                master.set_block_cost(move_gid, cost);
 
             // record the move
             move_info.move_gid = move_gid;
@@ -214,12 +223,13 @@ inline void move_sample_blocks(Master&                         master,
                                Master&                         aux_master,             // auxiliary master with 1 block per process for communcating between procs
                                const std::vector<WorkInfo>&    sample_work_info,       // sampled work info
                                const WorkInfo&                 my_work_info,           // my work info
+                               const std::vector<Work>&        my_work,                // work of my blocks, by lid
                                float                           quantile,               // quantile cutoff above which to move blocks (0.0 - 1.0)
                                MoveInfo&                       move_info)              // block that was moved
 {
     // rexchange moving blocks
     aux_master.foreach([&](AuxBlock* b, const diy::Master::ProxyWithLink& cp)
-            { send_block(b, cp, master, sample_work_info, my_work_info, quantile); });
+            { send_block(b, cp, master, sample_work_info, my_work_info, my_work, quantile); });
     aux_master.exchange(true);      // true = remote
     aux_master.foreach([&](AuxBlock* b, const diy::Master::ProxyWithLink& cp)
             { recv_block(b, cp, master, move_info); });
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "diy/dynamic-point.hpp"
+#include <algorithm>
+#include <climits>
 #include <cstdlib>
 
 namespace diy
@@ -60,13 +62,125 @@ struct FreeBlock
     gid(gid_), work(work_), src_proc(src_proc_), origin_proc(origin_proc_) {}
 };
 
+// blocks that migrate out: each one is serialized, link first, straight into the buffer that carries it (an outgoing
+// queue, or the message itself), blobs included; a block whose saver added blobs is destroyed only once that buffer
+// is sent, since the blobs may point into it, any other block right away
+struct MigratedBlocks
+{
+    MigratedBlocks(Master& master_): master(master_)                {}
+    ~MigratedBlocks()                                               { destroy(); }
+
+    MigratedBlocks(const MigratedBlocks&)                           = delete;
+    MigratedBlocks& operator=(const MigratedBlocks&)                = delete;
+
+    // serialize block gid into out and remove it from the master
+    void save(int gid, MemoryBuffer& out)
+    {
+        LinkFactory::save(out, master.link(master.lid(gid)));
+        void* b = master.release(gid);
+        size_t nblobs = out.nblobs();
+        master.saver()(b, out);
+        if (out.nblobs() == nblobs)
+            master.destroyer()(b);
+        else
+            blocks.push_back(b);
+    }
+
+    void destroy()
+    {
+        for (void* b : blocks)
+            master.destroyer()(b);
+        blocks.clear();
+    }
+
+    Master&             master;
+    std::vector<void*>  blocks;                 // blocks whose blobs are still to be sent
+};
+
+// load a block saved by MigratedBlocks::save() in place from the received buffer, and add it to the master
+inline void load_migrated_block(Master& master, int gid, MemoryBuffer& in)
+{
+    Link* link = LinkFactory::load(in);
+    void* b = master.creator()();
+    master.loader()(b, in);
+    master.add(gid, b, link);
+}
+
+// send a buffer with its blobs, without copying them: the buffer, with the sizes of the blobs and their number at its
+// end, then every blob in messages of at most piece bytes with the same tag (MPI counts are ints); bb and its blobs
+// must live until the requests complete
+inline void isend_with_blobs(const mpi::communicator&     comm,
+                             int                          dest,
+                             int                          tag,
+                             MemoryBuffer&                bb,
+                             std::vector<mpi::request>&   requests,
+                             size_t                       piece = INT_MAX)
+{
+    for (auto& blob : bb.blobs)
+        diy::save(bb, blob.size);
+    diy::save(bb, bb.nblobs());
+    requests.push_back(comm.isend(dest, tag, bb.buffer));
+    for (auto& blob : bb.blobs)
+        for (size_t from = 0; from < blob.size; from += piece)
+            requests.push_back(mpi::detail::isend(comm.handle(), dest, tag, blob.pointer.get() + from,
+                                                  static_cast<int>((std::min)(piece, blob.size - from)),
+                                                  mpi::detail::get_mpi_datatype<char>()));
+}
+
+// receive a buffer sent with isend_with_blobs() (with the same piece); the blobs keep the memory they were received into
+inline void recv_with_blobs(const mpi::communicator&      comm,
+                            int                           source,
+                            int                           tag,
+                            MemoryBuffer&                 bb,
+                            size_t                        piece = INT_MAX)
+{
+    comm.recv(source, tag, bb.buffer);
+    size_t nblobs;
+    diy::load_back(bb, nblobs);
+    std::vector<size_t> sizes(nblobs);
+    for (size_t i = nblobs; i > 0; i--)
+        diy::load_back(bb, sizes[i - 1]);
+    for (size_t size : sizes)
+    {
+        auto* blob = new std::vector<char>(size);
+        for (size_t from = 0; from < size; from += piece)
+            mpi::detail::recv(comm.handle(), source, tag, blob->data() + from,
+                              static_cast<int>((std::min)(piece, size - from)), mpi::detail::get_mpi_datatype<char>());
+        bb.save_binary_blob(blob->data(), blob->size(), [blob](const char[]) { delete blob; });
+    }
+}
+
+// preference for moving a block: its work relative to the heaviest candidate, plus locality times the fraction of
+// its link neighbors it would join on the destination, less the fraction it would leave behind on the source
+inline double move_score(Work work, Work max_work, int on_dst, int on_src, int degree, float locality)
+{
+    double score = max_work > 0 ? static_cast<double>(work) / static_cast<double>(max_work) : 0;
+    if (degree > 0)
+        score += static_cast<double>(locality) * static_cast<double>(on_dst - on_src) / static_cast<double>(degree);
+    return score;
+}
+
+// move_score() of a local block, counting its neighbors by the processes its link records
+inline double local_move_score(const Master& master, int gid, Work work, Work max_work, int dst_proc)
+{
+    const Link* link = master.link(master.lid(gid));
+    int rank = master.communicator().rank();
+    int on_dst = 0, on_src = 0;
+    for (int i = 0; i < link->size(); i++)
+    {
+        on_dst += link->target(i).proc == dst_proc;
+        on_src += link->target(i).proc == rank;
+    }
+    return move_score(work, max_work, on_dst, on_src, link->size(), master.balance_locality());
+}
+
 // auxiliary empty block structure
 struct AuxBlock
 {
     typedef           resource_accessor<std::vector<int>, fast_mutex>         accessor;
 
     AuxBlock(Master* master_)            // real master, (not auxiliary master)
-    : master(master_), nsent_reqs(NO_REQS), proc_work(NO_WORK), prev_proc_work(NO_WORK) {}
+    : master(master_), nsent_reqs(NO_REQS), proc_work(NO_WORK), prev_proc_work(NO_WORK), migrated(*master_) {}
 
     // initialize free blocks
     template<class GetWork>
@@ -148,6 +262,41 @@ struct AuxBlock
         return retval;
     }
 
+    // remove the free block to send to dst_proc, the best one by local_move_score() among those lighter than max_work
+    // that didn't come from dst_proc, and fill free block with it; returns its gid, or -1 if none qualifies
+    int grab_free_block_for(int dst_proc, Work max_work, FreeBlock& free_block)
+    {
+        auto free_blocks_access = free_blocks.access();
+        auto& blocks = *free_blocks_access;
+
+        Work heaviest = NO_WORK;
+        for (auto& b : blocks)
+            if (b.work < max_work && b.src_proc != dst_proc)
+                heaviest = std::max(heaviest, b.work);
+
+        auto   best       = blocks.end();
+        double best_score = 0;
+        for (auto it = blocks.begin(); it != blocks.end(); ++it)
+        {
+            if (it->work >= max_work || it->src_proc == dst_proc)
+                continue;
+            double score = local_move_score(*master, it->gid, it->work, heaviest, dst_proc);
+            if (best == blocks.end() || score > best_score)
+            {
+                best       = it;
+                best_score = score;
+            }
+        }
+        if (best == blocks.end())
+            return NO_GID;
+
+        free_block = *best;
+        proc_work -= free_block.work;
+        std::swap(*best, blocks.back());
+        blocks.pop_back();
+        return free_block.gid;
+    }
+
     // add a block to the end of the free blocks list
     void add_free_block(FreeBlock& free_block)
     {
@@ -205,6 +354,7 @@ struct AuxBlock
     std::atomic<bool>                      iexchange_done{false};   // whether iexchange_balance is still running or is done
     std::atomic<Work>                      proc_work;               // total work for my process
     Work                                   prev_proc_work;          // previous proc_work, to know if it changed
+    MigratedBlocks                         migrated;                // blocks sent away with blobs, destroyed with the auxiliary block
 };
 
 }  // namespace detail
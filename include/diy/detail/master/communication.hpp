@@ -6,6 +6,8 @@ namespace diy
         int nparts;
         int round;
         int nblobs;
+        int encoding;               // TemporalDeltas::Encoding
+        int compressed;             // with the wire codec (the original size precedes the compressed bytes)
     };
 
     struct Master::InFlightSend
@@ -20,10 +22,14 @@ namespace diy
     struct Master::InFlightRecv
     {
         MemoryBuffer    message;
-        MessageInfo     info { -1, -1, -1, -1, -1 };
+        MessageInfo     info { -1, -1, -1, -1, -1, 0, 0 };
         bool            done = false;
         MemoryManagement mem;
 
+        size_t          msg_size = 0;                       // total size of a multi-part message
+        std::unique_ptr<ExternalStorage::Writer> writer;    // if set, the parts go straight to storage (never for compressed messages)
+        MemoryBuffer::Buffer part;                          // receive buffer for the streamed parts
+
         inline bool     recv(mpi::communicator& comm, const mpi::status& status);
         inline void     place(IncomingRound* in, bool unload, ExternalStorage* storage, IExchangeInfo* iexchange);
         void            reset()
@@ -109,16 +115,27 @@ recv(mpi::communicator& comm, const mpi::status& status)
 
         diy::load_back(bb, info);
         info.nparts--;
-        if (info.nparts > 0)        // multi-part message
-        {
-            size_t msg_size;
+        if (info.nparts > 0)        // multi-part message; the caller decides where the parts go
             diy::load(bb, msg_size);
-            message.buffer.reserve(msg_size);
-        } else
+        else
             message.swap(bb);
 
         result = true;
     }
+    else if (info.nparts > 0 && writer)
+    {
+        size_t count = status.count<char>();
+        part.resize(count);
+
+        detail::VectorWindow<char> window;
+        window.begin = part.data();
+        window.count = count;
+
+        comm.recv(status.source(), status.tag(), window);
+        writer->write(part.data(), count);
+
+        info.nparts--;
+    }
     else if (info.nparts > 0)
     {
         size_t start_idx = message.buffer.size();
@@ -166,7 +183,13 @@ place(IncomingRound* in, bool unload, ExternalStorage* storage, IExchangeInfo*)
     message.reset();
 
     auto access = in->map[to][from].access();
-    access->emplace_back(std::move(message));
+    if (writer)                 // the parts have been streamed to storage; only the blobs are in memory
+    {
+        get_logger()->debug("Streamed queue {} <- {} to storage", to, from);
+        int external = writer->close();
+        access->emplace_back(std::move(message), msg_size, external);
+    } else
+        access->emplace_back(std::move(message));
 
     if (unload)
     {
@@ -176,3 +199,59 @@ place(IncomingRound* in, bool unload, ExternalStorage* storage, IExchangeInfo*)
 
     ++(in->received);
 }
+
+// compress the payload with the wire codec, if that makes it smaller
+void
+diy::Master::
+compress_message(MemoryBuffer& payload, MessageInfo& info)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    size_t count = payload.size();
+    std::vector<char> compressed(sizeof(size_t));
+    std::memcpy(compressed.data(), &count, sizeof(size_t));
+    wire_codec_->compress(payload.buffer.data(), count, compressed);
+
+    auto stats = wire_stats_.access();
+    stats->compress_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (compressed.size() >= count)
+    {
+        ++stats->incompressible;
+        return;
+    }
+
+    ++stats->messages;
+    stats->raw_bytes        += count;
+    stats->compressed_bytes += compressed.size();
+
+    payload.buffer.assign(compressed.begin(), compressed.end());
+    payload.position = payload.size();
+    info.compressed  = 1;
+}
+
+void
+diy::Master::
+decompress_message(MessageInfo& info, MemoryBuffer& payload)
+{
+    if (!info.compressed)
+        return;
+
+    if (!wire_codec_)
+        throw std::runtime_error(fmt::format("Received a compressed message {} <- {}, but no wire codec is set (see Master::set_wire_compression())", info.to, info.from));
+    if (payload.size() < sizeof(size_t))
+        throw std::runtime_error("Corrupted compressed message");
+
+    auto start = std::chrono::steady_clock::now();
+
+    size_t count;
+    std::memcpy(&count, payload.buffer.data(), sizeof(size_t));
+    MemoryBuffer::Buffer original(payload.buffer.get_allocator());
+    original.resize(count);
+    wire_codec_->decompress(payload.buffer.data() + sizeof(size_t), payload.size() - sizeof(size_t), original.data(), count);
+    payload.buffer.swap(original);
+    info.compressed = 0;
+
+    auto stats = wire_stats_.access();
+    stats->decompress_time    += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats->decompressed_bytes += count;
+}
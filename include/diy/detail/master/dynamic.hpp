@@ -9,6 +9,7 @@
 #include <cstdio>
 #include <iterator>
 #include <memory>
+#include <thread>
 #include <vector>
 
 namespace diy
@@ -17,90 +18,69 @@ namespace diy
 namespace detail
 {
 
-inline void dynamic_send_queue_buffer(const diy::Master::ProxyWithLink& cp,
-                                      const diy::BlockID&               dest_block,
-                                      const diy::MemoryBuffer&          bb)
+// save a queue record into out; its unread blobs aren't copied, they move into out, which carries them as they are
+inline void dynamic_save_queue_buffer(diy::MemoryBuffer&          out,
+                                      diy::MemoryBuffer&          bb)
 {
-    cp.enqueue(dest_block, bb.position);
-    cp.enqueue(dest_block, bb.buffer);
-    cp.enqueue(dest_block, bb.blob_position);
-
-    size_t num_blobs = bb.blobs.size();
-    cp.enqueue(dest_block, num_blobs);
-    assert(bb.blob_position <= num_blobs);
-    for (size_t i = 0; i < num_blobs; ++i)
-    {
-        const auto& blob = bb.blobs[i];
-        std::vector<char> blob_buffer;
-        if (i >= bb.blob_position && blob.size > 0)
-        {
-            assert(blob.pointer);
-            blob_buffer.assign(blob.pointer.get(), blob.pointer.get() + blob.size);
-        }
-        cp.enqueue(dest_block, blob_buffer);
-    }
+    diy::save(out, bb.position);
+    diy::save(out, bb.buffer);
+
+    assert(bb.blob_position <= bb.blobs.size());
+    size_t num_blobs = bb.blobs.size() - bb.blob_position;
+    diy::save(out, num_blobs);
+    for (size_t i = bb.blob_position; i < bb.blobs.size(); ++i)
+        out.blobs.emplace_back(std::move(bb.blobs[i]));
+    bb.blobs.erase(bb.blobs.begin() + static_cast<std::ptrdiff_t>(bb.blob_position), bb.blobs.end());
 }
 
-inline diy::MemoryBuffer dynamic_recv_queue_buffer(const diy::Master::ProxyWithLink& cp,
-                                                   int                               gid)
+inline diy::MemoryBuffer dynamic_load_queue_buffer(diy::MemoryBuffer& in)
 {
     diy::MemoryBuffer bb;
-    cp.dequeue(gid, bb.position);
-    cp.dequeue(gid, bb.buffer);
-    cp.dequeue(gid, bb.blob_position);
+    diy::load(in, bb.position);
+    diy::load(in, bb.buffer);
 
     size_t num_blobs;
-    cp.dequeue(gid, num_blobs);
+    diy::load(in, num_blobs);
     for (size_t i = 0; i < num_blobs; ++i)
-    {
-        std::vector<char> blob_buffer;
-        cp.dequeue(gid, blob_buffer);
-
-        size_t blob_size = blob_buffer.size();
-        std::unique_ptr<char[]> blob(new char[blob_size ? blob_size : 1]);
-        if (blob_size > 0)
-            std::copy(blob_buffer.begin(), blob_buffer.end(), blob.get());
-        bb.save_binary_blob(blob.release(), blob_size, [](const char x[]) { delete[] x; });
-    }
+        bb.blobs.emplace_back(in.load_binary_blob());
 
     return bb;
 }
 
-inline void dynamic_send_incoming_queues(const diy::Master::ProxyWithLink& cp,
-                                         const diy::BlockID&               dest_block,
-                                         diy::Master::IncomingQueues&      in_qs)
+// serialize the incoming queues of a moving block, with explicit source/count metadata
+inline void dynamic_save_incoming_queues(diy::MemoryBuffer&               out,
+                                         diy::Master::IncomingQueues&     in_qs)
 {
     size_t num_sources = 0;
     for (auto& x : in_qs)
         if (!x.second.access()->empty())
             ++num_sources;
 
-    cp.enqueue(dest_block, num_sources);
+    diy::save(out, num_sources);
     for (auto& x : in_qs)
     {
         auto access = x.second.access();
         if (access->empty())
             continue;
 
-        cp.enqueue(dest_block, x.first);
+        diy::save(out, x.first);
 
         size_t num_records = access->size();
-        cp.enqueue(dest_block, num_records);
+        diy::save(out, num_records);
         for (diy::Master::QueueRecord& qr : *access)
         {
             assert(!qr.external());
-            dynamic_send_queue_buffer(cp, dest_block, qr.buffer());
+            dynamic_save_queue_buffer(out, qr.buffer());
         }
     }
 }
 
-inline void dynamic_recv_incoming_queues(const diy::Master::ProxyWithLink& cp,
-                                         diy::Master&                      master,
-                                         int                               gid,
-                                         int                               move_gid)
+inline void dynamic_load_incoming_queues(diy::MemoryBuffer&               in,
+                                         diy::Master&                     master,
+                                         int                              move_gid)
 {
     size_t num_sources;
-    cp.dequeue(gid, num_sources);
+    diy::load(in, num_sources);
 
     // Preserve any queues for this gid that arrived independently before the
     // block payload; migrated queues are appended from explicit metadata.
@@ -108,17 +88,33 @@ inline void dynamic_recv_incoming_queues(const diy::Master::ProxyWithLink& cp,
     for (size_t i = 0; i < num_sources; ++i)
     {
         int source_gid;
-        cp.dequeue(gid, source_gid);
+        diy::load(in, source_gid);
 
         size_t num_records;
-        cp.dequeue(gid, num_records);
+        diy::load(in, num_records);
 
         auto access = in_qs[source_gid].access();
         for (size_t j = 0; j < num_records; ++j)
-            access->emplace_back(dynamic_recv_queue_buffer(cp, gid));
+            access->emplace_back(dynamic_load_queue_buffer(in));
     }
 }
 
+// the incoming queues of a moving block, straight into the outgoing queue to dest_block, and back
+inline void dynamic_send_incoming_queues(const diy::Master::ProxyWithLink& cp,
+                                         const diy::BlockID&               dest_block,
+                                         diy::Master::IncomingQueues&      in_qs)
+{
+    dynamic_save_incoming_queues(cp.outgoing(dest_block), in_qs);
+}
+
+inline void dynamic_recv_incoming_queues(const diy::Master::ProxyWithLink& cp,
+                                         diy::Master&                      master,
+                                         int                               gid,
+                                         int                               move_gid)
+{
+    dynamic_load_incoming_queues(cp.incoming(gid), master, move_gid);
+}
+
 // send requests for work info
 inline void dynamic_send_req(const diy::Master::ProxyWithLink&  cp,                        // communication proxy
                              std::set<int>&                     procs)                     // processes to query
@@ -176,14 +172,20 @@ inline void dynamic_send_block(const diy::Master::ProxyWithLink&   cp,
     auto dst_work_info = ab->sample_work_info[target];
 
     // send my heaviest block if it passes multiple tests
+    // (with locality, the block that best keeps its neighbors together among those that pass them)
     int retval;
-    if ((retval = ab->grab_heaviest_free_block(heaviest_block)) >= 0     &&                // heaviest block is free to grab
+    if (master.balance_locality() > 0)
+        retval = ab->grab_free_block_for(dst_work_info.proc_rank,
+                                         proc_work > dst_work_info.proc_work ? proc_work - dst_work_info.proc_work : NO_WORK,
+                                         heaviest_block);
+    else
+        retval = ab->grab_heaviest_free_block(heaviest_block);
+    if (retval >= 0                                                      &&                // heaviest block is free to grab
         proc_work - dst_work_info.proc_work > heaviest_block.work        &&                // improves load balance
         heaviest_block.src_proc != dst_work_info.proc_rank               &&                // doesn't return block immediately to sender
         ab->any_free_blocks())                                                             // doesn't leave me with no blocks
     {
         int move_gid    = heaviest_block.gid;
-        int move_lid    = master.lid(move_gid);
         int dst_proc    = dst_work_info.proc_rank;
         int move_work   = heaviest_block.work;
         int origin_proc = heaviest_block.origin_proc;
@@ -214,18 +216,8 @@ inline void dynamic_send_block(const diy::Master::ProxyWithLink&   cp,
         // debug
 //         fmt::print(stderr, "dynamic_send_block: src proc {} -> gid {} -> dst proc {}\n", master.communicator().rank(), move_gid, dst_proc);
 
-        diy::MemoryBuffer block_bb, link_bb;
-
-        // serialize the block and the link and remove the block from the master
-        diy::Link* send_link = master.link(move_lid);
-        diy::LinkFactory::save(link_bb, send_link);
-        void* send_block = master.release(move_gid);
-        master.saver()(send_block, block_bb);
-        master.destroyer()(send_block);
-
-        // enqueue the block and the link
-        cp.enqueue(dest_block, block_bb.buffer);
-        cp.enqueue(dest_block, link_bb.buffer);
+        // serialize the link and the block straight into the outgoing queue, and remove the block from the master
+        ab->migrated.save(move_gid, cp.outgoing(dest_block));
     }
     else if (retval >= 0)        // replace the block if there was one but it wasn't used
         ab->add_free_block(heaviest_block);
@@ -284,20 +276,8 @@ inline void dynamic_recv(const diy::Master::ProxyWithLink&  cp,
                     // NB: we didn't send the outgoing queues in dynamic_send_block
                     // so no outgoing queues to receive here
 
-                    // dequeue the block
-                    diy::MemoryBuffer block_bb;
-                    void* recv_b = master.creator()();
-                    cp.dequeue(gid, block_bb.buffer);
-                    master.loader()(recv_b, block_bb);
-
-                    // dequeue the link
-                    diy::MemoryBuffer link_bb;
-                    diy::Link* recv_link;
-                    cp.dequeue(gid, link_bb.buffer);
-                    recv_link = diy::LinkFactory::load(link_bb);
-
-                    // add block to the master
-                    master.add(move_gid, recv_b, recv_link);
+                    // load the link and the block in place from the incoming queue, and add them to the master
+                    load_migrated_block(master, move_gid, cp.incoming(gid));
 
                     // update free blocks
                     FreeBlock free_block(move_gid, move_work, gid, origin_proc);
@@ -386,6 +366,265 @@ void dynamic_balance(diy::Master*                    master,                 //
     diy::fix_links(*master, *dynamic_assigner);
 }
 
+// work stealing through a window: every process publishes the number of its own blocks that are free to steal,
+// and a process without free blocks claims one from a victim with compare-and-swap on that number, without
+// waiting for the victim to answer anything; the victim then sends the block it owes
+
+struct StealTags { enum { claim, block }; };
+
+// number of my own free blocks, i.e., those that haven't been stolen from somebody else
+inline int dynamic_count_stealable(AuxBlock* ab, int rank)
+{
+    auto free_blocks = ab->free_blocks.access();
+    return static_cast<int>(std::count_if(free_blocks->begin(), free_blocks->end(),
+                                          [rank](const FreeBlock& b) { return b.src_proc == rank; }));
+}
+
+// remove my heaviest own free block, or with locality, the one that best keeps its neighbors together on the thief
+inline bool dynamic_grab_stealable_block(Master& master, AuxBlock* ab, int rank, int thief, FreeBlock& free_block)
+{
+    auto free_blocks = ab->free_blocks.access();
+    auto heaviest = free_blocks->end();
+    for (auto it = free_blocks->begin(); it != free_blocks->end(); ++it)
+        if (it->src_proc == rank && (heaviest == free_blocks->end() || it->work > heaviest->work))
+            heaviest = it;
+    if (heaviest == free_blocks->end())
+        return false;
+
+    auto best = heaviest;
+    if (master.balance_locality() > 0)
+    {
+        double best_score = local_move_score(master, best->gid, best->work, heaviest->work, thief);
+        for (auto it = free_blocks->begin(); it != free_blocks->end(); ++it)
+        {
+            if (it->src_proc != rank || it == heaviest)
+                continue;
+            double score = local_move_score(master, it->gid, it->work, heaviest->work, thief);
+            if (score > best_score)
+            {
+                best       = it;
+                best_score = score;
+            }
+        }
+    }
+
+    free_block = *best;
+    ab->proc_work -= free_block.work;
+    free_blocks->erase(best);
+    return true;
+}
+
+// lower my published count to the number of stealable blocks I have left, if it's higher
+// (thieves only ever decrease it too, so every count goes down to zero)
+inline void dynamic_publish_stealable(mpi::window<int>& stealable, int rank, int left)
+{
+    int count;
+    stealable.fetch(count, rank, 0);
+    stealable.flush(rank);
+    while (count > left)
+    {
+        int result;
+        stealable.compare_and_swap(left, count, result, rank, 0);
+        stealable.flush(rank);
+        if (result == count)
+            break;
+        count = result;
+    }
+}
+
+// decrement the victim's count, unless it's zero; returns whether the claim succeeded
+inline bool dynamic_claim(mpi::window<int>& stealable, int victim, int count)
+{
+    while (count > 0)
+    {
+        int result;
+        stealable.compare_and_swap(count - 1, count, result, victim, 0);
+        stealable.flush(victim);
+        if (result == count)
+            return true;
+        count = result;
+    }
+    return false;
+}
+
+// pick the process with the most stealable blocks among a random sample, or among everybody if the sample has none;
+// returns -1 if nobody has any left
+inline int dynamic_pick_victim(mpi::window<int>&   stealable,
+                               Master&             master,
+                               float               sample_frac,
+                               int&                count)
+{
+    int nprocs  = master.communicator().size();
+    int my_proc = master.communicator().rank();
+
+    std::vector<int> others;
+    for (int i = 0; i < nprocs; i++)
+        if (i != my_proc)
+            others.push_back(i);
+    std::shuffle(others.begin(), others.end(), master.mt_gen);
+
+    size_t nsamples = std::max<size_t>(1, static_cast<size_t>(sample_frac * static_cast<float>(others.size())));
+    size_t from = 0;
+    while (from < others.size())
+    {
+        size_t to = std::min(others.size(), from + nsamples);
+        std::vector<int> counts(to - from);
+        for (size_t i = from; i < to; i++)
+            stealable.fetch(counts[i - from], others[i], 0);
+        stealable.flush_local_all();
+
+        auto max = std::max_element(counts.begin(), counts.end());
+        if (*max > 0)
+        {
+            count = *max;
+            return others[from + static_cast<size_t>(max - counts.begin())];
+        }
+
+        from   = to;
+        nsamples = others.size();       // the sample came up empty: check everybody else
+    }
+    return -1;
+}
+
+// send the block the thief claimed, or nothing, if my compute thread took my last stealable blocks in the meantime
+inline void dynamic_send_stolen_block(const mpi::communicator&  comm,
+                                      Master&                   master,
+                                      AuxBlock*                 ab,
+                                      int                       thief)
+{
+    FreeBlock free_block;
+    bool found = dynamic_grab_stealable_block(master, ab, comm.rank(), thief, free_block);
+
+    MigratedBlocks    migrated(master);
+    diy::MemoryBuffer bb;
+    diy::save(bb, found);
+    if (found)
+    {
+        int move_gid = free_block.gid;
+        diy::save(bb, move_gid);
+        diy::save(bb, free_block.work);
+        diy::save(bb, free_block.origin_proc);
+
+        master.load_all_incoming(move_gid);
+        dynamic_save_incoming_queues(bb, master.incoming(move_gid));
+        migrated.save(move_gid, bb);
+    }
+
+    std::vector<mpi::request> requests;
+    isend_with_blobs(comm, thief, StealTags::block, bb, requests);
+    for (auto& r : requests)
+        r.wait();
+}
+
+inline void dynamic_recv_stolen_block(const mpi::communicator&  comm,
+                                      Master&                   master,
+                                      AuxBlock*                 ab,
+                                      int                       victim,
+                                      std::vector<MoveInfo>&    moved_blocks)
+{
+    diy::MemoryBuffer bb;
+    recv_with_blobs(comm, victim, StealTags::block, bb);
+
+    bool found;
+    diy::load(bb, found);
+    if (!found)
+        return;
+
+    int  move_gid, origin_proc;
+    Work move_work;
+    diy::load(bb, move_gid);
+    diy::load(bb, move_work);
+    diy::load(bb, origin_proc);
+
+    dynamic_load_incoming_queues(bb, master, move_gid);
+    load_migrated_block(master, move_gid, bb);
+
+    FreeBlock free_block(move_gid, move_work, victim, origin_proc);
+    ab->add_free_block(free_block);
+
+    moved_blocks.push_back(MoveInfo(move_gid, victim, comm.rank()));
+}
+
+inline
+void dynamic_balance_rma(diy::Master*                    master,                 // the real master with multiple blocks per process
+                         detail::AuxBlock*               ab,                     // free blocks, shared with the compute thread
+                         diy::DynamicAssigner*           dynamic_assigner,       // dynamic assigner
+                         float                           sample_frac,            // fraction of procs to sample when picking a victim 0.0 < sample_size <= 1.0
+                         std::vector<MoveInfo>&          moved_blocks)           // record of moved blocks
+{
+    mpi::communicator comm;
+    comm.duplicate(master->communicator());
+    int rank = comm.rank();
+
+    mpi::window<int> stealable(comm, 1);
+    stealable.lock_all(mpi::nocheck);
+
+    int left = dynamic_count_stealable(ab, rank);
+    stealable.replace(left, rank, 0);
+    stealable.flush(rank);
+    comm.barrier();
+
+    int                 victim          = -1;           // of my outstanding claim
+    bool                done_stealing   = false;
+    bool                in_barrier      = false;
+    mpi::request        barrier;
+    while (!in_barrier || !barrier.test())
+    {
+        // serve the claims on my blocks
+        while (auto s = comm.iprobe(mpi::any_source, StealTags::claim))
+        {
+            int thief;
+            comm.recv(s->source(), StealTags::claim, thief);
+            dynamic_send_stolen_block(comm, *master, ab, thief);
+        }
+
+        // collect the block I claimed
+        if (victim != -1 && comm.iprobe(victim, StealTags::block))
+        {
+            dynamic_recv_stolen_block(comm, *master, ab, victim, moved_blocks);
+            victim = -1;
+        }
+
+        int cur_left = dynamic_count_stealable(ab, rank);
+        if (cur_left < left)
+        {
+            dynamic_publish_stealable(stealable, rank, cur_left);
+            left = cur_left;
+        }
+
+        // steal, if I'm out of work
+        if (victim == -1 && !done_stealing && !ab->any_free_blocks())
+        {
+            int count;
+            int v = dynamic_pick_victim(stealable, *master, sample_frac, count);
+            if (v == -1)
+                done_stealing = true;       // the counts only go down: nobody will have anything to steal
+            else if (dynamic_claim(stealable, v, count))
+            {
+                comm.send(v, StealTags::claim, rank);
+                victim = v;
+            }
+        }
+
+        if (done_stealing && victim == -1 && !in_barrier)
+        {
+            barrier    = comm.ibarrier();
+            in_barrier = true;
+        }
+
+        std::this_thread::yield();
+    }
+
+    stealable.unlock_all();
+
+    // let the compute thread finish the blocks it has before it stops looking for more
+    while (ab->any_free_blocks())
+        std::this_thread::yield();
+    ab->iexchange_done = true;
+
+    diy::fix_links(*master, *dynamic_assigner);
+}
+
 }    // namespace detail
 
 }    // namespace diy
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <chrono>
 
 struct diy::Master::ProcessBlock
 {
@@ -36,6 +37,8 @@ struct diy::Master::ProcessBlock
           if (local.size() == (size_t)local_limit)
               master.unload(local);
           local.push_back(i);
+
+          master.load_incoming(gid);        // queues may have gone to storage while the block was out of core
       }
 
       master.log->debug("Processing block: {}", gid);
@@ -61,6 +64,7 @@ struct diy::Master::ProcessBlock
       // For unloaded blocks, skip avoids loading the block; it does not suppress
       // callbacks. foreach() callbacks may still need to process queues/bookkeeping,
       // and receive a null block pointer when skip is active.
+      auto start = std::chrono::steady_clock::now();
       for (auto& cmd : master.commands_)
       {
           cmd->execute(skip ? 0 : master.block(i), master.proxy(i));
@@ -68,6 +72,8 @@ struct diy::Master::ProcessBlock
           // no longer need them, so get rid of them
           current_incoming[gid].clear();
       }
+      if (!skip)
+          master.add_block_time(gid, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
 
       if (skip && master.block(i) == 0)
           master.unload_queues(i);    // even though we are skipping the block, the queues might be necessary
@@ -153,6 +159,8 @@ execute()
       ProcessBlock(*this, blocks, blocks_per_thread, idx)();
   }
 
+  update_block_costs();
+
   // clear incoming queues
   incoming_[exchange_round_].map.clear();
 
@@ -207,3 +215,59 @@ dynamic_execute(detail::AuxBlock& aux_block)
     // clear commands
     commands_.clear();
 }
+
+void
+diy::Master::
+add_block_time(int gid, double seconds)
+{
+    auto& cost = (*block_costs_.access())[gid];
+    cost.current += seconds;
+    cost.ran      = true;
+}
+
+void
+diy::Master::
+update_block_costs()
+{
+    auto costs = block_costs_.access();
+    for (auto& x : *costs)
+    {
+        BlockCost& cost = x.second;
+        if (!cost.ran)
+            continue;
+
+        cost.estimate = cost.measured ? cost_smoothing_ * cost.current + (1 - cost_smoothing_) * cost.estimate : cost.current;
+        cost.measured = true;
+        cost.current  = 0;
+        cost.ran      = false;
+    }
+}
+
+double
+diy::Master::
+block_cost(int gid) const
+{
+    auto costs = block_costs_.const_access();
+    auto it = costs->find(gid);
+    return it == costs->end() ? 0 : it->second.estimate;
+}
+
+void
+diy::Master::
+set_block_cost(int gid, double cost)
+{
+    auto& c = (*block_costs_.access())[gid];
+    c.estimate = cost;
+    c.measured = true;
+}
+
+diy::Master::WCallback<void>
+diy::Master::
+measured_work() const
+{
+    return [this](void*, int gid)
+    {
+        double us = block_cost(gid) * 1e6;
+        return us >= static_cast<double>(std::numeric_limits<Work>::max()) ? std::numeric_limits<Work>::max() : static_cast<Work>(us + .5);
+    };
+}
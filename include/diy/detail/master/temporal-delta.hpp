@@ -0,0 +1,188 @@
+namespace diy
+{
+    // Payloads last exchanged between pairs of blocks, for the temporal delta encoding
+    // (see Master::set_temporal_delta())
+    struct Master::TemporalDeltas
+    {
+        enum Encoding { plain = 0, reference = 1, delta = 2 };      // reference: plain, and the receiver keeps a copy
+
+        struct Sent
+        {
+            int                 proc = -1;
+            std::vector<char>   payload;
+        };
+
+        using Pair = std::pair<int,int>;                            // (from, to)
+
+        std::map<Pair, Sent>                sent;
+        std::map<Pair, std::vector<char>>   received;
+        size_t                              bytes_saved = 0;
+    };
+
+    namespace detail
+    {
+        // XOR of the payload with the previous one, as alternating runs of zeros and literal bytes:
+        // [size] ([zeros] [count] [count bytes])*, all the numbers varints.
+        // Gives up, returning false, as soon as the encoding isn't smaller than the payload.
+        inline bool delta_encode(const char* cur, const char* prev, size_t n, std::vector<char>& out)
+        {
+            static const size_t min_zeros = 8;      // shorter runs of zeros stay in the literals
+
+            out.resize(n + varint::max_bytes);
+            char* o   = out.data();
+            char* end = o + n;
+
+            o += varint::encode(n, o);
+
+            size_t i = 0;
+            while (i < n)
+            {
+                size_t zeros_start = i;
+                while (i + sizeof(uint64_t) <= n)
+                {
+                    uint64_t x, y;
+                    std::memcpy(&x, cur + i, sizeof(x));
+                    std::memcpy(&y, prev + i, sizeof(y));
+                    if (x != y)
+                        break;
+                    i += sizeof(uint64_t);
+                }
+                while (i < n && cur[i] == prev[i])
+                    ++i;
+                size_t zeros = i - zeros_start;
+
+                // literal: up to the next run of min_zeros equal bytes
+                size_t literal_start = i, same = 0;
+                while (i < n && same < min_zeros)
+                {
+                    same = cur[i] == prev[i] ? same + 1 : 0;
+                    ++i;
+                }
+                if (same == min_zeros)
+                    i -= same;
+                size_t count = i - literal_start;
+
+                if (o + 2*varint::max_bytes + count >= end)
+                    return false;
+
+                o += varint::encode(zeros, o);
+                o += varint::encode(count, o);
+                for (size_t j = literal_start; j < i; ++j)
+                    *o++ = static_cast<char>(cur[j] ^ prev[j]);
+            }
+
+            out.resize(static_cast<size_t>(o - out.data()));
+            return true;
+        }
+
+        inline void delta_decode(const char* in, size_t count, const std::vector<char>& prev, std::vector<char>& out)
+        {
+            const char* end = in + count;
+            size_t n = static_cast<size_t>(varint::decode(in, end));
+            if (n != prev.size())
+                throw std::runtime_error(fmt::format("Temporal delta of {} bytes against a reference of {} bytes", n, prev.size()));
+
+            out = prev;
+            size_t i = 0;
+            while (in < end)
+            {
+                i += static_cast<size_t>(varint::decode(in, end));
+                size_t literal = static_cast<size_t>(varint::decode(in, end));
+                if (i + literal > n || literal > static_cast<size_t>(end - in))
+                    throw std::runtime_error("Corrupted temporal delta");
+                for (size_t j = 0; j < literal; ++j)
+                    out[i++] ^= *in++;
+            }
+        }
+    }
+}
+
+// replace the payload with its difference from the last one sent from the same block to the same block,
+// if that's smaller; called only for the payloads sent in one message, which the receiver reconstructs
+// as they arrive
+void
+diy::Master::
+encode_temporal_delta(int proc, MemoryBuffer& payload, MessageInfo& info)
+{
+    auto& deltas = *temporal_deltas_;
+    auto& sent   = deltas.sent[TemporalDeltas::Pair(info.from, info.to)];
+
+    std::vector<char> current(payload.buffer.begin(), payload.buffer.end());
+    info.encoding = TemporalDeltas::reference;
+
+    // the receiver's copy matches ours only if it was the last one to receive from this pair;
+    // if the target block has moved since, start over
+    std::vector<char> delta;
+    if (sent.proc == proc && !sent.payload.empty() && sent.payload.size() == current.size() &&
+        detail::delta_encode(current.data(), sent.payload.data(), current.size(), delta))
+    {
+        deltas.bytes_saved += current.size() - delta.size();
+        payload.buffer.assign(delta.begin(), delta.end());
+        payload.position = payload.buffer.size();
+        info.encoding = TemporalDeltas::delta;
+    }
+
+    sent.proc = proc;
+    sent.payload.swap(current);
+}
+
+void
+diy::Master::
+decode_temporal_delta(MessageInfo& info, MemoryBuffer& payload)
+{
+    auto& received = temporal_deltas_->received;
+    TemporalDeltas::Pair pair(info.from, info.to);
+
+    if (info.encoding == TemporalDeltas::plain)
+    {
+        if (!received.empty())
+            received.erase(pair);
+        return;
+    }
+
+    auto& reference = received[pair];
+    if (info.encoding == TemporalDeltas::delta)
+    {
+        std::vector<char> current;
+        detail::delta_decode(payload.buffer.data(), payload.buffer.size(), reference, current);
+        payload.buffer.assign(current.begin(), current.end());
+        reference.swap(current);
+    } else
+        reference.assign(payload.buffer.begin(), payload.buffer.end());
+    info.encoding = TemporalDeltas::plain;
+}
+
+void
+diy::Master::
+set_temporal_delta(bool on)
+{
+    temporal_delta_ = on;
+    if (!on)
+        temporal_deltas_->sent.clear();     // the receivers drop their copies, once they get plain messages
+}
+
+size_t
+diy::Master::
+temporal_delta_bytes_saved() const
+{
+    return temporal_deltas_->bytes_saved;
+}
+
+size_t
+diy::Master::
+temporal_delta_memory() const
+{
+    size_t bytes = 0;
+    for (auto& x : temporal_deltas_->sent)
+        bytes += x.second.payload.size();
+    for (auto& x : temporal_deltas_->received)
+        bytes += x.second.size();
+    return bytes;
+}
+
+void
+diy::Master::
+reset_temporal_deltas()
+{
+    temporal_deltas_->sent.clear();
+}
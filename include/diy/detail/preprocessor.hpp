@@ -0,0 +1,48 @@
+#ifndef DIY_DETAIL_PREPROCESSOR_HPP
+#define DIY_DETAIL_PREPROCESSOR_HPP
+
+// Apply a macro to each of up to 32 arguments: DIY_PP_FOR_EACH(m, x, a, b, c) -> m(x, a) m(x, b) m(x, c).
+// DIY_PP_EXPAND forces another scan, which MSVC's traditional preprocessor needs to split __VA_ARGS__.
+
+#define DIY_PP_EXPAND(x) x
+#define DIY_PP_CAT(a, b) DIY_PP_CAT_(a, b)
+#define DIY_PP_CAT_(a, b) a ## b
+
+#define DIY_PP_NARGS(...) DIY_PP_EXPAND(DIY_PP_NARGS_(__VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+#define DIY_PP_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, N, ...) N
+
+#define DIY_PP_FOR_EACH(m, x, ...) DIY_PP_EXPAND(DIY_PP_CAT(DIY_PP_FOR_EACH_, DIY_PP_NARGS(__VA_ARGS__))(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_1(m, x, a) m(x, a)
+#define DIY_PP_FOR_EACH_2(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_1(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_3(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_2(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_4(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_3(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_5(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_4(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_6(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_5(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_7(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_6(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_8(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_7(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_9(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_8(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_10(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_9(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_11(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_10(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_12(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_11(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_13(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_12(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_14(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_13(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_15(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_14(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_16(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_15(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_17(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_16(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_18(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_17(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_19(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_18(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_20(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_19(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_21(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_20(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_22(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_21(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_23(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_22(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_24(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_23(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_25(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_24(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_26(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_25(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_27(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_26(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_28(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_27(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_29(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_28(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_30(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_29(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_31(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_30(m, x, __VA_ARGS__))
+#define DIY_PP_FOR_EACH_32(m, x, a, ...) m(x, a) DIY_PP_EXPAND(DIY_PP_FOR_EACH_31(m, x, __VA_ARGS__))
+
+#endif
@@ -129,7 +129,7 @@ namespace io
     if (comm.rank() == 0)
     {
       // round-about way of gather vector of vectors of GidOffsetCount to avoid registering a new mpi datatype
-      std::vector< std::vector<char> > gathered_offset_count_buffers;
+      std::vector<MemoryBuffer::Buffer> gathered_offset_count_buffers;
       MemoryBuffer oc_buffer; diy::save(oc_buffer, offset_counts);
       mpi::gather(comm, oc_buffer.buffer, gathered_offset_count_buffers, 0);
 
@@ -295,22 +295,22 @@ namespace split
 
         std::string filename = fmt::format("{}/{}", outfilename, master.gid(i));
 
-        ::diy::detail::FileBuffer bb(fopen(filename.c_str(), "w"));
+        ::diy::detail::FileBuffer bb(filename, ::diy::detail::FileBuffer::Mode::write);
 
         LinkFactory::save(bb, master.link(i));
         save(block, bb);
 
-        fclose(bb.file);
+        bb.close();
     }
 
     if (comm.rank() == 0)
     {
         // save the extra buffer
         std::string filename = outfilename + "/extra";
-        ::diy::detail::FileBuffer bb(fopen(filename.c_str(), "w"));
+        ::diy::detail::FileBuffer bb(filename, ::diy::detail::FileBuffer::Mode::write);
         ::diy::save(bb, size);
         ::diy::save(bb, extra);
-        fclose(bb.file);
+        bb.close();
     }
   }
 
@@ -333,11 +333,11 @@ namespace split
     size_t          size;
     {
         std::string filename = infilename + "/extra";
-        ::diy::detail::FileBuffer bb(fopen(filename.c_str(), "r"));
+        ::diy::detail::FileBuffer bb(filename, ::diy::detail::FileBuffer::Mode::read);
         ::diy::load(bb, size);
         ::diy::load(bb, extra);
         extra.reset();
-        fclose(bb.file);
+        bb.close();
     }
 
     // Get local gids from assigner
@@ -350,14 +350,14 @@ namespace split
     {
         std::string filename = fmt::format("{}/{}", infilename, gids[i]);
 
-        ::diy::detail::FileBuffer bb(fopen(filename.c_str(), "r"));
+        ::diy::detail::FileBuffer bb(filename, ::diy::detail::FileBuffer::Mode::read);
         Link* l = LinkFactory::load(bb);
         l->fix(assigner);
         void* b = master.create();
         load(b, bb);
         master.add(gids[i], b, l);
 
-        fclose(bb.file);
+        bb.close();
     }
   }
 
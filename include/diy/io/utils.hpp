@@ -10,10 +10,17 @@
 #else
 #include <unistd.h>     // mkstemp() on Mac
 #include <dirent.h>
+#include <sys/uio.h>    // writev(), preadv()
+#include <sys/statvfs.h>
+#include <climits>      // IOV_MAX
 #endif
 
+#include <algorithm>
+#include <limits>
 #include <cstdio>       // remove()
 #include <cstdlib>      // mkstemp() on Linux
+#include <memory>
+#include <string>
 #include <sys/stat.h>
 
 #include "../constants.h" // for DIY_UNUSED
@@ -149,6 +156,169 @@ namespace utils
 #endif
   }
 
+  //! A contiguous piece of memory taking part in a vectored read or write.
+  struct Segment
+  {
+    char*   data;
+    size_t  size;
+  };
+
+  /**
+   * writes all `n` segments to the current position of fd, using vectored
+   * writes where available. returns false on error.
+   */
+  inline bool writev(int fd, Segment* segments, int n)
+  {
+#if defined(_WIN32)
+    for (int i = 0; i < n; ++i)
+    {
+      const char* p = segments[i].data;
+      size_t left = segments[i].size;
+      while (left > 0)
+      {
+        int written = _write(fd, p, static_cast<unsigned int>((std::min)(left, size_t(INT_MAX))));
+        if (written <= 0)
+          return false;
+        p += written;
+        left -= static_cast<size_t>(written);
+      }
+    }
+    return true;
+#else
+    int first = 0;
+    while (first < n)
+    {
+      int count = (std::min)(n - first, IOV_MAX);
+      std::unique_ptr<struct iovec[]> iov(new struct iovec[static_cast<size_t>(count)]);
+      for (int i = 0; i < count; ++i)
+      {
+        iov[i].iov_base = segments[first + i].data;
+        iov[i].iov_len  = segments[first + i].size;
+      }
+
+      int cur = 0;
+      while (cur < count)
+      {
+        ssize_t written = ::writev(fd, &iov[cur], count - cur);
+        if (written < 0)
+          return false;
+
+        // advance past the (possibly partially) written segments
+        size_t w = static_cast<size_t>(written);
+        while (cur < count && w >= iov[cur].iov_len)
+        {
+          w -= iov[cur].iov_len;
+          ++cur;
+        }
+        if (cur < count)
+        {
+          iov[cur].iov_base = static_cast<char*>(iov[cur].iov_base) + w;
+          iov[cur].iov_len -= w;
+        }
+      }
+      first += count;
+    }
+    return true;
+#endif
+  }
+
+  /**
+   * fills the `n` segments, in order, with the contents of fd starting at
+   * `offset`, using vectored reads where available; the file position is not
+   * changed. returns the number of bytes read, which is less than the total
+   * size of the segments only at the end of the file or on error.
+   */
+  inline size_t preadv(int fd, Segment* segments, int n, size_t offset)
+  {
+    size_t total = 0;
+#if defined(_WIN32)
+    if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0)
+      return 0;
+    for (int i = 0; i < n; ++i)
+    {
+      char* p = segments[i].data;
+      size_t left = segments[i].size;
+      while (left > 0)
+      {
+        int count = _read(fd, p, static_cast<unsigned int>((std::min)(left, size_t(INT_MAX))));
+        if (count <= 0)
+          return total;
+        p += count;
+        left -= static_cast<size_t>(count);
+        total += static_cast<size_t>(count);
+      }
+    }
+#else
+    for (int first = 0; first < n; first += IOV_MAX)
+    {
+      int count = (std::min)(n - first, IOV_MAX);
+      std::unique_ptr<struct iovec[]> iov(new struct iovec[static_cast<size_t>(count)]);
+      for (int i = 0; i < count; ++i)
+      {
+        iov[i].iov_base = segments[first + i].data;
+        iov[i].iov_len  = segments[first + i].size;
+      }
+
+      int cur = 0;
+      while (cur < count)
+      {
+        ssize_t count_read = ::preadv(fd, &iov[cur], count - cur, static_cast<off_t>(offset + total));
+        if (count_read <= 0)
+          return total;
+
+        size_t r = static_cast<size_t>(count_read);
+        total += r;
+        while (cur < count && r >= iov[cur].iov_len)
+        {
+          r -= iov[cur].iov_len;
+          ++cur;
+        }
+        if (cur < count)
+        {
+          iov[cur].iov_base = static_cast<char*>(iov[cur].iov_base) + r;
+          iov[cur].iov_len -= r;
+        }
+      }
+    }
+#endif
+    return total;
+  }
+
+  /**
+   * returns the size of the file referred to by fd.
+   */
+  inline size_t file_size(int fd)
+  {
+#if defined(_WIN32)
+    struct _stat64 s;
+    if (_fstat64(fd, &s) != 0)
+      return 0;
+#else
+    struct stat s;
+    if (fstat(fd, &s) != 0)
+      return 0;
+#endif
+    return static_cast<size_t>(s.st_size);
+  }
+
+  /**
+   * returns the number of bytes available to the user in the file system
+   * containing path, or the largest size_t, if it cannot be determined.
+   */
+  inline size_t free_space(const std::string& path)
+  {
+#if defined(_WIN32)
+    ULARGE_INTEGER available;
+    if (GetDiskFreeSpaceExA(path.c_str(), &available, NULL, NULL))
+      return static_cast<size_t>(available.QuadPart);
+#else
+    struct statvfs s;
+    if (statvfs(path.c_str(), &s) == 0)
+      return static_cast<size_t>(s.f_bavail) * static_cast<size_t>(s.f_frsize);
+#endif
+    return (std::numeric_limits<size_t>::max)();
+  }
+
   inline bool remove(const std::string& filename)
   {
 #if defined(_WIN32)
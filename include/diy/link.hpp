@@ -1,6 +1,7 @@
 #ifndef DIY_LINK_HPP
 #define DIY_LINK_HPP
 
+#include <atomic>
 #include <vector>
 #include <map>
 #include <algorithm>
@@ -8,6 +9,7 @@
 
 #include "types.hpp"
 #include "serialization.hpp"
+#include "varint.hpp"
 #include "assigner.hpp"
 
 #include "factory.hpp"
@@ -54,6 +56,15 @@ namespace diy
       virtual void  save(BinaryBuffer& bb) const    { diy::save(bb, neighbors_); }
       virtual void  load(BinaryBuffer& bb)          { diy::load(bb, neighbors_); }
 
+      // compact encoding (varints, deltas), used by LinkFactory when enabled;
+      // links that derive from the built-in ones without overriding these fall back to save()/load()
+      virtual void  save_compact(BinaryBuffer& bb) const    { if (typeid(*this) != typeid(Link)) save(bb); else save_neighbors(bb); }
+      virtual void  load_compact(BinaryBuffer& bb)          { if (typeid(*this) != typeid(Link)) load(bb); else load_neighbors(bb); }
+
+    protected:
+      inline void   save_neighbors(BinaryBuffer& bb) const;
+      inline void   load_neighbors(BinaryBuffer& bb);
+
     private:
       Neighbors neighbors_;
   };
@@ -69,6 +80,79 @@ namespace diy
       template<class Bounds>
       inline std::string regular_link_id()          { return typeid(RegularLink<Bounds>).name(); }
 
+      // integers of the compact encoding: points as the dimension and the coordinates (relative to ref)
+      using Integers = std::vector<long long>;
+
+      template<class Point>
+      void      push_point(Integers& v, const Point& p, const Point* ref = nullptr)
+      {
+          v.push_back(static_cast<long long>(p.size()));
+          for (size_t i = 0; i < p.size(); ++i)
+              v.push_back(static_cast<long long>(p[i]) - (ref && i < ref->size() ? static_cast<long long>((*ref)[i]) : 0));
+      }
+
+      template<class Point>
+      void      pop_point(const Integers& v, size_t& k, Point& p, const Point* ref = nullptr)
+      {
+          p.resize(static_cast<size_t>(v.at(k++)));
+          for (size_t i = 0; i < p.size(); ++i)
+              p[i] = static_cast<typename Point::value_type>(v.at(k++) + (ref && i < ref->size() ? static_cast<long long>((*ref)[i]) : 0));
+      }
+
+      // bounds with integer coordinates are stored relative to the core, the rest as they are
+      template<class Bounds>
+      void      save_compact_bounds(BinaryBuffer& bb, const Bounds& core, const Bounds& bounds,
+                                    const std::vector<Bounds>& nbr_cores, const std::vector<Bounds>& nbr_bounds, std::true_type)
+      {
+          Integers v;
+          push_point(v, core.min);
+          push_point(v, core.max);
+          push_point(v, bounds.min, &core.min);
+          push_point(v, bounds.max, &core.max);
+          v.push_back(static_cast<long long>(nbr_cores.size()));
+          for (auto& b : nbr_cores)  { push_point(v, b.min, &core.min); push_point(v, b.max, &core.max); }
+          v.push_back(static_cast<long long>(nbr_bounds.size()));
+          for (auto& b : nbr_bounds) { push_point(v, b.min, &core.min); push_point(v, b.max, &core.max); }
+          varint::save_sequence(bb, v, false);
+      }
+
+      template<class Bounds>
+      void      load_compact_bounds(BinaryBuffer& bb, Bounds& core, Bounds& bounds,
+                                    std::vector<Bounds>& nbr_cores, std::vector<Bounds>& nbr_bounds, std::true_type)
+      {
+          Integers v;
+          varint::load_sequence(bb, v, false);
+          size_t k = 0;
+          pop_point(v, k, core.min);
+          pop_point(v, k, core.max);
+          pop_point(v, k, bounds.min, &core.min);
+          pop_point(v, k, bounds.max, &core.max);
+          nbr_cores.assign(static_cast<size_t>(v.at(k++)), Bounds(0));
+          for (auto& b : nbr_cores)  { pop_point(v, k, b.min, &core.min); pop_point(v, k, b.max, &core.max); }
+          nbr_bounds.assign(static_cast<size_t>(v.at(k++)), Bounds(0));
+          for (auto& b : nbr_bounds) { pop_point(v, k, b.min, &core.min); pop_point(v, k, b.max, &core.max); }
+      }
+
+      template<class Bounds>
+      void      save_compact_bounds(BinaryBuffer& bb, const Bounds& core, const Bounds& bounds,
+                                    const std::vector<Bounds>& nbr_cores, const std::vector<Bounds>& nbr_bounds, std::false_type)
+      {
+          diy::save(bb, core);
+          diy::save(bb, bounds);
+          diy::save(bb, nbr_cores);
+          diy::save(bb, nbr_bounds);
+      }
+
+      template<class Bounds>
+      void      load_compact_bounds(BinaryBuffer& bb, Bounds& core, Bounds& bounds,
+                                    std::vector<Bounds>& nbr_cores, std::vector<Bounds>& nbr_bounds, std::false_type)
+      {
+          diy::load(bb, core);
+          diy::load(bb, bounds);
+          diy::load(bb, nbr_cores);
+          diy::load(bb, nbr_bounds);
+      }
+
       template<>
       inline std::string regular_link_id<DiscreteBounds>()   { return "diy::RegularLink<diy::DiscreteBounds>"; }
 
@@ -154,6 +238,59 @@ namespace diy
           diy::load(bb, wrap_);
       }
 
+      void      save_compact(BinaryBuffer& bb) const override
+      {
+          if (typeid(*this) != typeid(RegularLink))
+          {
+              save(bb);
+              return;
+          }
+
+          Link::save_neighbors(bb);
+
+          detail::Integers v;
+          v.push_back(dim_);
+          v.push_back(static_cast<long long>(dir_vec_.size()));
+          for (auto& dir : dir_vec_)
+              detail::push_point(v, dir);
+          v.push_back(static_cast<long long>(wrap_.size()));
+          for (auto& dir : wrap_)
+              detail::push_point(v, dir);
+          varint::save_sequence(bb, v, false);
+
+          detail::save_compact_bounds(bb, core_, bounds_, nbr_cores_, nbr_bounds_, std::is_integral<typename Bounds::Coordinate>());
+      }
+
+      void      load_compact(BinaryBuffer& bb) override
+      {
+          if (typeid(*this) != typeid(RegularLink))
+          {
+              load(bb);
+              return;
+          }
+
+          Link::load_neighbors(bb);
+
+          detail::Integers v;
+          varint::load_sequence(bb, v, false);
+          size_t k = 0;
+          dim_ = static_cast<int>(v.at(k++));
+          dir_map_.clear();
+          dir_vec_.clear();
+          size_t ndirs = static_cast<size_t>(v.at(k++));
+          for (size_t i = 0; i < ndirs; ++i)
+          {
+              Direction dir;
+              detail::pop_point(v, k, dir);
+              add_direction(dir);           // dir_map_ is built by add_direction() alone
+          }
+          wrap_.resize(static_cast<size_t>(v.at(k++)));
+          for (auto& dir : wrap_)
+              detail::pop_point(v, k, dir);
+
+          detail::load_compact_bounds(bb, core_, bounds_, nbr_cores_, nbr_bounds_, std::is_integral<typename Bounds::Coordinate>());
+      }
+
     private:
       int       dim_;
 
@@ -244,6 +381,36 @@ namespace diy
           diy::load(bb, wrap_);
       }
 
+      void          save_compact(BinaryBuffer& bb) const override
+      {
+          if (typeid(*this) != typeid(AMRLink))
+          {
+              save(bb);
+              return;
+          }
+
+          save_neighbors(bb);
+          diy::save(bb, dim_);
+          diy::save(bb, local_);
+          diy::save(bb, nbr_descriptions_);
+          diy::save(bb, wrap_);
+      }
+
+      void          load_compact(BinaryBuffer& bb) override
+      {
+          if (typeid(*this) != typeid(AMRLink))
+          {
+              load(bb);
+              return;
+          }
+
+          load_neighbors(bb);
+          diy::load(bb, dim_);
+          diy::load(bb, local_);
+          diy::load(bb, nbr_descriptions_);
+          diy::load(bb, wrap_);
+      }
+
     private:
         int                         dim_;
 
@@ -262,8 +429,21 @@ namespace diy
           return Link::make(name);
       }
 
-      inline static void    save(BinaryBuffer& bb, const Link* l);
+      //! save with the compact encoding, if `compact()`; `load()` reads either encoding
+      inline static void    save(BinaryBuffer& bb, const Link* l)               { save(bb, l, compact()); }
+      inline static void    save(BinaryBuffer& bb, const Link* l, bool compact_);
       inline static Link*   load(BinaryBuffer& bb);
+
+      //! Use the compact encoding of links (varints, delta-encoded gids, bounds relative to the core)
+      //! when saving them, e.g., in `io::write_blocks()` or when migrating blocks. Off by default,
+      //! since the files it produces cannot be read by older versions of DIY.
+      static void           set_compact(bool compact_)                          { compact_flag() = compact_; }
+      static bool           compact()                                           { return compact_flag(); }
+
+    private:
+      static const char*    compact_prefix()                                    { return "diy::compact:"; }
+      static std::atomic<bool>&
+                            compact_flag()                                      { static std::atomic<bool> flag(false); return flag; }
   };
 
   namespace detail
@@ -334,10 +514,17 @@ namespace diy
 
 void
 diy::LinkFactory::
-save(BinaryBuffer& bb, const Link* l)
+save(BinaryBuffer& bb, const Link* l, bool compact_)
 {
-    diy::save(bb, detail::serialized_link_id(l));
-    l->save(bb);
+    if (compact_)
+    {
+        diy::save(bb, compact_prefix() + detail::serialized_link_id(l));
+        l->save_compact(bb);
+    } else
+    {
+        diy::save(bb, detail::serialized_link_id(l));
+        l->save(bb);
+    }
 }
 
 diy::Link*
@@ -346,11 +533,51 @@ load(BinaryBuffer& bb)
 {
     std::string id;
     diy::load(bb, id);
+
+    std::string prefix = compact_prefix();
+    bool compact_ = id.compare(0, prefix.size(), prefix) == 0;
+    if (compact_)
+        id.erase(0, prefix.size());
+
     Link* l = create(id);
-    l->load(bb);
+    if (compact_)
+        l->load_compact(bb);
+    else
+        l->load(bb);
     return l;
 }
 
+void
+diy::Link::
+save_neighbors(BinaryBuffer& bb) const
+{
+    detail::Integers gids, procs;
+    gids.reserve(neighbors_.size());
+    procs.reserve(neighbors_.size());
+    for (auto& nbr : neighbors_)
+    {
+        gids.push_back(nbr.gid);
+        procs.push_back(nbr.proc);
+    }
+    varint::save_sequence(bb, gids);
+    varint::save_sequence(bb, procs);
+}
+
+void
+diy::Link::
+load_neighbors(BinaryBuffer& bb)
+{
+    detail::Integers gids, procs;
+    varint::load_sequence(bb, gids);
+    varint::load_sequence(bb, procs);
+    if (gids.size() != procs.size())
+        throw std::runtime_error("Corrupted compact link");
+
+    neighbors_.resize(gids.size());
+    for (size_t i = 0; i < gids.size(); ++i)
+        neighbors_[i] = BlockID(static_cast<int>(gids[i]), static_cast<int>(procs[i]));
+}
+
 int
 diy::Link::
 find(int gid) const
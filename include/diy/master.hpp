@@ -11,6 +11,7 @@
 #include <memory>
 #include <chrono>
 #include <climits>
+#include <limits>
 #include <atomic>
 #include <exception>
 #include <random>
@@ -21,6 +22,7 @@
 #include "diy/assigner.hpp"
 #include "link.hpp"
 #include "collection.hpp"
+#include "compression.hpp"
 
 // Communicator functionality
 #include "mpi.hpp"
@@ -143,6 +145,7 @@ namespace diy
       // forward declarations, defined in detail/master/collectives.hpp
       struct Collective;
 
+      struct TemporalDeltas;        // detail/master/temporal-delta.hpp
       struct InFlightSendsList;     // std::list<InFlightSend>
       struct InFlightRecvsMap;      // std::map<int, InFlightRecv>          //
       struct CollectivesList;       // std::list<Collective>
@@ -157,6 +160,9 @@ namespace diy
                         QueueRecord(MemoryBuffer&& b):
                             buffer_(std::move(b))                                       { size_ = buffer_.size(); external_ = -1; }
                         QueueRecord(size_t s = 0, int e = -1): size_(s), external_(e)   {}
+                        // external record whose contents went straight to storage; b holds only the blobs
+                        QueueRecord(MemoryBuffer&& b, size_t s, int e):
+                            size_(s), external_(e), buffer_(std::move(b))               {}
                         QueueRecord(const QueueRecord&) =delete;
                         QueueRecord(QueueRecord&&)      =default;
         QueueRecord&    operator=(const QueueRecord&)   =delete;
@@ -322,6 +328,63 @@ namespace diy
 #endif
       }
 
+      //! messages larger than this are sent in parts of this size; the parts of messages
+      //! for queues that will be unloaded are written to storage as they arrive, so the
+      //! chunk size bounds the memory needed to receive them
+      size_t        message_chunk_size() const          { return message_chunk_size_; }
+      void          set_message_chunk_size(size_t s)    { message_chunk_size_ = (std::max)(size_t(1), (std::min)(s, size_t(INT_MAX))); }
+
+      //! keep the last payload sent from every block to every block on a different rank, and send the XOR
+      //! difference from it, run-length encoded, when that's smaller (for slowly changing data, like halos
+      //! in iterative solvers); the receiver restores the payload before the queue reaches the block.
+      //! Applies to `exchange()` and to the messages that fit in one chunk (see `set_message_chunk_size()`).
+      bool          temporal_delta() const              { return temporal_delta_; }
+      inline void   set_temporal_delta(bool on);
+      //! bytes not sent thanks to the temporal delta encoding
+      inline size_t temporal_delta_bytes_saved() const;
+      //! bytes kept for the temporal delta encoding: the payloads last sent and the copies last received
+      inline size_t temporal_delta_memory() const;
+      //! forget the payloads last sent, so the next message between every pair of blocks goes whole; needed on every
+      //! process after blocks move, since a block may return to a process that dropped its copies when it left
+      //! (`update_links()` does it)
+      inline void   reset_temporal_deltas();
+
+      struct WireCompressionStats
+      {
+        size_t      messages            = 0;    // messages sent compressed
+        size_t      incompressible      = 0;    // messages above the threshold sent as they are, since compression didn't help
+        size_t      raw_bytes           = 0;    // of the messages sent compressed, before compression
+        size_t      compressed_bytes    = 0;
+        double      compress_time       = 0;    // seconds, including the incompressible messages
+        double      decompress_time     = 0;    // seconds
+        size_t      decompressed_bytes  = 0;
+
+        size_t      bytes_saved() const             { return raw_bytes - compressed_bytes; }
+        double      ratio() const                   { return compressed_bytes ? static_cast<double>(raw_bytes) / static_cast<double>(compressed_bytes) : 1.; }
+      };
+
+      //! compress the messages to other ranks that are at least `threshold` bytes long (blobs excluded) with `codec`;
+      //! `nullptr` turns compression off. Every rank must use the same codec, but the threshold may differ.
+      void          set_wire_compression(std::shared_ptr<Codec> codec = std::make_shared<ShuffleCodec>(),
+                                         size_t threshold = 65536)  { wire_codec_ = codec; wire_threshold_ = threshold; }
+      const std::shared_ptr<Codec>&
+                    wire_codec() const                  { return wire_codec_; }
+      size_t        wire_compression_threshold() const  { return wire_threshold_; }
+      WireCompressionStats
+                    wire_compression_stats() const      { return *wire_stats_.const_access(); }
+
+      //! the callbacks of every block are timed in `execute()` and `iexchange()`, and the time per call is averaged
+      //! with exponentially decaying weights: `smoothing` is the weight of the latest measurement
+      double        cost_smoothing() const              { return cost_smoothing_; }
+      void          set_cost_smoothing(double smoothing){ cost_smoothing_ = (std::max)(0., (std::min)(smoothing, 1.)); }
+      //! estimated time, in seconds, that the callbacks of block `gid` take; 0 until it's been measured
+      inline double block_cost(int gid) const;
+      //! seed the estimate, e.g., on the new owner of a block that moved
+      inline void   set_block_cost(int gid, double cost);
+      //! work function for the load balancers: the estimated cost, in microseconds
+      inline WCallback<void>
+                    measured_work() const;
+
       CreateBlock   creator() const                     { return block_info_.const_access()->blocks_.creator(); }
       DestroyBlock  destroyer() const                   { return block_info_.const_access()->blocks_.destroyer(); }
       LoadBlock     loader() const                      { return block_info_.const_access()->blocks_.loader(); }
@@ -338,6 +401,23 @@ namespace diy
           foreach_<Block>(f, s);
       }
 
+      //! how `dynamic_foreach()` moves blocks: `sampling` (default) asks random processes for their work by message
+      //! and sends blocks to the lighter ones; `rma` lets a process that runs out of blocks claim one from another
+      //! with an atomic operation on a window where every process publishes how many blocks it has left
+      //! (`quantile` is unused then)
+      enum class WorkStealing { sampling, rma };
+      WorkStealing  work_stealing() const               { return work_stealing_; }
+      void          set_work_stealing(WorkStealing w)   { work_stealing_ = w; }
+
+      //! how much the load balancers favor keeping blocks next to their link neighbors: among the blocks that would
+      //! improve the balance, each one scores its work relative to the heaviest, plus `locality` times the fraction
+      //! of its neighbors that live on the destination less the fraction it leaves behind; 0 (default) moves by work alone
+      float         balance_locality() const            { return balance_locality_; }
+      void          set_balance_locality(float locality){ balance_locality_ = (std::max)(0.f, locality); }
+      //! number of link neighbors of the local blocks that live on other processes (the messages that an exchange
+      //! over every link sends off this process); the load balancers log it before and after they move blocks
+      inline size_t remote_links() const;
+
       //! call `f` and `g` with every block
       // 'f' is the compute callback, 'g' is the callback to get the amount of work that 'f' takes
       template<class F, class G>
@@ -444,6 +524,13 @@ namespace diy
       inline void       touch_queues();
       inline void       send_same_rank(int from, int to, QueueRecord& qr, MemoryManagement mem, IExchangeInfo* iex);
       inline void       send_different_rank(int from, int to, int proc, QueueRecord& qr, bool remote, IExchangeInfo* iex);
+      inline void       encode_temporal_delta(int proc, MemoryBuffer& payload, MessageInfo& info);
+      inline void       decode_temporal_delta(MessageInfo& info, MemoryBuffer& payload);
+      inline void       compress_message(MemoryBuffer& payload, MessageInfo& info);
+      inline void       decompress_message(MessageInfo& info, MemoryBuffer& payload);
+
+      inline void       add_block_time(int gid, double seconds);
+      inline void       update_block_costs();
 
       inline InFlightRecv&         inflight_recv(int proc);
       inline InFlightSendsList&    inflight_sends();
@@ -482,12 +569,30 @@ namespace diy
       std::unique_ptr<InFlightSendsList> inflight_sends_;
       std::unique_ptr<InFlightRecvsMap>  inflight_recvs_;
       std::unique_ptr<CollectivesMap>    collectives_;
+      std::unique_ptr<TemporalDeltas>    temporal_deltas_;
 
       int                   expected_           = 0;
       int                   exchange_round_     = -1;
       bool                  immediate_          = true;
+      size_t                message_chunk_size_ = INT_MAX;
+      bool                  temporal_delta_     = false;
+      std::shared_ptr<Codec>                wire_codec_;
+      size_t                                wire_threshold_ = 65536;
+      critical_resource<WireCompressionStats> wire_stats_;
       Commands              commands_;
 
+      struct BlockCost
+      {
+        double              estimate = 0;
+        double              current  = 0;           // time in the current execute() or iexchange()
+        bool                measured = false;       // whether estimate is valid
+        bool                ran      = false;       // whether current is valid
+      };
+      critical_resource<std::map<int, BlockCost>>   block_costs_;
+      double                cost_smoothing_     = 0.5;
+      WorkStealing          work_stealing_      = WorkStealing::sampling;
+      float                 balance_locality_   = 0;
+
     private:
       fast_mutex            block_mutex_;
 
@@ -504,6 +609,7 @@ namespace diy
 
 #include "detail/master/iexchange.hpp"
 #include "detail/master/communication.hpp"
+#include "detail/master/temporal-delta.hpp"
 #include "detail/master/collectives.hpp"
 #include "detail/master/commands.hpp"
 #include "proxy.hpp"
@@ -533,7 +639,8 @@ Master(mpi::communicator    comm,
   // Communicator functionality
   inflight_sends_(new InFlightSendsList),
   inflight_recvs_(new InFlightRecvsMap),
-  collectives_(new CollectivesMap)
+  collectives_(new CollectivesMap),
+  temporal_deltas_(new TemporalDeltas)
 {
     auto block_info_access = block_info_.access();
     block_info_access->blocks_.set_create(create_);
@@ -611,7 +718,7 @@ unload_incoming(int gid__)
         int from = x.first;
         for (QueueRecord& qr : *x.second.access())
         {
-          if (queue_policy_->unload_incoming(*this, from, gid__, qr.size()))
+          if (!qr.external() && queue_policy_->unload_incoming(*this, from, gid__, qr.size()))
           {
             log->debug("Unloading queue: {} <- {}", gid__, from);
             qr.unload(storage_);
@@ -631,7 +738,7 @@ unload_outgoing(int gid__)
       int to = x.first.gid;
       for (QueueRecord& qr : *x.second.access())
       {
-        if (queue_policy_->unload_outgoing(*this, gid__, qr.size()))
+        if (!qr.external() && queue_policy_->unload_outgoing(*this, gid__, qr.size()))
         {
           log->debug("Unloading outgoing queue: {} -> {}", gid__, to);
           qr.unload(storage_);
@@ -722,6 +829,7 @@ load_outgoing(int gid__)
           {
             log->debug("Loading queue: {} -> {}", gid__, to);
             qr.load(storage_);
+            qr.buffer().position = qr.buffer().size();      // the message info gets appended when sending
           }
       }
   }
@@ -753,6 +861,19 @@ add(int gid__, void* b, Link* l)
   return lid__;
 }
 
+size_t
+diy::Master::
+remote_links() const
+{
+  auto block_info_access = block_info_.const_access();
+  int  rank              = comm_.rank();
+  size_t count = 0;
+  for (const Link* l : block_info_access->links_)
+    for (int i = 0; i < l->size(); ++i)
+      count += l->target(i).proc != rank;
+  return count;
+}
+
 void*
 diy::Master::
 release(int gid)
@@ -764,6 +885,24 @@ release(int gid)
 
   void* b = block_info_access->blocks_.release(lid);
 
+  block_costs_.access()->erase(gid);
+
+  // the new owner starts the temporal deltas from and to this block afresh
+  if (!temporal_deltas_->sent.empty())
+  {
+      auto first = temporal_deltas_->sent.lower_bound(TemporalDeltas::Pair(gid, INT_MIN));
+      auto last  = temporal_deltas_->sent.lower_bound(TemporalDeltas::Pair(gid + 1, INT_MIN));
+      temporal_deltas_->sent.erase(first, last);
+  }
+  auto& received = temporal_deltas_->received;
+  for (auto it = received.begin(); it != received.end();)
+  {
+      if (it->first.second == gid)
+          it = received.erase(it);
+      else
+          ++it;
+  }
+
   // update links
   expected_ -= block_info_access->links_[lid]->size_unique();
   delete link(lid);
@@ -871,12 +1010,19 @@ dynamic_foreach_(const F&                         f,
 
     commands_.emplace_back(new Command<Block>(f, skip));
 
+    size_t remote_links_before = remote_links();
+
     // load balance in the parent thread and execute the block in a child thread
     // prefer this option in case MPI_SINGLE is used, all dynamic load balancing communication remains in parent thread
     std::thread t1(&Master::dynamic_execute, this, std::ref(aux_block));
-    detail::dynamic_balance(this, &aux_master, &dynamic_assigner, sample_frac, quantile, moved_blocks);
+    if (work_stealing_ == WorkStealing::rma)
+        detail::dynamic_balance_rma(this, &aux_block, &dynamic_assigner, sample_frac, moved_blocks);
+    else
+        detail::dynamic_balance(this, &aux_master, &dynamic_assigner, sample_frac, quantile, moved_blocks);
     t1.join();
 
+    log->info("[{}] Load balancing: {} remote links before, {} after", comm_.rank(), remote_links_before, remote_links());
+
     // alternative is to load balance in a child thread and execute the block in the parent thread
     // std::thread t1(detail::dynamic_balance, this, &aux_master, &dynamic_assigner, sample_frac, quantile);
     // dynamic_execute(aux_block);
@@ -1000,7 +1146,9 @@ iexchange_(const ICallback<Block>& f, MemoryManagement mem)
                     iex.inc_work();       // even if we remove the queues, when constructing the proxy, we still have work to do
                     {
                         ProxyWithLink cp = proxy(i, &iex);
+                        auto start = std::chrono::steady_clock::now();
                         done = f(block<Block>(i), cp);
+                        add_block_time(gid, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
                         if (done_result[gid] ^ done)        // status changed
                         {
                             if (done)
@@ -1076,6 +1224,8 @@ iexchange_(const ICallback<Block>& f, MemoryManagement mem)
     } else
         run_callbacks(true, nullptr);
 
+    update_block_costs();
+
     log->info("[{}] ==== Leaving iexchange ====\n", iex.comm.rank());
 
     //comm_.barrier();        // TODO: this is only necessary for DUD
@@ -1335,9 +1485,16 @@ send_same_rank(int from, int to, QueueRecord& qr, MemoryManagement mem, IExchang
 
     // copy blobs explicitly; we cannot just move them in place, since we don't
     // own their memory and must guarantee that it's safe to free, once
-    // exchange() is done
+    // exchange() is done; the blobs shared by enqueue_multicast() keep their
+    // memory alive themselves, so they are moved
     for (BinaryBlob& blob : blobs)
     {
+        if (blob.pointer.get_deleter().target<detail::SharedBlobDeleter>())
+        {
+            in_qr.buffer().blobs.emplace_back(std::move(blob));
+            continue;
+        }
+
         char* p = mem.allocate(to, blob.size);
         mem.copy(p, blob.pointer.get(), blob.size);
         in_qr.buffer().save_binary_blob(p, blob.size, mem.deallocate);
@@ -1368,13 +1525,27 @@ send_different_rank(int from, int to, int proc, QueueRecord& qr, bool remote, IE
     assert(!qr.external());
 
     static const size_t MAX_MPI_MESSAGE_COUNT = INT_MAX;
+    const size_t        chunk_size = (std::min)(message_chunk_size_, MAX_MPI_MESSAGE_COUNT);
 
     // sending to a different rank
     std::shared_ptr<MemoryBuffer> buffer = std::make_shared<MemoryBuffer>(qr.move());
 
-    MessageInfo info{from, to, 1, exchange_round_, static_cast<int>(buffer->nblobs())};
+    MessageInfo info{from, to, 1, exchange_round_, static_cast<int>(buffer->nblobs()), TemporalDeltas::plain, 0};
+    if (temporal_delta_)
+    {
+        // only single messages outside of iexchange() are encoded; the rest go out plain,
+        // which ends the receiver's reference, so forget ours too
+        if (!iex && Serialization<MemoryBuffer>::size(*buffer) + Serialization<MessageInfo>::size(info) <= chunk_size)
+            encode_temporal_delta(proc, *buffer, info);
+        else
+            temporal_deltas_->sent.erase(TemporalDeltas::Pair(from, to));
+    }
+
+    if (wire_codec_ && buffer->size() >= wire_threshold_)
+        compress_message(*buffer, info);
+
     // size fits in one message
-    if (Serialization<MemoryBuffer>::size(*buffer) + Serialization<MessageInfo>::size(info) <= MAX_MPI_MESSAGE_COUNT)
+    if (Serialization<MemoryBuffer>::size(*buffer) + Serialization<MessageInfo>::size(info) <= chunk_size)
     {
         diy::save(*buffer, info);
 
@@ -1390,7 +1561,7 @@ send_different_rank(int from, int to, int proc, QueueRecord& qr, bool remote, IE
     }
     else // large message gets broken into chunks
     {
-        int npieces = static_cast<int>((buffer->size() + MAX_MPI_MESSAGE_COUNT - 1)/MAX_MPI_MESSAGE_COUNT);
+        int npieces = static_cast<int>((buffer->size() + chunk_size - 1)/chunk_size);
         info.nparts += npieces;
 
         // first send the head
@@ -1422,11 +1593,11 @@ send_different_rank(int from, int to, int proc, QueueRecord& qr, bool remote, IE
 
         // send the message pieces
         size_t msg_buff_idx = 0;
-        for (int i = 0; i < npieces; ++i, msg_buff_idx += MAX_MPI_MESSAGE_COUNT)
+        for (int i = 0; i < npieces; ++i, msg_buff_idx += chunk_size)
         {
             detail::VectorWindow<char> window;
             window.begin = &buffer->buffer[msg_buff_idx];
-            window.count = (std::min)(MAX_MPI_MESSAGE_COUNT, buffer->size() - msg_buff_idx);
+            window.count = (std::min)(chunk_size, buffer->size() - msg_buff_idx);
 
             inflight_sends().emplace_back();
             auto& inflight_send = inflight_sends().back();
@@ -1477,6 +1648,12 @@ check_incoming_queues(MemoryManagement mem, IExchangeInfo* iex)
     auto scoped = prof.scoped("check-incoming-queues");
     DIY_UNUSED(scoped);
 
+    auto unload = [this](const MessageInfo& info, size_t size)
+    {
+        return ((info.round == exchange_round_) ? (block(lid(info.to)) == 0) : (limit_ != -1))
+               && queue_policy_->unload_incoming(*this, info.from, info.to, size);
+    };
+
     mpi::optional<mpi::status> ostatus = comm_.iprobe(mpi::any_source, tags::queue);
     while (ostatus)
     {
@@ -1489,15 +1666,25 @@ check_incoming_queues(MemoryManagement mem, IExchangeInfo* iex)
         if (!first_message && iex)
             iex->dec_work();
 
+        if (first_message && ir.info.nparts > 0)      // head of a multi-part message
+        {
+            // if the queue is going out of core anyway, write the parts to storage as they arrive
+            if (storage_ && !ir.info.compressed && unload(ir.info, ir.msg_size))
+            {
+                log->debug("Streaming queue {} <- {} to storage, size = {}", ir.info.to, ir.info.from, ir.msg_size);
+                ir.writer = storage_->writer(ir.msg_size);
+            } else
+                ir.message.buffer.reserve(ir.msg_size);
+        }
+
         if (ir.done)                // all pieces assembled
         {
             assert(ir.info.round >= exchange_round_);
+            decompress_message(ir.info, ir.message);
+            decode_temporal_delta(ir.info, ir.message);
             IncomingRound* in = &incoming_[ir.info.round];
 
-            bool unload = ((ir.info.round == exchange_round_) ? (block(lid(ir.info.to)) == 0) : (limit_ != -1))
-                          && queue_policy_->unload_incoming(*this, ir.info.from, ir.info.to, ir.message.size());
-
-            ir.place(in, unload, storage_, iex);
+            ir.place(in, !ir.writer && unload(ir.info, ir.message.size()), storage_, iex);
             ir.reset();
         }
 
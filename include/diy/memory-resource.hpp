@@ -0,0 +1,149 @@
+#ifndef DIY_MEMORY_RESOURCE_HPP
+#define DIY_MEMORY_RESOURCE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace diy
+{
+  //! Source of memory for the serialization buffers (`MemoryBuffer`), i.e., for the queues
+  //! `Master` exchanges. Derive from it to supply arenas, pools, NUMA-local memory, etc.
+  struct MemoryResource
+  {
+    virtual             ~MemoryResource()                           =default;
+    virtual void*       allocate(size_t bytes)                      =0;
+    virtual void        deallocate(void* p, size_t bytes)           =0;     //!< `bytes` is the size passed to `allocate()`
+  };
+
+  //! Plain `operator new` and `operator delete`.
+  struct NewDeleteResource: public MemoryResource
+  {
+    void*               allocate(size_t bytes) override             { return ::operator new(bytes); }
+    void                deallocate(void* p, size_t) override        { ::operator delete(p); }
+  };
+
+  //! Maps large allocations directly and asks the kernel to back them with transparent huge pages
+  //! (on Linux; elsewhere, all allocations go to `upstream`). Fresh pages come zeroed by the kernel,
+  //! without touching them first.
+  struct HugePageResource: public MemoryResource
+  {
+    static const size_t huge_page_size = size_t(2) << 20;
+
+                        HugePageResource(size_t          threshold_ = huge_page_size,      //!< smaller allocations go to upstream
+                                         MemoryResource* upstream_  = nullptr):
+                          threshold(threshold_), upstream(upstream_)                    {}
+
+    inline void*        allocate(size_t bytes) override;
+    inline void         deallocate(void* p, size_t bytes) override;
+
+    size_t              threshold;
+    MemoryResource*     upstream;               //!< `NewDeleteResource`, if null
+
+    private:
+      static size_t     round_up(size_t bytes)                      { return (bytes + huge_page_size - 1) / huge_page_size * huge_page_size; }
+  };
+
+  namespace detail
+  {
+    inline MemoryResource*  new_delete_resource()                   { static NewDeleteResource r; return &r; }
+
+    inline std::atomic<MemoryResource*>&
+                            default_memory_resource_pointer()       { static std::atomic<MemoryResource*> r(new_delete_resource()); return r; }
+  }
+
+  //! Resource used by the newly created `MemoryBuffer`s; `NewDeleteResource` to start with.
+  inline MemoryResource*    default_memory_resource()               { return detail::default_memory_resource_pointer().load(); }
+
+  //! Set the resource for the `MemoryBuffer`s created from now on (it must outlive them);
+  //! `nullptr` restores `NewDeleteResource`. Returns the previous resource.
+  inline MemoryResource*    set_default_memory_resource(MemoryResource* r)
+  {
+    return detail::default_memory_resource_pointer().exchange(r ? r : detail::new_delete_resource());
+  }
+
+  //! Allocator for `MemoryBuffer` storage: gets memory from a `MemoryResource` and default-initializes
+  //! the elements, so that growing a buffer of chars doesn't zero-fill it.
+  template<class T>
+  struct BufferAllocator
+  {
+    using value_type                                = T;
+    using propagate_on_container_copy_assignment    = std::true_type;
+    using propagate_on_container_move_assignment    = std::true_type;
+    using propagate_on_container_swap               = std::true_type;
+
+    template<class U>
+    struct rebind                                   { using other = BufferAllocator<U>; };
+
+                        BufferAllocator(MemoryResource* resource__ = default_memory_resource()):
+                          resource_(resource__)                     {}
+
+    template<class U>
+                        BufferAllocator(const BufferAllocator<U>& other):
+                          resource_(other.resource())               {}
+
+    T*                  allocate(size_t n)                          { return static_cast<T*>(resource_->allocate(n * sizeof(T))); }
+    void                deallocate(T* p, size_t n)                  { resource_->deallocate(p, n * sizeof(T)); }
+
+    template<class U>
+    void                construct(U* p)                             { ::new(static_cast<void*>(p)) U; }
+
+    template<class U, class... Args>
+    void                construct(U* p, Args&&... args)             { ::new(static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+
+    MemoryResource*     resource() const                            { return resource_; }
+
+    private:
+      MemoryResource*   resource_;
+  };
+
+  template<class T, class U>
+  bool                  operator==(const BufferAllocator<T>& x, const BufferAllocator<U>& y)   { return x.resource() == y.resource(); }
+
+  template<class T, class U>
+  bool                  operator!=(const BufferAllocator<T>& x, const BufferAllocator<U>& y)   { return !(x == y); }
+}
+
+void*
+diy::HugePageResource::
+allocate(size_t bytes)
+{
+    MemoryResource* up = upstream ? upstream : detail::new_delete_resource();
+#if defined(__linux__)
+    if (bytes < threshold)
+        return up->allocate(bytes);
+
+    void* p = mmap(nullptr, round_up(bytes), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        throw std::bad_alloc();
+#if defined(MADV_HUGEPAGE)
+    madvise(p, round_up(bytes), MADV_HUGEPAGE);        // only a hint
+#endif
+    return p;
+#else
+    return up->allocate(bytes);
+#endif
+}
+
+void
+diy::HugePageResource::
+deallocate(void* p, size_t bytes)
+{
+    MemoryResource* up = upstream ? upstream : detail::new_delete_resource();
+#if defined(__linux__)
+    if (bytes < threshold)
+        up->deallocate(p, bytes);
+    else
+        munmap(p, round_up(bytes));
+#else
+    up->deallocate(p, bytes);
+#endif
+}
+
+#endif
@@ -108,7 +108,8 @@ void all_to_all(const communicator& comm,
       detail::gather(comm, address(in), count(in), datatype_of(in), address(out), root);
     }
 
-    static void gather(const communicator& comm, const std::vector<T>& in, std::vector< std::vector<T> >& out, int root)
+    template<class A>
+    static void gather(const communicator& comm, const std::vector<T,A>& in, std::vector< std::vector<T,A> >& out, int root)
     {
       std::vector<int> counts;
       if (comm.rank() == root)
@@ -164,7 +165,8 @@ void all_to_all(const communicator& comm,
       detail::gather(comm, address(in), count(in), datatype_of(in), address(in), root);
     }
 
-    static void gather(const communicator& comm, const std::vector<T>& in, int root)
+    template<class A>
+    static void gather(const communicator& comm, const std::vector<T,A>& in, int root)
     {
       Collectives<int,void*>::gather(comm, count(in), root);
       detail::gather_v(comm, address(in), count(in), datatype_of(in), 0, 0, 0, root);
@@ -176,7 +178,8 @@ void all_to_all(const communicator& comm,
       detail::all_gather(comm, address(in), count(in), datatype_of(in), address(out));
     }
 
-    static void all_gather(const communicator& comm, const std::vector<T>& in, std::vector< std::vector<T> >& out)
+    template<class A>
+    static void all_gather(const communicator& comm, const std::vector<T,A>& in, std::vector< std::vector<T,A> >& out)
     {
       std::vector<int>  counts(static_cast<size_t>(comm.size()));
       Collectives<int,void*>::all_gather(comm, count(in), counts);
@@ -302,10 +305,10 @@ void all_to_all(const communicator& comm,
     Collectives<T,void*>::gather(comm, in, out, root);
   }
 
-  //! Same as above, but for vectors.
-  template<class T>
+  //! Same as above, but for vectors (with any allocator, e.g., `MemoryBuffer::Buffer`).
+  template<class T, class A>
   inline
-  void      gather(const communicator& comm, const std::vector<T>& in, std::vector< std::vector<T> >& out, int root)
+  void      gather(const communicator& comm, const std::vector<T,A>& in, std::vector< std::vector<T,A> >& out, int root)
   {
     Collectives<T,void*>::gather(comm, in, out, root);
   }
@@ -319,9 +322,9 @@ void all_to_all(const communicator& comm,
   }
 
   //! Simplified version (without `out`) for use on non-root processes.
-  template<class T>
+  template<class T, class A>
   inline
-  void      gather(const communicator& comm, const std::vector<T>& in, int root)
+  void      gather(const communicator& comm, const std::vector<T,A>& in, int root)
   {
     Collectives<T,void*>::gather(comm, in, root);
   }
@@ -336,10 +339,10 @@ void all_to_all(const communicator& comm,
     Collectives<T,void*>::all_gather(comm, in, out);
   }
 
-  //! Same as above, but for vectors.
-  template<class T>
+  //! Same as above, but for vectors (with any allocator).
+  template<class T, class A>
   inline
-  void      all_gather(const communicator& comm, const std::vector<T>& in, std::vector< std::vector<T> >& out)
+  void      all_gather(const communicator& comm, const std::vector<T,A>& in, std::vector< std::vector<T,A> >& out)
   {
     Collectives<T,void*>::all_gather(comm, in, out);
   }
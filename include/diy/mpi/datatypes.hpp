@@ -39,7 +39,8 @@ namespace detail
   #define DIY_MPI_DATATYPE_DEFAULT(cpp_type)                                                      \
   template<> DIY_MPI_EXPORT_FUNCTION datatype get_mpi_datatype<cpp_type>();                       \
   template<>  struct is_mpi_datatype< cpp_type >                { typedef true_type type; };      \
-  template<>  struct is_mpi_datatype< std::vector<cpp_type> >   { typedef true_type type; };      \
+  template<class A>                                                                               \
+              struct is_mpi_datatype< std::vector<cpp_type, A> >{ typedef true_type type; };      \
   template<size_t N>                                                                              \
               struct is_mpi_datatype< std::array<cpp_type, N> > { typedef true_type type; };
 
@@ -67,10 +68,10 @@ namespace detail
     static int                  count(const T&)         { return 1; }
   };
 
-  template<class U>
-  struct mpi_datatype< std::vector<U> >
+  template<class U, class A>
+  struct mpi_datatype< std::vector<U,A> >
   {
-    typedef     std::vector<U>      VecU;
+    typedef     std::vector<U,A>    VecU;
 
     static diy::mpi::datatype   datatype()              { return mpi_datatype<U>::datatype(); }
     static const void*          address(const VecU& x)  { return x.data(); }
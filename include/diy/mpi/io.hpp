@@ -54,17 +54,17 @@ namespace io
       DIY_MPI_EXPORT_FUNCTION void   write_at(offset o, const char* buffer, size_t size);
       DIY_MPI_EXPORT_FUNCTION void   write_at_all(offset o, const char* buffer, size_t size);
 
-      template<class T>
-      inline void           read_at(offset o, std::vector<T>& data);
+      template<class T, class A>
+      inline void           read_at(offset o, std::vector<T,A>& data);
 
-      template<class T>
-      inline void           read_at_all(offset o, std::vector<T>& data);
+      template<class T, class A>
+      inline void           read_at_all(offset o, std::vector<T,A>& data);
 
-      template<class T>
-      inline void           write_at(offset o, const std::vector<T>& data);
+      template<class T, class A>
+      inline void           write_at(offset o, const std::vector<T,A>& data);
 
-      template<class T>
-      inline void           write_at_all(offset o, const std::vector<T>& data);
+      template<class T, class A>
+      inline void           write_at_all(offset o, const std::vector<T,A>& data);
 
       DIY_MPI_EXPORT_FUNCTION void   read_bov(const DiscreteBounds& bounds, int ndims, const int dims[], char* buffer, size_t offset, const datatype& dt, bool collective, int chunk);
       DIY_MPI_EXPORT_FUNCTION void   write_bov(const DiscreteBounds& bounds, const DiscreteBounds& core, int ndims, const int dims[], const char* buffer, size_t offset, const datatype& dt, bool collective, int chunk);
@@ -78,34 +78,34 @@ namespace io
   };
 }
 
-template<class T>
+template<class T, class A>
 void
 diy::mpi::io::file::
-read_at(offset o, std::vector<T>& data)
+read_at(offset o, std::vector<T,A>& data)
 {
   read_at(o, &data[0], data.size()*sizeof(T));
 }
 
-template<class T>
+template<class T, class A>
 void
 diy::mpi::io::file::
-read_at_all(offset o, std::vector<T>& data)
+read_at_all(offset o, std::vector<T,A>& data)
 {
   read_at_all(o, (char*) &data[0], data.size()*sizeof(T));
 }
 
-template<class T>
+template<class T, class A>
 void
 diy::mpi::io::file::
-write_at(offset o, const std::vector<T>& data)
+write_at(offset o, const std::vector<T,A>& data)
 {
   write_at(o, (const char*) &data[0], data.size()*sizeof(T));
 }
 
-template<class T>
+template<class T, class A>
 void
 diy::mpi::io::file::
-write_at_all(offset o, const std::vector<T>& data)
+write_at_all(offset o, const std::vector<T,A>& data)
 {
   write_at_all(o, &data[0], data.size()*sizeof(T));
 }
@@ -52,8 +52,8 @@ namespace detail
     return recv(comm, source, tag, address(x), count(x), datatype_of(x));
   }
 
-  template <class T>
-  status recv(DIY_MPI_Comm comm, int source, int tag, std::vector<T>& x)
+  template <class T, class A>
+  status recv(DIY_MPI_Comm comm, int source, int tag, std::vector<T,A>& x)
   {
     auto s = probe(comm, source, tag);
     x.resize(static_cast<size_t>(s.count<T>()));
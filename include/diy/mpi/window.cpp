@@ -165,7 +165,8 @@ void fetch(const DIY_MPI_Win& win, void* result, const datatype& type, int rank,
 void replace(const DIY_MPI_Win& win, const void* value, const datatype& type, int rank, unsigned offset)
 {
 #if DIY_HAS_MPI
-  MPI_Fetch_and_op(value, nullptr, mpi_cast(type.handle), rank, offset, MPI_REPLACE, mpi_cast(win));
+  // not MPI_Fetch_and_op with a null result, which some implementations dereference
+  MPI_Accumulate(value, 1, mpi_cast(type.handle), rank, offset, 1, mpi_cast(type.handle), MPI_REPLACE, mpi_cast(win));
 #else
   (void) rank;
   void* buffer = mpi_cast(win).data();
@@ -176,6 +177,23 @@ void replace(const DIY_MPI_Win& win, const void* value, const datatype& type, in
 #endif
 }
 
+void compare_and_swap(const DIY_MPI_Win& win,
+                      const void* value, const void* compare, void* result, const datatype& type,
+                      int rank, unsigned offset)
+{
+#if DIY_HAS_MPI
+  MPI_Compare_and_swap(value, compare, result, mpi_cast(type.handle), rank, offset, mpi_cast(win));
+#else
+  (void) rank;
+  void* buffer = mpi_cast(win).data();
+  size_t size = mpi_cast(type.handle);
+  int8_t* target = static_cast<int8_t*>(buffer) + (offset * size);
+  std::copy_n(target, size, static_cast<int8_t*>(result));
+  if (std::equal(target, target + size, static_cast<const int8_t*>(compare)))
+    std::copy_n(static_cast<const int8_t*>(value), size, target);
+#endif
+}
+
 void sync(const DIY_MPI_Win& win)
 {
 #if DIY_HAS_MPI
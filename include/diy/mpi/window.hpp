@@ -70,6 +70,11 @@ void replace(const DIY_MPI_Win& win,
              const void* value, const datatype& type,
              int rank, unsigned offset);
 
+DIY_MPI_EXPORT_FUNCTION
+void compare_and_swap(const DIY_MPI_Win& win,
+                      const void* value, const void* compare, void* result, const datatype& type,
+                      int rank, unsigned offset);
+
 DIY_MPI_EXPORT_FUNCTION
 void sync(const DIY_MPI_Win& win);
 
@@ -123,6 +128,8 @@ void flush_local_all(const DIY_MPI_Win& win);
             inline void fetch_and_op(const T* origin, T* result, int rank, unsigned offset, const operation& op);
             inline void fetch(T& result, int rank, unsigned offset);
             inline void replace(const T& value, int rank, unsigned offset);
+            //! atomically set the element to `value` if it equals `compare`; `result` gets the old element (after a flush)
+            inline void compare_and_swap(const T& value, const T& compare, T& result, int rank, unsigned offset);
 
             inline void sync();
 
@@ -281,6 +288,14 @@ replace(const T& value, int rank, unsigned offset)
   detail::replace(window_, &value, datatype_of(value), rank, offset);
 }
 
+template<class T>
+void
+diy::mpi::window<T>::
+compare_and_swap(const T& value, const T& compare, T& result, int rank, unsigned offset)
+{
+  detail::compare_and_swap(window_, &value, &compare, &result, datatype_of(value), rank, offset);
+}
+
 template<class T>
 void
 diy::mpi::window<T>::
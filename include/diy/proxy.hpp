@@ -98,10 +98,7 @@ namespace diy
     void                enqueue(const BlockID&  to,                                     //!< target block (gid,proc)
                                 const T&        x,                                      //!< data (eg. STL vector)
                                 void (*save)(BinaryBuffer&, const T&) = &::diy::save    //!< optional serialization function
-                               ) const
-    {
-        save(outgoing_[to], x);
-    }
+                               ) const;
 
     //! Enqueue data whose size is given explicitly by the user, e.g., an array.
     template<class T>
@@ -117,6 +114,19 @@ namespace diy
                                 size_t          n                                       //!< size in data elements (eg. ints)
                                ) const;
 
+    //! Enqueue the same data to many targets (e.g., all the neighbors), serializing it only once.
+    //! Large values are shared by all the queues, as a binary blob, instead of being copied into each one;
+    //! they are sent from and delivered locally in the same memory. Dequeue with `dequeue_multicast()`.
+    template<class T>
+    void                enqueue_multicast
+                               (const std::vector<BlockID>& targets,                   //!< target blocks (gid,proc)
+                                const T&        x,                                      //!< data (eg. STL vector)
+                                void (*save)(BinaryBuffer&, const T&) = &::diy::save    //!< optional serialization function
+                               ) const;
+
+    //! size, in bytes, from which `enqueue_multicast()` shares the serialized data instead of copying it
+    static size_t       multicast_share_size()                          { return 4096; }
+
     //! Dequeue data whose size can be determined automatically (e.g., STL vector) and that was
     //! previously enqueued so that diy knows its size when it is received.
     //! In this case, diy will allocate the receive buffer; the user does not need to do so.
@@ -124,8 +134,7 @@ namespace diy
     void                dequeue(int             from,                                   //!< target block gid
                                 T&              x,                                      //!< data (eg. STL vector)
                                 void (*load)(BinaryBuffer&, T&) = &::diy::load          //!< optional serialization function
-                               ) const
-    { load(incoming_[from], x); }
+                               ) const;
 
     //! Dequeue an array of data whose size is given explicitly by the user.
     //! In this case, the user needs to allocate the receive buffer prior to calling dequeue.
@@ -157,6 +166,41 @@ namespace diy
     BinaryBlob inline   dequeue_blob
                                (int  from) const;
 
+    //! Dequeue data enqueued with `enqueue_multicast()`.
+    template<class T>
+    void                dequeue_multicast
+                               (int             from,                                   //!< target block gid
+                                T&              x,                                      //!< data (eg. STL vector)
+                                void (*load)(BinaryBuffer&, T&) = &::diy::load          //!< optional serialization function
+                               ) const;
+
+    template<class T>
+    void                dequeue_multicast
+                               (const BlockID&  from,                                   //!< target block (gid,proc)
+                                T&              x,                                      //!< data (eg. STL vector)
+                                void (*load)(BinaryBuffer&, T&) = &::diy::load          //!< optional serialization function
+                               ) const                                  { dequeue_multicast(from.gid, x, load); }
+
+    //! View the next `n` values of a trivially copyable type (e.g., enqueued as an array or as
+    //! records one by one) directly in the incoming queue, without copying them out.
+    //! The view is valid until the callback returns. The values are copied only if they are not
+    //! aligned for `T` in the queue, i.e., if the data enqueued before them wasn't a multiple of `alignof(T)` bytes.
+    template<class T>
+    ArrayView<T>        dequeue_view(int             from,                              //!< target block gid
+                                     size_t          n                                  //!< size in data elements
+                                    ) const;
+
+    //! View the elements of an `std::vector<T>` of trivially copyable values, enqueued with `enqueue(to, v)`,
+    //! directly in the incoming queue.
+    template<class T>
+    ArrayView<T>        dequeue_view(int from) const                    { size_t n; diy::load(incoming_[from], n); return dequeue_view<T>(from, n); }
+
+    template<class T>
+    ArrayView<T>        dequeue_view(const BlockID& from, size_t n) const   { return dequeue_view<T>(from.gid, n); }
+
+    template<class T>
+    ArrayView<T>        dequeue_view(const BlockID& from) const         { return dequeue_view<T>(from.gid); }
+
     template<class T>
     EnqueueIterator<T>  enqueuer(const T& x,
                                  void (*save)(BinaryBuffer&, const T&) = &::diy::save   ) const
@@ -215,6 +259,14 @@ namespace diy
     void                set_done(bool x)                                { done_ = x; }
     bool                done() const                                    { return done_; }
 
+    private:
+      // size the queue once for the values that report their serialized size cheaply
+      template<class T>
+      static void       reserve(MemoryBuffer& bb, const T& x, std::true_type)  { bb.reserve_ahead(diy::serialized_size(x)); }
+
+      template<class T>
+      static void       reserve(MemoryBuffer&, const T&, std::false_type)      {}
+
     private:
       int               gid_;
       Master*           master_;
@@ -342,27 +394,60 @@ scratch(const T& in) const
   collectives_->push_back(Collective(new detail::Scratch<T>(in)));
 }
 
+template<class T>
+void
+diy::Master::Proxy::
+enqueue(const BlockID& to, const T& x,
+        void (*save)(BinaryBuffer&, const T&)) const
+{
+    MemoryBuffer&   bb  = outgoing_[to];
+    if (save == (void (*)(BinaryBuffer&, const T&)) &::diy::save<T>)
+    {
+        reserve(bb, x, detail::is_sized<T>());
+        diy::save(bb, x);           // MemoryBuffer overload, without virtual calls
+    }
+    else
+        save(bb, x);
+}
+
 template<class T>
 void
 diy::Master::Proxy::
 enqueue(const BlockID& to, const T* x, size_t n,
         void (*save)(BinaryBuffer&, const T&)) const
 {
-    BinaryBuffer&   bb  = outgoing_[to];
+    MemoryBuffer&   bb  = outgoing_[to];
     if (save == (void (*)(BinaryBuffer&, const T&)) &::diy::save<T>)
+    {
+        if (detail::IsFixed<T>::value)
+            bb.reserve_ahead(n * detail::Fixed<T>::size());
         diy::save(bb, x, n);       // optimized for unspecialized types
+    }
     else
         for (size_t i = 0; i < n; ++i)
             save(bb, x[i]);
 }
 
+template<class T>
+void
+diy::Master::Proxy::
+dequeue(int from, T& x,
+        void (*load)(BinaryBuffer&, T&)) const
+{
+    MemoryBuffer&   bb = incoming_[from];
+    if (load == (void (*)(BinaryBuffer&, T&)) &::diy::load<T>)
+        diy::load(bb, x);           // MemoryBuffer overload, without virtual calls
+    else
+        load(bb, x);
+}
+
 template<class T>
 void
 diy::Master::Proxy::
 dequeue(int from, T* x, size_t n,
         void (*load)(BinaryBuffer&, T&)) const
 {
-    BinaryBuffer&   bb = incoming_[from];
+    MemoryBuffer&   bb = incoming_[from];
     if (load == (void (*)(BinaryBuffer&, T&)) &::diy::load<T>)
         diy::load(bb, x, n);       // optimized for unspecialized types
     else
@@ -370,6 +455,87 @@ dequeue(int from, T* x, size_t n,
             load(bb, x[i]);
 }
 
+template<class T>
+void
+diy::Master::Proxy::
+enqueue_multicast(const std::vector<BlockID>& targets, const T& x,
+                  void (*save)(BinaryBuffer&, const T&)) const
+{
+    if (targets.empty())
+        return;
+
+    std::shared_ptr<MemoryBuffer> shared = std::make_shared<MemoryBuffer>();
+    if (save == (void (*)(BinaryBuffer&, const T&)) &::diy::save<T>)
+    {
+        reserve(*shared, x, detail::is_sized<T>());
+        diy::save(*shared, x);
+    }
+    else
+        save(*shared, x);
+
+    if (shared->nblobs() > 0)
+        throw std::runtime_error("enqueue_multicast() doesn't support data with binary blobs");
+
+    // blobs go out as separate messages, so share only the values large enough to be worth it;
+    // blobs also can't be split into parts yet
+    const char* data  = shared->buffer.data();
+    size_t      count = shared->size();
+    bool        share = count >= multicast_share_size() && count < INT_MAX;
+
+    for (const BlockID& to : targets)
+    {
+        MemoryBuffer& bb = outgoing_[to];
+        diy::save(bb, share);
+        if (share)
+            bb.save_binary_blob(data, count, detail::SharedBlobDeleter { shared });
+        else if (count > 0)
+            std::memcpy(bb.MemoryBuffer::grow(count), data, count);
+    }
+}
+
+template<class T>
+void
+diy::Master::Proxy::
+dequeue_multicast(int from, T& x,
+                  void (*load)(BinaryBuffer&, T&)) const
+{
+    bool shared;
+    diy::load(incoming_[from], shared);
+    if (!shared)
+    {
+        dequeue(from, x, load);
+        return;
+    }
+
+    BinaryBlob blob = dequeue_blob(from);
+    detail::BlobBuffer bb(blob.pointer.get(), blob.size);
+    load(bb, x);
+}
+
+template<class T>
+diy::ArrayView<T>
+diy::Master::Proxy::
+dequeue_view(int from, size_t n) const
+{
+    static_assert(detail::is_default< Serialization<T> >::value, "dequeue_view() works only for types with default serialization");
+
+    if (n == 0)
+        return ArrayView<T>();
+
+    MemoryBuffer&   bb = incoming_[from];
+    if (bb.position + n * sizeof(T) > bb.size())
+        throw std::runtime_error(fmt::format("Cannot view {} elements from {}: only {} bytes left in the queue", n, from, bb.size() - bb.position));
+
+    // the queue starts at the beginning of its storage, which is aligned for any type
+    const char* p = bb.MemoryBuffer::advance(n * sizeof(T));
+    if (reinterpret_cast<std::uintptr_t>(p) % alignof(T) == 0)
+        return ArrayView<T>(reinterpret_cast<const T*>(p), n);
+
+    std::shared_ptr<std::vector<T>> copy = std::make_shared<std::vector<T>>(n);
+    std::memcpy(copy->data(), p, n * sizeof(T));
+    return ArrayView<T>(copy);
+}
+
 void
 diy::Master::Proxy::
 enqueue_blob(const BlockID& to, const char* x, size_t n) const
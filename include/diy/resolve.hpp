@@ -64,6 +64,9 @@ update_links(diy::Master& master, const diy::DynamicAssigner& assigner)
         for (auto& blockid : link->neighbors())
             blockid.proc = gid_to_proc[blockid.gid];
     }
+
+    // blocks have moved, so the receivers may have dropped their copies for the temporal deltas
+    master.reset_temporal_deltas();
 }
 
 void
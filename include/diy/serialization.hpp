@@ -1,12 +1,16 @@
 #ifndef DIY_SERIALIZATION_HPP
 #define DIY_SERIALIZATION_HPP
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <functional>
 #include <map>
 #include <memory>
 #include <set>
+#include <stdexcept>
 #include <string>
 #include <tuple>
 #include <type_traits>              // this is used for a safety check for default serialization
@@ -15,6 +19,9 @@
 #include <valarray>
 #include <vector>
 
+#include "memory-resource.hpp"
+#include "detail/preprocessor.hpp"
+
 namespace diy
 {
   struct BinaryBlob
@@ -43,10 +50,13 @@ namespace diy
 
   struct MemoryBuffer: public BinaryBuffer
   {
-    using Blob = BinaryBlob;
+    using Blob   = BinaryBlob;
+    using Buffer = std::vector<char, BufferAllocator<char>>;       //!< growing it doesn't zero-fill the memory
 
-                        MemoryBuffer(size_t position_ = 0):
-                          position(position_)                       {}
+                        MemoryBuffer(size_t          position_ = 0,
+                                     MemoryResource* resource  = default_memory_resource()):
+                          position(position_),
+                          buffer(BufferAllocator<char>(resource))   {}
 
                         MemoryBuffer(MemoryBuffer&&)                =default;
                         MemoryBuffer(const MemoryBuffer&)           =delete;
@@ -66,13 +76,19 @@ namespace diy
     size_t              nblobs() const                              { return blobs.size(); }
 
     void                clear()                                     { buffer.clear(); reset(); }
-    void                wipe()                                      { std::vector<char>().swap(buffer); reset(); }
+    void                wipe()                                      { Buffer(buffer.get_allocator()).swap(buffer); reset(); }
     void                reset()                                     { position = 0; }
     void                skip(size_t s)                              { position += s; }
     void                swap(MemoryBuffer& o)                       { std::swap(position, o.position); buffer.swap(o.buffer); std::swap(blob_position, o.blob_position); blobs.swap(o.blobs); }
     bool                empty() const                               { return buffer.empty(); }
     size_t              size() const                                { return buffer.size(); }
     void                reserve(size_t s)                           { buffer.reserve(s); }
+    //! make room for `count` more bytes past the current position, so that saving them doesn't reallocate
+    void                reserve_ahead(size_t count)
+    {
+      if (position + count > buffer.capacity())
+        buffer.reserve((std::max)(position + count, static_cast<size_t>(static_cast<double>(buffer.capacity()) * growth_multiplier())));
+    }
                         operator bool() const                       { return position < buffer.size(); }
 
     //! copy a memory buffer from one buffer to another, bypassing making a temporary copy first
@@ -92,13 +108,45 @@ namespace diy
         position = 0;
     }
 
+    MemoryResource*     resource() const                            { return buffer.get_allocator().resource(); }
+
     size_t              position;
-    std::vector<char>   buffer;
+    Buffer              buffer;
 
     size_t              blob_position = 0;
     std::vector<Blob>   blobs;
   };
 
+  //! Read-only view of an array of trivially copyable values inside a buffer (see `Master::Proxy::dequeue_view()`).
+  //! The values are always aligned for `T`: if they are not aligned in the buffer, the view holds an aligned copy.
+  template<class T>
+  struct ArrayView
+  {
+    using value_type     = T;
+    using const_iterator = const T*;
+
+                        ArrayView()                                 =default;
+                        ArrayView(const T* data__, size_t size__):
+                          data_(data__), size_(size__)              {}
+                        ArrayView(std::shared_ptr<const std::vector<T>> copy__):
+                          copy_(copy__), data_(copy_->data()), size_(copy_->size())   {}
+
+    const T*            data() const                                { return data_; }
+    size_t              size() const                                { return size_; }
+    bool                empty() const                               { return size_ == 0; }
+    const T*            begin() const                               { return data_; }
+    const T*            end() const                                 { return data_ + size_; }
+    const T&            operator[](size_t i) const                  { return data_[i]; }
+
+    //! whether the values had to be copied out of the buffer to align them
+    bool                copied() const                              { return static_cast<bool>(copy_); }
+
+    private:
+      std::shared_ptr<const std::vector<T>>     copy_;
+      const T*                                  data_ = nullptr;
+      size_t                                    size_ = 0;
+  };
+
   namespace detail
   {
     struct Default {};
@@ -142,6 +190,10 @@ namespace diy
     static void         save(BinaryBuffer& bb, const T& x)          { bb.save_binary((const char*)  &x, sizeof(T)); }
     static void         load(BinaryBuffer& bb, T& x)                { bb.load_binary((char*)        &x, sizeof(T)); }
     static size_t       size(const T&)                              { return sizeof(T); }
+
+    // non-virtual versions for MemoryBuffer
+    static void         save(MemoryBuffer& bb, const T& x)          { std::memcpy(bb.MemoryBuffer::grow(sizeof(T)), &x, sizeof(T)); }
+    static void         load(MemoryBuffer& bb, T& x)                { std::memcpy(&x, bb.MemoryBuffer::advance(sizeof(T)), sizeof(T)); }
   };
 
   //! Saves `x` to `bb` by calling `diy::Serialization<T>::save(bb,x)`.
@@ -152,6 +204,16 @@ namespace diy
   template<class T>
   void                  load(BinaryBuffer& bb, T& x)                { Serialization<T>::load(bb, x); }
 
+  //! Same as above, but picks `Serialization<T>::save(MemoryBuffer&, const T&)`, if the specialization
+  //! provides it. The built-in specializations do: they write directly into the buffer's storage,
+  //! without virtual calls, so the containers of small elements serialize much faster.
+  template<class T>
+  void                  save(MemoryBuffer& bb, const T& x)          { Serialization<T>::save(bb, x); }
+
+  //! Same as above, but picks `Serialization<T>::load(MemoryBuffer&, T&)`, if the specialization provides it.
+  template<class T>
+  void                  load(MemoryBuffer& bb, T& x)                { Serialization<T>::load(bb, x); }
+
   //! Optimization for arrays. If `diy::Serialization` is not specialized for `T`,
   //! the array will be copied all at once. Otherwise, it's copied element by element.
   template<class T>
@@ -162,10 +224,22 @@ namespace diy
   template<class T>
   void                  load(BinaryBuffer& bb, T* x, size_t n);
 
+  template<class T>
+  void                  save(MemoryBuffer& bb, const T* x, size_t n);
+
+  template<class T>
+  void                  load(MemoryBuffer& bb, T* x, size_t n);
+
   //! Supports only binary data copying (meant for simple footers).
   template<class T>
   void                  load_back(BinaryBuffer& bb, T& x)           { bb.load_binary_back((char*) &x, sizeof(T)); }
 
+  //! Number of bytes `diy::save(bb, x)` writes into `bb` (not counting the blobs).
+  //! Uses `Serialization<T>::size(x)`, if the specialization provides it (all the built-in ones do);
+  //! otherwise, serializes `x` into a buffer that only counts the bytes.
+  template<class T>
+  size_t                serialized_size(const T& x);
+
   //!@}
 
 
@@ -182,6 +256,275 @@ namespace diy
 
         enum { value = (sizeof(test((T*) 0)) == sizeof(yes)) };
     };
+
+    // Types whose serialization is a fixed number of raw bytes: default types, and pairs
+    // and tuples of them. Containers of such types reserve space in a MemoryBuffer once
+    // and copy the elements with plain memcpy.
+    template<class T>
+    struct Fixed
+    {
+        enum { value = is_default< Serialization<typename std::remove_cv<T>::type> >::value };
+
+        static size_t       size()                                  { return sizeof(T); }
+        static void         write(char*& p, const T& x)             { std::memcpy(p, (const char*) &x, sizeof(T)); p += sizeof(T); }
+        static void         read(const char*& p, T& x)              { std::memcpy((char*) &x, p, sizeof(T)); p += sizeof(T); }
+    };
+
+    template<class X, class Y>
+    struct Fixed< std::pair<X,Y> >
+    {
+        enum { value = Fixed<X>::value && Fixed<Y>::value };
+
+        static size_t       size()                                  { return Fixed<X>::size() + Fixed<Y>::size(); }
+        static void         write(char*& p, const std::pair<X,Y>& x){ Fixed<X>::write(p, x.first); Fixed<Y>::write(p, x.second); }
+        static void         read(const char*& p, std::pair<X,Y>& x) { Fixed<X>::read(p, x.first);  Fixed<Y>::read(p, x.second); }
+    };
+
+    template<class... Args>
+    struct Fixed< std::tuple<Args...> >
+    {
+        using Tuple = std::tuple<Args...>;
+
+        template<std::size_t I, class Dummy = void>
+        struct Element
+        {
+            using Head = Fixed<typename std::tuple_element<I, Tuple>::type>;
+            using Tail = Element<I+1>;
+
+            enum { value = Head::value && Tail::value };
+            static size_t   size()                                  { return Head::size() + Tail::size(); }
+            static void     write(char*& p, const Tuple& x)         { Head::write(p, std::get<I>(x)); Tail::write(p, x); }
+            static void     read(const char*& p, Tuple& x)          { Head::read(p, std::get<I>(x));  Tail::read(p, x); }
+        };
+
+        template<class Dummy>
+        struct Element<sizeof...(Args), Dummy>
+        {
+            enum { value = true };
+            static size_t   size()                                  { return 0; }
+            static void     write(char*&, const Tuple&)             {}
+            static void     read(const char*&, Tuple&)              {}
+        };
+
+        enum { value = Element<0>::value };
+
+        static size_t       size()                                  { return Element<0>::size(); }
+        static void         write(char*& p, const Tuple& x)         { Element<0>::write(p, x); }
+        static void         read(const char*& p, Tuple& x)          { Element<0>::read(p, x); }
+    };
+
+    template<class T>
+    using IsFixed = std::integral_constant<bool, Fixed<T>::value>;
+
+    // does Serialization<T> provide size()?
+    template<class T, class = void>
+    struct has_size: std::false_type {};
+
+    template<class T>
+    struct has_size<T, decltype((void) Serialization<T>::size(std::declval<const T&>()))>: std::true_type {};
+
+    // is the size of T cheap to compute, i.e., provided by T and all its elements?
+    template<class T>
+    struct is_sized: has_size<T> {};
+
+    template<class U, class A>
+    struct is_sized< std::vector<U,A> >: is_sized<U> {};
+
+    template<class U>
+    struct is_sized< std::valarray<U> >: is_sized<U> {};
+
+    template<class X, class Y>
+    struct is_sized< std::pair<X,Y> >: std::integral_constant<bool, is_sized<X>::value && is_sized<Y>::value> {};
+
+    template<class K, class V>
+    struct is_sized< std::map<K,V> >: is_sized< std::pair<K,V> > {};
+
+    template<class T>
+    struct is_sized< std::set<T> >: is_sized<T> {};
+
+    template<class K, class V, class H, class E, class A>
+    struct is_sized< std::unordered_map<K,V,H,E,A> >: is_sized< std::pair<K,V> > {};
+
+    template<class T, class H, class E, class A>
+    struct is_sized< std::unordered_set<T,H,E,A> >: is_sized<T> {};
+
+    template<class... Ts>
+    struct all_sized: std::true_type {};
+
+    template<class T, class... Ts>
+    struct all_sized<T, Ts...>: std::integral_constant<bool, is_sized<T>::value && all_sized<Ts...>::value> {};
+
+    template<class... Args>
+    struct is_sized< std::tuple<Args...> >: all_sized<Args...> {};
+
+    // deleter of the blobs that share one buffer (see Master::Proxy::enqueue_multicast());
+    // the buffer goes away with the last blob
+    struct SharedBlobDeleter
+    {
+      void          operator()(const char[]) const                                      {}
+
+      std::shared_ptr<const MemoryBuffer>   buffer;
+    };
+
+    // reads from memory it doesn't own, e.g., a blob
+    struct BlobBuffer: public BinaryBuffer
+    {
+                    BlobBuffer(const char* data_, size_t size_): data(data_), size(size_)   {}
+
+      void          save_binary(const char*, size_t) override                           { throw std::runtime_error("Cannot save to a BlobBuffer"); }
+      void          append_binary(const char*, size_t) override                         { throw std::runtime_error("Cannot save to a BlobBuffer"); }
+      void          load_binary(char* x, size_t count) override                         { std::memcpy(x, advance(count), count); }
+      void          load_binary_back(char* x, size_t count) override                    { check(count); size -= count; std::memcpy(x, data + size, count); }
+      char*         grow(size_t) override                                               { throw std::runtime_error("Cannot save to a BlobBuffer"); }
+      char*         advance(size_t count) override                                      { check(count); const char* p = data + position; position += count; return const_cast<char*>(p); }
+
+      void          save_binary_blob(const char*, size_t) override                      { throw std::runtime_error("Cannot save to a BlobBuffer"); }
+      void          save_binary_blob(const char*, size_t, BinaryBlob::Deleter) override { throw std::runtime_error("Cannot save to a BlobBuffer"); }
+      BinaryBlob    load_binary_blob() override                                         { throw std::runtime_error("No binary blobs in a BlobBuffer"); }
+
+      void          check(size_t count) const                                           { if (position + count > size) throw std::runtime_error("Reading past the end of a BlobBuffer"); }
+
+      const char*   data;
+      size_t        size;
+      size_t        position = 0;
+    };
+
+    // counts the bytes saved into it, for types that don't report their size
+    struct SizeBuffer: public BinaryBuffer
+    {
+      void          save_binary(const char*, size_t count) override                     { count_ += count; }
+      void          append_binary(const char*, size_t count) override                   { count_ += count; }
+      void          load_binary(char*, size_t) override                                 { throw std::runtime_error("Cannot load from a SizeBuffer"); }
+      void          load_binary_back(char*, size_t) override                            { throw std::runtime_error("Cannot load from a SizeBuffer"); }
+      char*         grow(size_t count) override                                         { count_ += count; scratch.resize(count); return scratch.data(); }
+      char*         advance(size_t) override                                            { throw std::runtime_error("Cannot advance a SizeBuffer"); }
+
+      void          save_binary_blob(const char*, size_t) override                      {}
+      void          save_binary_blob(const char* x, size_t, BinaryBlob::Deleter deleter) override { BinaryBlob::Pointer(x, deleter); }   // we own x, but don't need it
+      BinaryBlob    load_binary_blob() override                                         { throw std::runtime_error("Cannot load from a SizeBuffer"); }
+
+      size_t                count_ = 0;
+      std::vector<char>     scratch;
+    };
+
+    template<class T>
+    size_t              serialized_size(const T& x, std::true_type)     { return Serialization<T>::size(x); }
+
+    template<class T>
+    size_t              serialized_size(const T& x, std::false_type)    { SizeBuffer bb; Serialization<T>::save(bb, x); return bb.count_; }
+
+    // size of n elements starting at first
+    template<class T, class Iterator>
+    size_t              range_size(Iterator, size_t n, std::true_type)  { return n * Fixed<T>::size(); }
+
+    template<class T, class Iterator>
+    size_t              range_size(Iterator first, size_t n, std::false_type)
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < n; ++i, ++first)
+            total += diy::serialized_size(*first);
+        return total;
+    }
+
+    // vectors of trivially copyable elements, which are flattened when nested in another vector
+    template<class U>
+    struct is_flat_vector: std::false_type {};
+
+    template<class W, class A>
+    struct is_flat_vector< std::vector<W,A> >: std::integral_constant<bool, is_default< Serialization<W> >::value> {};
+
+    // fill v with n trivially copyable elements from bb
+    template<class W, class A>
+    void                load_vector(BinaryBuffer& bb, std::vector<W,A>& v, size_t n)
+    {
+        v.resize(n);
+        if (n > 0)
+            bb.load_binary((char*) &v[0], n * sizeof(W));
+    }
+
+    // copy straight from the buffer, if it's suitably aligned, instead of zeroing the elements first
+    template<class W, class A>
+    void                load_vector(MemoryBuffer& bb, std::vector<W,A>& v, size_t n)
+    {
+        if (n == 0)
+        {
+            v.clear();
+            return;
+        }
+
+        const char* p = bb.MemoryBuffer::advance(n * sizeof(W));
+        if (reinterpret_cast<std::uintptr_t>(p) % alignof(W) == 0)
+        {
+            const W* first = reinterpret_cast<const W*>(p);
+            v.assign(first, first + n);
+        } else
+        {
+            v.resize(n);
+            std::memcpy((char*) &v[0], p, n * sizeof(W));
+        }
+    }
+
+    // save n elements from the range starting at it; the size check happens once for fixed-size elements
+    template<class T, class Iterator>
+    void                save_range(MemoryBuffer& bb, Iterator it, size_t n, std::true_type)
+    {
+        if (n == 0)
+            return;
+        char* p = bb.MemoryBuffer::grow(n * Fixed<T>::size());
+        for (size_t i = 0; i < n; ++i, ++it)
+            Fixed<T>::write(p, *it);
+    }
+
+    template<class T, class Iterator>
+    void                save_range(MemoryBuffer& bb, Iterator it, size_t n, std::false_type)
+    {
+        for (size_t i = 0; i < n; ++i, ++it)
+            diy::save(bb, *it);
+    }
+
+    // load n elements, passing each one to f
+    template<class T, class F>
+    void                load_range(MemoryBuffer& bb, size_t n, const F& f, std::true_type)
+    {
+        if (n == 0)
+            return;
+        const char* p = bb.MemoryBuffer::advance(n * Fixed<T>::size());
+        for (size_t i = 0; i < n; ++i)
+        {
+            T x;
+            Fixed<T>::read(p, x);
+            f(x);
+        }
+    }
+
+    template<class T, class F>
+    void                load_range(MemoryBuffer& bb, size_t n, const F& f, std::false_type)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            T x;
+            diy::load(bb, x);
+            f(x);
+        }
+    }
+
+    // load n elements into x
+    template<class T>
+    void                load_array(MemoryBuffer& bb, T* x, size_t n, std::true_type)
+    {
+        if (n == 0)
+            return;
+        const char* p = bb.MemoryBuffer::advance(n * Fixed<T>::size());
+        for (size_t i = 0; i < n; ++i)
+            Fixed<T>::read(p, x[i]);
+    }
+
+    template<class T>
+    void                load_array(MemoryBuffer& bb, T* x, size_t n, std::false_type)
+    {
+        for (size_t i = 0; i < n; ++i)
+            diy::load(bb, x[i]);
+    }
   }
 
   template<class T>
@@ -208,6 +551,28 @@ namespace diy
       bb.load_binary((char*) &x[0], sizeof(T)*n);
   }
 
+  template<class T>
+  void                  save(MemoryBuffer& bb, const T* x, size_t n)
+  {
+    if (n == 0)
+      return;
+    if (detail::is_default< Serialization<T> >::value)
+      std::memcpy(bb.MemoryBuffer::grow(sizeof(T)*n), (const char*) &x[0], sizeof(T)*n);
+    else
+      detail::save_range<T>(bb, x, n, detail::IsFixed<T>());
+  }
+
+  template<class T>
+  void                  load(MemoryBuffer& bb, T* x, size_t n)
+  {
+    if (n == 0)
+      return;
+    if (detail::is_default< Serialization<T> >::value)
+      std::memcpy((char*) &x[0], bb.MemoryBuffer::advance(sizeof(T)*n), sizeof(T)*n);
+    else
+      detail::load_array(bb, x, n, detail::IsFixed<T>());
+  }
+
 
   // save/load for MemoryBuffer
   template<>
@@ -234,28 +599,103 @@ namespace diy
     }
   };
 
-  // save/load for std::vector<U>
-  template<class U>
-  struct Serialization< std::vector<U> >
+  // save/load for std::vector<U,A>
+  // Vectors of vectors of trivially copyable types are flattened:
+  // the number of vectors, their sizes, and then all their elements.
+  template<class U, class A>
+  struct Serialization< std::vector<U,A> >
   {
-    typedef             std::vector<U>          Vector;
+    typedef             std::vector<U,A>        Vector;
+    typedef             detail::is_flat_vector<U> Flat;
 
-    static void         save(BinaryBuffer& bb, const Vector& v)
-    {
-      size_t s = v.size();
-      diy::save(bb, s);
-      if (s > 0)
-        diy::save(bb, &v[0], v.size());
-    }
+    static void         save(BinaryBuffer& bb, const Vector& v)         { save(bb, v, Flat()); }
+    static void         load(BinaryBuffer& bb, Vector& v)               { load(bb, v, Flat()); }
+    static void         save(MemoryBuffer& bb, const Vector& v)         { save(bb, v, Flat()); }
+    static void         load(MemoryBuffer& bb, Vector& v)               { load(bb, v, Flat()); }
 
-    static void         load(BinaryBuffer& bb, Vector& v)
-    {
-      size_t s;
-      diy::load(bb, s);
-      v.resize(s, U());
-      if (s > 0)
-        diy::load(bb, &v[0], s);
-    }
+    static size_t       size(const Vector& v)                           { return size(v, Flat(), detail::IsFixed<U>()); }
+
+    private:
+      template<class Buffer>
+      static void       save(Buffer& bb, const Vector& v, std::false_type)
+      {
+        size_t s = v.size();
+        diy::save(bb, s);
+        if (s > 0)
+          diy::save(bb, &v[0], v.size());
+      }
+
+      template<class Buffer>
+      static void       load(Buffer& bb, Vector& v, std::false_type)
+      {
+        size_t s;
+        diy::load(bb, s);
+        load_elements(bb, v, s, std::integral_constant<bool, detail::is_default< Serialization<U> >::value>());
+      }
+
+      template<class Buffer>
+      static void       load_elements(Buffer& bb, Vector& v, size_t s, std::true_type)    { detail::load_vector(bb, v, s); }
+
+      template<class Buffer>
+      static void       load_elements(Buffer& bb, Vector& v, size_t s, std::false_type)
+      {
+        v.resize(s, U());                   // U() rather than resize(s): Serialization<U> may be a friend of U's private constructor
+        if (s > 0)
+          diy::load(bb, &v[0], s);
+      }
+
+      template<class Buffer>
+      static void       save(Buffer& bb, const Vector& v, std::true_type)
+      {
+        size_t s = v.size();
+        diy::save(bb, s);
+        if (s == 0)
+          return;
+
+        std::vector<size_t> sizes(s);
+        for (size_t i = 0; i < s; ++i)
+          sizes[i] = v[i].size();
+        diy::save(bb, &sizes[0], s);
+
+        for (auto& x : v)
+          if (!x.empty())
+            diy::save(bb, &x[0], x.size());
+      }
+
+      template<class Buffer>
+      static void       load(Buffer& bb, Vector& v, std::true_type)
+      {
+        size_t s;
+        diy::load(bb, s);
+        v.resize(s);
+        if (s == 0)
+          return;
+
+        std::vector<size_t> sizes;
+        detail::load_vector(bb, sizes, s);
+        for (size_t i = 0; i < s; ++i)
+          detail::load_vector(bb, v[i], sizes[i]);
+      }
+
+      // flattened
+      template<class Fixed>
+      static size_t     size(const Vector& v, std::true_type, Fixed)
+      {
+        size_t total = sizeof(size_t) * (1 + v.size());
+        for (auto& x : v)
+          total += x.size() * sizeof(typename U::value_type);
+        return total;
+      }
+
+      static size_t     size(const Vector& v, std::false_type, std::true_type)   { return sizeof(size_t) + v.size() * detail::Fixed<U>::size(); }
+
+      static size_t     size(const Vector& v, std::false_type, std::false_type)
+      {
+        size_t total = sizeof(size_t);
+        for (auto& x : v)
+          total += diy::serialized_size(x);
+        return total;
+      }
   };
 
   template<class U>
@@ -279,6 +719,8 @@ namespace diy
       if (s > 0)
         diy::load(bb, &v[0], s);
     }
+
+    static size_t       size(const ValArray& v)                         { return sizeof(size_t) + (v.size() > 0 ? detail::range_size<U>(&v[0], v.size(), detail::IsFixed<U>()) : 0); }
   };
 
   // save/load for std::string
@@ -299,13 +741,29 @@ namespace diy
       size_t sz;
       diy::load(bb, sz);
       s.resize(sz);
-      for (size_t i = 0; i < sz; ++i)
-      {
-          char c;
-          diy::load(bb, c);
-          s[i] = c;
-      }
+      if (sz > 0)
+        bb.load_binary(&s[0], sz);
+    }
+
+    static void         save(MemoryBuffer& bb, const String& s)
+    {
+      size_t sz = s.size();
+      char* p = bb.MemoryBuffer::grow(sizeof(sz) + sz);
+      std::memcpy(p, (const char*) &sz, sizeof(sz));
+      std::memcpy(p + sizeof(sz), s.data(), sz);
+    }
+
+    static void         load(MemoryBuffer& bb, String& s)
+    {
+      size_t sz;
+      diy::load(bb, sz);
+      if (sz > 0)
+        s.assign(bb.MemoryBuffer::advance(sz), sz);
+      else
+        s.clear();
     }
+
+    static size_t       size(const String& s)                           { return sizeof(size_t) + s.size(); }
   };
 
   // save/load for std::pair<X,Y>
@@ -325,6 +783,20 @@ namespace diy
       diy::load(bb, p.first);
       diy::load(bb, p.second);
     }
+
+    static void         save(MemoryBuffer& bb, const Pair& p)
+    {
+      diy::save(bb, p.first);
+      diy::save(bb, p.second);
+    }
+
+    static void         load(MemoryBuffer& bb, Pair& p)
+    {
+      diy::load(bb, p.first);
+      diy::load(bb, p.second);
+    }
+
+    static size_t       size(const Pair& p)                             { return diy::serialized_size(p.first) + diy::serialized_size(p.second); }
   };
 
   // save/load for std::map<K,V>
@@ -353,6 +825,25 @@ namespace diy
         diy::load(bb, m[k]);
       }
     }
+
+    static void         save(MemoryBuffer& bb, const Map& m)
+    {
+      size_t s = m.size();
+      diy::save(bb, s);
+      detail::save_range<typename Map::value_type>(bb, m.begin(), s, detail::IsFixed<typename Map::value_type>());
+    }
+
+    static void         load(MemoryBuffer& bb, Map& m)
+    {
+      size_t s;
+      diy::load(bb, s);
+      m.clear();
+      // the keys come sorted, so the end is the right hint
+      detail::load_range<std::pair<K,V>>(bb, s, [&m](std::pair<K,V>& x) { m.emplace_hint(m.end(), std::move(x)); },
+                                         detail::IsFixed<std::pair<K,V>>());
+    }
+
+    static size_t       size(const Map& m)                              { return sizeof(size_t) + detail::range_size<typename Map::value_type>(m.begin(), m.size(), detail::IsFixed<typename Map::value_type>()); }
   };
 
   // save/load for std::set<T>
@@ -381,6 +872,23 @@ namespace diy
         m.insert(p);
       }
     }
+
+    static void         save(MemoryBuffer& bb, const Set& m)
+    {
+      size_t s = m.size();
+      diy::save(bb, s);
+      detail::save_range<T>(bb, m.begin(), s, detail::IsFixed<T>());
+    }
+
+    static void         load(MemoryBuffer& bb, Set& m)
+    {
+      size_t s;
+      diy::load(bb, s);
+      m.clear();
+      detail::load_range<T>(bb, s, [&m](T& x) { m.emplace_hint(m.end(), std::move(x)); }, detail::IsFixed<T>());
+    }
+
+    static size_t       size(const Set& m)                              { return sizeof(size_t) + detail::range_size<T>(m.begin(), m.size(), detail::IsFixed<T>()); }
   };
 
   // save/load for std::unordered_map<K,V,H,E,A>
@@ -409,6 +917,25 @@ namespace diy
         m.emplace(std::move(p));
       }
     }
+
+    static void         save(MemoryBuffer& bb, const Map& m)
+    {
+      size_t s = m.size();
+      diy::save(bb, s);
+      detail::save_range<typename Map::value_type>(bb, m.begin(), s, detail::IsFixed<typename Map::value_type>());
+    }
+
+    static void         load(MemoryBuffer& bb, Map& m)
+    {
+      size_t s;
+      diy::load(bb, s);
+      m.clear();
+      m.reserve(s);
+      detail::load_range<std::pair<K,V>>(bb, s, [&m](std::pair<K,V>& x) { m.emplace(std::move(x)); },
+                                         detail::IsFixed<std::pair<K,V>>());
+    }
+
+    static size_t       size(const Map& m)                              { return sizeof(size_t) + detail::range_size<typename Map::value_type>(m.begin(), m.size(), detail::IsFixed<typename Map::value_type>()); }
   };
 
   // save/load for std::unordered_set<T,H,E,A>
@@ -437,6 +964,24 @@ namespace diy
         m.emplace(std::move(p));
       }
     }
+
+    static void         save(MemoryBuffer& bb, const Set& m)
+    {
+      size_t s = m.size();
+      diy::save(bb, s);
+      detail::save_range<T>(bb, m.begin(), s, detail::IsFixed<T>());
+    }
+
+    static void         load(MemoryBuffer& bb, Set& m)
+    {
+      size_t s;
+      diy::load(bb, s);
+      m.clear();
+      m.reserve(s);
+      detail::load_range<T>(bb, s, [&m](T& x) { m.emplace(std::move(x)); }, detail::IsFixed<T>());
+    }
+
+    static size_t       size(const Set& m)                              { return sizeof(size_t) + detail::range_size<T>(m.begin(), m.size(), detail::IsFixed<T>()); }
   };
 
   // save/load for std::tuple<...>
@@ -448,30 +993,468 @@ namespace diy
     typedef             std::tuple<Args...>     Tuple;
 
     static void         save(BinaryBuffer& bb, const Tuple& t)          { save<0>(bb, t); }
+    static void         save(MemoryBuffer& bb, const Tuple& t)          { save(bb, t, detail::IsFixed<Tuple>()); }
 
-    template<std::size_t I = 0>
+    template<std::size_t I = 0, class Buffer>
     static
     typename std::enable_if<I == sizeof...(Args), void>::type
-                        save(BinaryBuffer&, const Tuple&)               {}
+                        save(Buffer&, const Tuple&)                     {}
 
-    template<std::size_t I = 0>
+    template<std::size_t I = 0, class Buffer>
     static
     typename std::enable_if<I < sizeof...(Args), void>::type
-                        save(BinaryBuffer& bb, const Tuple& t)          { diy::save(bb, std::get<I>(t)); save<I+1>(bb, t); }
+                        save(Buffer& bb, const Tuple& t)                { diy::save(bb, std::get<I>(t)); save<I+1>(bb, t); }
+
+    static void         save(MemoryBuffer& bb, const Tuple& t, std::true_type)
+    {
+      char* p = bb.MemoryBuffer::grow(detail::Fixed<Tuple>::size());
+      detail::Fixed<Tuple>::write(p, t);
+    }
+    static void         save(MemoryBuffer& bb, const Tuple& t, std::false_type) { save<0>(bb, t); }
 
     static void         load(BinaryBuffer& bb, Tuple& t)                { load<0>(bb, t); }
+    static void         load(MemoryBuffer& bb, Tuple& t)                { load(bb, t, detail::IsFixed<Tuple>()); }
 
-    template<std::size_t I = 0>
+    template<std::size_t I = 0, class Buffer>
     static
     typename std::enable_if<I == sizeof...(Args), void>::type
-                        load(BinaryBuffer&, Tuple&)                     {}
+                        load(Buffer&, Tuple&)                           {}
 
-    template<std::size_t I = 0>
+    template<std::size_t I = 0, class Buffer>
     static
     typename std::enable_if<I < sizeof...(Args), void>::type
-                        load(BinaryBuffer& bb, Tuple& t)                { diy::load(bb, std::get<I>(t)); load<I+1>(bb, t); }
+                        load(Buffer& bb, Tuple& t)                      { diy::load(bb, std::get<I>(t)); load<I+1>(bb, t); }
+
+    static void         load(MemoryBuffer& bb, Tuple& t, std::true_type)
+    {
+      const char* p = bb.MemoryBuffer::advance(detail::Fixed<Tuple>::size());
+      detail::Fixed<Tuple>::read(p, t);
+    }
+    static void         load(MemoryBuffer& bb, Tuple& t, std::false_type) { load<0>(bb, t); }
+
+    template<std::size_t I = 0>
+    static
+    typename std::enable_if<I == sizeof...(Args), size_t>::type
+                        size(const Tuple&)                              { return 0; }
+
+    template<std::size_t I = 0>
+    static
+    typename std::enable_if<I < sizeof...(Args), size_t>::type
+                        size(const Tuple& t)                            { return diy::serialized_size(std::get<I>(t)) + size<I+1>(t); }
+  };
+
+  template<class T>
+  size_t                serialized_size(const T& x)                 { return detail::serialized_size(x, detail::has_size<T>()); }
+
+  //! Block save function for `Master` (and `Collection`) that uses `Serialization<Block>`, e.g., generated by `DIY_SERIALIZE`.
+  template<class Block>
+  void                  save_block(const void* b, BinaryBuffer& bb) { diy::save(bb, *static_cast<const Block*>(b)); }
+
+  //! Block load function for `Master` (and `Collection`) that uses `Serialization<Block>`.
+  template<class Block>
+  void                  load_block(void* b, BinaryBuffer& bb)       { diy::load(bb, *static_cast<Block*>(b)); }
+
+  namespace detail
+  {
+    // Walk the fields listed in DIY_SERIALIZE; runs of trivially copyable fields that are
+    // adjacent in memory (no padding between them) are copied at once.
+    template<class Buffer>
+    struct FieldSaver
+    {
+                    FieldSaver(Buffer& bb_): bb(bb_)                {}
+
+      template<class F>
+      void          operator()(const F& f)                          { field(f, std::integral_constant<bool, is_default< Serialization<F> >::value>()); }
+
+      template<class F>
+      void          field(const F& f, std::true_type)
+      {
+        const char* p = reinterpret_cast<const char*>(&f);
+        if (p != end)
+        {
+          flush();
+          begin = p;
+        }
+        end = p + sizeof(F);
+      }
+
+      template<class F>
+      void          field(const F& f, std::false_type)              { flush(); diy::save(bb, f); }
+
+      void          flush()                                         { if (begin != end) diy::save(bb, begin, static_cast<size_t>(end - begin)); begin = end = nullptr; }
+
+      Buffer&       bb;
+      const char*   begin = nullptr;
+      const char*   end   = nullptr;
+    };
+
+    template<class Buffer>
+    struct FieldLoader
+    {
+                    FieldLoader(Buffer& bb_): bb(bb_)               {}
+
+      template<class F>
+      void          operator()(F& f)                                { field(f, std::integral_constant<bool, is_default< Serialization<F> >::value>()); }
+
+      template<class F>
+      void          field(F& f, std::true_type)
+      {
+        char* p = reinterpret_cast<char*>(&f);
+        if (p != end)
+        {
+          flush();
+          begin = p;
+        }
+        end = p + sizeof(F);
+      }
+
+      template<class F>
+      void          field(F& f, std::false_type)                    { flush(); diy::load(bb, f); }
+
+      void          flush()                                         { if (begin != end) diy::load(bb, begin, static_cast<size_t>(end - begin)); begin = end = nullptr; }
+
+      Buffer&       bb;
+      char*         begin = nullptr;
+      char*         end   = nullptr;
+    };
+
+    struct FieldSizer
+    {
+      template<class F>
+      void          operator()(const F& f)                          { total += diy::serialized_size(f); }
+      void          flush()                                         {}
+
+      size_t        total = 0;
+    };
+
+    // Columns of the fields of n records: trivially copyable fields are gathered into
+    // (scattered from) n * sizeof(F) contiguous bytes; the rest are saved one by one.
+    template<class T, class C, class F>
+    void                gather_column(char* p, const T* x, size_t n, F C::* field)
+    {
+      for (size_t i = 0; i < n; ++i, p += sizeof(F))
+        std::memcpy(p, (const char*) &(x[i].*field), sizeof(F));
+    }
+
+    template<class T, class C, class F>
+    void                scatter_column(const char* p, T* x, size_t n, F C::* field)
+    {
+      for (size_t i = 0; i < n; ++i, p += sizeof(F))
+        std::memcpy((char*) &(x[i].*field), p, sizeof(F));
+    }
+
+    template<class T, class C, class F>
+    void                save_column(BinaryBuffer& bb, const T* x, size_t n, F C::* field, std::true_type)
+    {
+      std::vector<char> column(n * sizeof(F));
+      gather_column(column.data(), x, n, field);
+      bb.save_binary(column.data(), column.size());
+    }
+
+    template<class T, class C, class F>
+    void                save_column(MemoryBuffer& bb, const T* x, size_t n, F C::* field, std::true_type)
+    {
+      if (n > 0)
+        gather_column(bb.MemoryBuffer::grow(n * sizeof(F)), x, n, field);
+    }
+
+    template<class Buffer, class T, class C, class F>
+    void                save_column(Buffer& bb, const T* x, size_t n, F C::* field, std::false_type)
+    {
+      for (size_t i = 0; i < n; ++i)
+        diy::save(bb, x[i].*field);
+    }
+
+    template<class Buffer, class T, class C, class F>
+    void                save_column(Buffer& bb, const T* x, size_t n, F C::* field)
+    {
+      save_column(bb, x, n, field, std::integral_constant<bool, is_default< Serialization<F> >::value>());
+    }
+
+    template<class T, class C, class F>
+    void                load_column(BinaryBuffer& bb, T* x, size_t n, F C::* field, std::true_type)
+    {
+      std::vector<char> column(n * sizeof(F));
+      bb.load_binary(column.data(), column.size());
+      scatter_column(column.data(), x, n, field);
+    }
 
+    template<class T, class C, class F>
+    void                load_column(MemoryBuffer& bb, T* x, size_t n, F C::* field, std::true_type)
+    {
+      if (n > 0)
+        scatter_column(bb.MemoryBuffer::advance(n * sizeof(F)), x, n, field);
+    }
+
+    template<class Buffer, class T, class C, class F>
+    void                load_column(Buffer& bb, T* x, size_t n, F C::* field, std::false_type)
+    {
+      for (size_t i = 0; i < n; ++i)
+        diy::load(bb, x[i].*field);
+    }
+
+    template<class Buffer, class T, class C, class F>
+    void                load_column(Buffer& bb, T* x, size_t n, F C::* field)
+    {
+      load_column(bb, x, n, field, std::integral_constant<bool, is_default< Serialization<F> >::value>());
+    }
+
+    template<class T, class C, class F>
+    size_t              column_size(const T* x, size_t n, F C::* field)
+    {
+      if (is_default< Serialization<F> >::value)
+        return n * sizeof(F);
+
+      size_t total = 0;
+      for (size_t i = 0; i < n; ++i)
+        total += diy::serialized_size(x[i].*field);
+      return total;
+    }
+
+    // a column held in its own vector, in the same format as above
+    template<class Buffer, class W, class A>
+    void                save_column(Buffer& bb, const std::vector<W,A>& v, size_t n)
+    {
+      if (n > 0)
+        diy::save(bb, &v[0], n);
+    }
+
+    template<class Buffer, class W, class A>
+    void                load_column(Buffer& bb, std::vector<W,A>& v, size_t n, std::true_type)     { load_vector(bb, v, n); }
+
+    template<class Buffer, class W, class A>
+    void                load_column(Buffer& bb, std::vector<W,A>& v, size_t n, std::false_type)
+    {
+      v.resize(n, W());
+      if (n > 0)
+        diy::load(bb, &v[0], n);
+    }
+
+    template<class Buffer, class W, class A>
+    void                load_column(Buffer& bb, std::vector<W,A>& v, size_t n)
+    {
+      load_column(bb, v, n, std::integral_constant<bool, is_default< Serialization<W> >::value>());
+    }
+
+    template<class W, class A>
+    size_t              column_size(const std::vector<W,A>& v, size_t n)
+    {
+      return n > 0 ? range_size<W>(&v[0], n, IsFixed<W>()) : 0;
+    }
+  }
+
+  /**
+   * \ingroup Serialization
+   * \brief Columnar (structure-of-arrays) encoding of a vector of records, whose type is
+   * described with `DIY_SERIALIZE`: the number of records, followed by the column of each field in turn,
+   * e.g., `cp.enqueue(target, diy::columns(particles))`. Trivially copyable fields form contiguous arrays of values.
+   */
+  template<class Vector>
+  struct Columns
+  {
+    Vector&             records;
+  };
+
+  template<class Vector>
+  Columns<Vector>       columns(Vector& records)                    { return { records }; }
+
+  /**
+   * \ingroup Serialization
+   * \brief The same encoding as `Columns` for the fields kept in separate vectors (of equal size),
+   * so that the records can be loaded straight into structure-of-arrays layouts (or saved from them), e.g.,
+   * `auto soa = diy::column_vectors(ids, positions, masses); cp.dequeue(source, soa);`.
+   */
+  template<class... Vectors>
+  struct ColumnVectors
+  {
+    std::tuple<Vectors&...> vectors;
+  };
+
+  template<class... Vectors>
+  ColumnVectors<Vectors...>
+                        column_vectors(Vectors&... vectors)         { return { std::tie(vectors...) }; }
+
+  template<class Vector>
+  struct Serialization< Columns<Vector> >
+  {
+    typedef             typename std::remove_const<Vector>::type::value_type    Record;
+
+    static void         save(BinaryBuffer& bb, const Columns<Vector>& c)    { save_(bb, c); }
+    static void         load(BinaryBuffer& bb, Columns<Vector>& c)          { load_(bb, c); }
+    static void         save(MemoryBuffer& bb, const Columns<Vector>& c)    { save_(bb, c); }
+    static void         load(MemoryBuffer& bb, Columns<Vector>& c)          { load_(bb, c); }
+
+    static size_t       size(const Columns<Vector>& c)
+    {
+      return sizeof(size_t) + (c.records.empty() ? 0 : Serialization<Record>::columns_size(&c.records[0], c.records.size()));
+    }
+
+    private:
+      template<class Buffer>
+      static void       save_(Buffer& bb, const Columns<Vector>& c)
+      {
+        size_t n = c.records.size();
+        diy::save(bb, n);
+        if (n > 0)
+          Serialization<Record>::save_columns(bb, &c.records[0], n);
+      }
+
+      template<class Buffer>
+      static void       load_(Buffer& bb, Columns<Vector>& c)
+      {
+        size_t n;
+        diy::load(bb, n);
+        c.records.resize(n);
+        if (n > 0)
+          Serialization<Record>::load_columns(bb, &c.records[0], n);
+      }
   };
+
+  template<class... Vectors>
+  struct Serialization< ColumnVectors<Vectors...> >
+  {
+    typedef             ColumnVectors<Vectors...>           Columns;
+    typedef             std::tuple<Vectors&...>             Tuple;
+
+    static void         save(BinaryBuffer& bb, const Columns& c)        { save_(bb, c); }
+    static void         load(BinaryBuffer& bb, Columns& c)              { load_(bb, c); }
+    static void         save(MemoryBuffer& bb, const Columns& c)        { save_(bb, c); }
+    static void         load(MemoryBuffer& bb, Columns& c)              { load_(bb, c); }
+
+    static size_t       size(const Columns& c)                          { return sizeof(size_t) + size<0>(c.vectors, std::get<0>(c.vectors).size()); }
+
+    private:
+      template<class Buffer>
+      static void       save_(Buffer& bb, const Columns& c)
+      {
+        size_t n = std::get<0>(c.vectors).size();
+        check<0>(c.vectors, n);
+        diy::save(bb, n);
+        save_columns<0>(bb, c.vectors, n);
+      }
+
+      template<class Buffer>
+      static void       load_(Buffer& bb, Columns& c)
+      {
+        size_t n;
+        diy::load(bb, n);
+        load_columns<0>(bb, c.vectors, n);
+      }
+
+      template<std::size_t I>
+      static
+      typename std::enable_if<I == sizeof...(Vectors)>::type
+                        check(const Tuple&, size_t)                     {}
+
+      template<std::size_t I>
+      static
+      typename std::enable_if<I < sizeof...(Vectors)>::type
+                        check(const Tuple& t, size_t n)
+      {
+        if (std::get<I>(t).size() != n)
+          throw std::runtime_error("Columns must have the same size");
+        check<I+1>(t, n);
+      }
+
+      template<std::size_t I, class Buffer>
+      static
+      typename std::enable_if<I == sizeof...(Vectors)>::type
+                        save_columns(Buffer&, const Tuple&, size_t)     {}
+
+      template<std::size_t I, class Buffer>
+      static
+      typename std::enable_if<I < sizeof...(Vectors)>::type
+                        save_columns(Buffer& bb, const Tuple& t, size_t n)  { detail::save_column(bb, std::get<I>(t), n); save_columns<I+1>(bb, t, n); }
+
+      template<std::size_t I, class Buffer>
+      static
+      typename std::enable_if<I == sizeof...(Vectors)>::type
+                        load_columns(Buffer&, const Tuple&, size_t)     {}
+
+      template<std::size_t I, class Buffer>
+      static
+      typename std::enable_if<I < sizeof...(Vectors)>::type
+                        load_columns(Buffer& bb, const Tuple& t, size_t n)  { detail::load_column(bb, std::get<I>(t), n); load_columns<I+1>(bb, t, n); }
+
+      template<std::size_t I>
+      static
+      typename std::enable_if<I == sizeof...(Vectors), size_t>::type
+                        size(const Tuple&, size_t)                      { return 0; }
+
+      template<std::size_t I>
+      static
+      typename std::enable_if<I < sizeof...(Vectors), size_t>::type
+                        size(const Tuple& t, size_t n)                  { return detail::column_size(std::get<I>(t), n) + size<I+1>(t, n); }
+  };
+}
+
+#define DIY_SERIALIZE_FIELD(op, field)          op(x.field);
+#define DIY_SERIALIZE_COLUMN(op, field)         detail::op(bb, x, n, &Record::field);
+#define DIY_SERIALIZE_COLUMN_SIZE(op, field)    op += detail::column_size(x, n, &Record::field);
+
+/**
+ * \ingroup Serialization
+ * \brief Specialize `diy::Serialization` for a struct from the list of its fields, e.g.,
+ * `DIY_SERIALIZE(Block, n, bounds, values)`; use at global scope, with the fully qualified type name.
+ * The fields are saved in the listed order; runs of trivially copyable fields that are adjacent in memory
+ * are copied at once. Private fields require `friend struct diy::Serialization<Block>;`.
+ * Vectors of such types can also be saved column by column, see `diy::Columns`.
+ */
+#define DIY_SERIALIZE(Type, ...)                                                                                \
+namespace diy                                                                                                   \
+{                                                                                                               \
+  template<>                                                                                                    \
+  struct Serialization<Type>                                                                                    \
+  {                                                                                                             \
+    typedef             Type                                        Record;                                     \
+                                                                                                                \
+    template<class Buffer>                                                                                      \
+    static void         save_fields(Buffer& bb, const Type& x)                                                  \
+    {                                                                                                           \
+      detail::FieldSaver<Buffer> op(bb);                                                                        \
+      DIY_PP_FOR_EACH(DIY_SERIALIZE_FIELD, op, __VA_ARGS__)                                                     \
+      op.flush();                                                                                               \
+    }                                                                                                           \
+                                                                                                                \
+    template<class Buffer>                                                                                      \
+    static void         load_fields(Buffer& bb, Type& x)                                                        \
+    {                                                                                                           \
+      detail::FieldLoader<Buffer> op(bb);                                                                       \
+      DIY_PP_FOR_EACH(DIY_SERIALIZE_FIELD, op, __VA_ARGS__)                                                     \
+      op.flush();                                                                                               \
+    }                                                                                                           \
+                                                                                                                \
+    static void         save(BinaryBuffer& bb, const Type& x)       { save_fields(bb, x); }                     \
+    static void         load(BinaryBuffer& bb, Type& x)             { load_fields(bb, x); }                     \
+    static void         save(MemoryBuffer& bb, const Type& x)       { save_fields(bb, x); }                     \
+    static void         load(MemoryBuffer& bb, Type& x)             { load_fields(bb, x); }                     \
+                                                                                                                \
+    static size_t       size(const Type& x)                                                                     \
+    {                                                                                                           \
+      detail::FieldSizer op;                                                                                    \
+      DIY_PP_FOR_EACH(DIY_SERIALIZE_FIELD, op, __VA_ARGS__)                                                     \
+      return op.total;                                                                                          \
+    }                                                                                                           \
+                                                                                                                \
+    template<class Buffer>                                                                                      \
+    static void         save_columns(Buffer& bb, const Type* x, size_t n)                                       \
+    {                                                                                                           \
+      DIY_PP_FOR_EACH(DIY_SERIALIZE_COLUMN, save_column, __VA_ARGS__)                                           \
+    }                                                                                                           \
+                                                                                                                \
+    template<class Buffer>                                                                                      \
+    static void         load_columns(Buffer& bb, Type* x, size_t n)                                             \
+    {                                                                                                           \
+      DIY_PP_FOR_EACH(DIY_SERIALIZE_COLUMN, load_column, __VA_ARGS__)                                           \
+    }                                                                                                           \
+                                                                                                                \
+    static size_t       columns_size(const Type* x, size_t n)                                                   \
+    {                                                                                                           \
+      size_t total = 0;                                                                                         \
+      DIY_PP_FOR_EACH(DIY_SERIALIZE_COLUMN_SIZE, total, __VA_ARGS__)                                            \
+      return total;                                                                                             \
+    }                                                                                                           \
+  };                                                                                                            \
 }
 
 void
@@ -499,7 +1482,7 @@ append_binary(const char* x, size_t count)
             position = 0;
         } else
         {
-            std::vector<char> tmp;
+            Buffer tmp(buffer.get_allocator());
             tmp.reserve(new_size * static_cast<size_t>(growth_multiplier()));
             tmp.resize(cur_size);
 
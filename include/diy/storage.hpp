@@ -1,11 +1,17 @@
 #ifndef DIY_STORAGE_HPP
 #define DIY_STORAGE_HPP
 
+#include <algorithm>
+#include <chrono>
+#include <limits>
 #include <string>
 #include <map>
 #include <fstream>
+#include <memory>
+#include <stdexcept>
 #include <fcntl.h>
 
+#include "compression.hpp"
 #include "serialization.hpp"
 #include "thread.hpp"
 #include "log.hpp"
@@ -18,204 +24,476 @@ namespace diy
     using Save = std::function<void(const void*, BinaryBuffer&)>;
     using Load = std::function<void(void*, BinaryBuffer&)>;
 
+    //! Buffered file-backed serialization buffer.
+    //! Writes accumulate in a large in-memory buffer and go out with vectored
+    //! writes, large pieces bypassing the buffer; reads go through a read-ahead
+    //! buffer. Binary blobs are stored inline, and their locations are recorded
+    //! in an index at the end of the file, so they can be loaded in any order.
+    //! Files without blobs have no index and contain exactly the saved bytes.
     struct FileBuffer: public BinaryBuffer
     {
-                          FileBuffer(FILE* file_): file(file_), head(0), tail(0)    {}
+      using Blob    = BinaryBlob;
+      using Segment = io::utils::Segment;
 
-      // TODO: add error checking
-      virtual inline void save_binary(const char* x, size_t count) override   { fwrite(x, 1, count, file); head += count; }
-      virtual inline void append_binary(const char* x, size_t count) override
-      {
-          auto temp_pos = ftell(file);
-          fseek(file, static_cast<long>(tail), SEEK_END);
-          fwrite(x, 1, count, file);
-          tail += count;
-          fseek(file, temp_pos, SEEK_SET);
-      }
-      virtual inline void load_binary(char* x, size_t count) override         { auto n = fread(x, 1, count, file); DIY_UNUSED(n);}
-      virtual inline void load_binary_back(char* x, size_t count) override    { fseek(file, static_cast<long>(tail), SEEK_END); auto n = fread(x, 1, count, file); tail += count; fseek(file, static_cast<long>(head), SEEK_SET); DIY_UNUSED(n);}
+      enum class Mode { read, write };
+
+                          FileBuffer(int fd_, Mode mode_, size_t buffer_size = default_buffer_size()):
+                            fd(fd_), mode(mode_), capacity(buffer_size)                     { init(); }
+
+                          FileBuffer(const std::string& filename, Mode mode_, size_t buffer_size = default_buffer_size()):
+                            fd(open(filename, mode_)), mode(mode_), capacity(buffer_size)   { init(); }
+
+                          FileBuffer(const FileBuffer&)                   =delete;
+      FileBuffer&         operator=(const FileBuffer&)                    =delete;
+
+                          ~FileBuffer()                                   { try { close(); } catch (...) {} }
+
+      virtual inline void save_binary(const char* x, size_t count) override;
+      virtual inline void append_binary(const char* x, size_t count) override { save_binary(x, count); }     // writes are always at the end of the file
+      virtual inline void load_binary(char* x, size_t count) override;
+      virtual inline void load_binary_back(char* x, size_t count) override;
       virtual inline char* grow(size_t) override                              { throw std::runtime_error("Cannot grow a FileBuffer"); }
       virtual inline char* advance(size_t) override                           { throw std::runtime_error("Cannot advance a FileBuffer"); }
 
-      // TODO: for now, we just throw, but obviously it should be possile to store binary blobs in a file; might want to fall back
-      using Blob = BinaryBlob;
-      virtual inline void save_binary_blob(const char*, size_t) override      { throw std::runtime_error("Cannot save binary blobs in a FileBuffer"); }
+      virtual inline void save_binary_blob(const char* x, size_t count) override                    { save_binary_blob(x, count, [](const char[]) {}); }
+      virtual inline void save_binary_blob(const char* x, size_t count, Blob::Deleter deleter) override;
+      virtual inline Blob load_binary_blob() override;
+      size_t              nblobs() const                                  { return index.size(); }
+
+      //! flush the pending data (and the blob index) and close the file
+      inline void         close();
+
+      //! number of bytes written to or available in the file, including blobs
+      size_t              size() const                                    { return mode == Mode::write ? file_pos + used : data_end; }
 
-      virtual inline void save_binary_blob(const char*, size_t, Blob::Deleter) override { throw std::runtime_error("Cannot save binary blobs in a FileBuffer"); }
+      static size_t       default_buffer_size()                           { return 4*1024*1024; }
 
-      virtual inline Blob load_binary_blob() override                         { throw std::runtime_error("Cannot load binary blobs from a FileBuffer"); }
+    private:
+      struct BlobRecord
+      {
+        uint64_t    offset;
+        uint64_t    size;
+      };
 
-      size_t              size() const                                { return head; }
+      static uint64_t     magic()                                         { return 0x424F4C4259494400ULL; }     // "\0DIYBLOB"
 
-      FILE*  file;
-      size_t head, tail;  // tail is used to support reading from the back;
-                          // the mechanism is a little awkward and unused, but should work if needed
+      inline static int   open(const std::string& filename, Mode mode_);
+      inline void         init();
+      inline void         flush(const char* x = 0, size_t count = 0);
+      inline size_t       fill(char* x, size_t count);
+      inline void         read_at(char* x, size_t count, size_t offset);
+
+    private:
+      int                       fd;
+      Mode                      mode;
+      size_t                    capacity;
+      std::unique_ptr<char[]>   buffer;
+      size_t                    used     = 0;       // bytes in buffer: pending (write), or read ahead (read)
+      size_t                    cursor   = 0;       // next byte to load from buffer
+      size_t                    file_pos = 0;       // file offset of the end of the buffer
+      size_t                    data_end = 0;       // end of the file data, not counting the blob index
+      size_t                    tail     = 0;       // bytes loaded from the back of the file
+
+      std::vector<BlobRecord>   index;
+      size_t                    next_blob     = 0;  // next blob to skip over when reading sequentially
+      size_t                    blob_position = 0;  // next blob to return from load_binary_blob()
     };
   }
 
   class ExternalStorage
   {
     public:
+      //! Accepts a record in pieces; close() stores it and returns its id, as put() would.
+      struct Writer
+      {
+        virtual       ~Writer()                                         =default;
+        virtual void  write(const char* x, size_t count)                =0;
+        virtual int   close()                                           =0;
+      };
+
       virtual int   put(MemoryBuffer& bb)                               =0;
       virtual int   put(const void* x, detail::Save save)               =0;
       virtual void  get(int i, MemoryBuffer& bb, size_t extra = 0)      =0;
       virtual void  get(int i, void* x, detail::Load load)              =0;
       virtual void  destroy(int i)                                      =0;
+
+      //! start a record of (expected) size `size`, to be written in pieces;
+      //! by default, the pieces are collected in memory and put() on close
+      virtual std::unique_ptr<Writer>
+                    writer(size_t size)                                 { return std::unique_ptr<Writer>(new MemoryWriter(this, size)); }
+
+    private:
+      struct MemoryWriter: public Writer
+      {
+                      MemoryWriter(ExternalStorage* storage_, size_t size): storage(storage_)   { bb.buffer.reserve(size); }
+        void          write(const char* x, size_t count) override       { bb.save_binary(x, count); }
+        int           close() override                                  { return storage->put(bb); }
+
+        ExternalStorage*    storage;
+        MemoryBuffer        bb;
+      };
   };
 
+  //! Stores records in temporary files. Given several filename templates
+  //! (e.g., directories on different drives), every record goes to the
+  //! directory expected to finish writing it first, judging by its measured
+  //! write bandwidth, the bytes currently in flight to it, and its free space.
+  //! Large memory buffers are striped across all the directories, in
+  //! proportion to their bandwidth, and the stripes are written concurrently.
   class FileStorage: public ExternalStorage
   {
+    public:
+      //! Statistics for each filename template (device)
+      struct DeviceStats
+      {
+        std::string     filename_template;
+        size_t          bytes_written   = 0;
+        size_t          bytes_read      = 0;
+        double          write_time      = 0;    // seconds
+        double          read_time       = 0;    // seconds
+        size_t          outstanding     = 0;    // bytes being written right now
+        size_t          current_size    = 0;    // bytes stored
+        size_t          files           = 0;    // files written
+
+        double          write_bandwidth() const     { return write_time > 0 ? static_cast<double>(bytes_written) / write_time : 0; }  // bytes/second
+        double          read_bandwidth() const      { return read_time  > 0 ? static_cast<double>(bytes_read)    / read_time  : 0; }  // bytes/second
+      };
+
     private:
-      struct FileRecord
+      struct FilePiece
       {
-        size_t          size;
         std::string     name;
+        size_t          size;
+        size_t          device;
+      };
+
+      struct FileRecord
+      {
+        size_t                  size;
+        std::vector<FilePiece>  pieces;
       };
 
+      using Clock = std::chrono::steady_clock;
+
     public:
                     FileStorage(const std::string& filename_template = "/tmp/DIY.XXXXXX"):
-                      filename_templates_(1, filename_template),
-                      count_(0), current_size_(0), max_size_(0)         {}
+                      FileStorage(std::vector<std::string>(1, filename_template))   {}
 
                     FileStorage(const std::vector<std::string>& filename_templates):
-                      filename_templates_(filename_templates),
-                      count_(0), current_size_(0), max_size_(0)         {}
+                      count_(0), current_size_(0), max_size_(0)
+      {
+        auto devices = devices_.access();
+        for (auto& filename_template : filename_templates)
+        {
+          devices->emplace_back();
+          devices->back().filename_template = filename_template;
+        }
+      }
 
       virtual int   put(MemoryBuffer& bb) override
       {
-        auto log = get_logger();
-        std::string     filename;
-        int fh = open_random(filename);
+        size_t sz = bb.buffer.size();
+        get_logger()->debug("FileStorage::put(): buffer size: {}", sz);
 
-        log->debug("FileStorage::put(): {}; buffer size: {}", filename, bb.size());
+        FileRecord fr { sz, {} };
+        std::vector<size_t> sizes;
+        std::vector<size_t> devices = reserve_devices(sz, sizes);
 
-        size_t sz = bb.buffer.size();
-#if defined(_WIN32)
-        using r_type = int;
-        r_type written = _write(fh, &bb.buffer[0], static_cast<unsigned int>(sz));
-#else
-        using r_type = ssize_t;
-        r_type written = write(fh, &bb.buffer[0], sz);
-#endif
-        if (written < static_cast<r_type>(sz) || written == r_type(-1))
-          log->warn("Could not write the full buffer to {}: written = {}; size = {}", filename, written, sz);
-        io::utils::close(fh);
-        bb.wipe();
+        std::vector<thread> writers;
+        fr.pieces.resize(devices.size());
+        size_t offset = 0;
+        for (size_t i = 0; i < devices.size(); ++i)
+        {
+          const char* data = bb.buffer.data() + offset;
+          if (i + 1 < devices.size())
+            writers.emplace_back([this,data,&sizes,&devices,&fr,i]() { write_piece(data, sizes[i], devices[i], fr.pieces[i]); });
+          else
+            write_piece(data, sizes[i], devices[i], fr.pieces[i]);     // last piece on this thread
+          offset += sizes[i];
+        }
+        for (auto& t : writers)
+          t.join();
 
-#if 0       // double-check the written file size: only for extreme debugging
-        FILE* fp = fopen(filename.c_str(), "r");
-        fseek(fp, 0L, SEEK_END);
-        int fsz = ftell(fp);
-        if (fsz != sz)
-            log->warn("file size doesn't match the buffer size, {} vs {}", fsz, sz);
-        fclose(fp);
-#endif
+        bb.wipe();
 
-        return make_file_record(filename, sz);
+        return make_file_record(std::move(fr));
       }
 
       virtual int    put(const void* x, detail::Save save) override
       {
-        std::string     filename;
-        int fh = open_random(filename);
-#if defined(_WIN32)
-        detail::FileBuffer fb(_fdopen(fh, "wb"));
-#else
-        detail::FileBuffer fb(fdopen(fh, "w"));
-#endif
+        // the size is not known in advance, so such records are not striped
+        std::vector<size_t> sizes;
+        size_t device = reserve_devices(0, sizes)[0];
+
+        FilePiece piece;
+        piece.device = device;
+        piece.name   = filename_template(device);
+        int fh = io::utils::mkstemp(piece.name);
+
+        auto start = Clock::now();
+        detail::FileBuffer fb(fh, detail::FileBuffer::Mode::write);
         save(x, fb);
-        size_t sz = fb.size();
-        fclose(fb.file);
-        io::utils::sync(fh);
+        fb.close();
+        piece.size = fb.size();
+        record_write(piece, 0, Clock::now() - start);
 
-        return make_file_record(filename, sz);
+        return make_file_record(FileRecord { piece.size, { piece } });
       }
 
       virtual void   get(int i, MemoryBuffer& bb, size_t extra) override
       {
         FileRecord fr = extract_file_record(i);
 
-        get_logger()->debug("FileStorage::get(): {}", fr.name);
+        get_logger()->debug("FileStorage::get(): {} pieces", fr.pieces.size());
 
         bb.buffer.reserve(fr.size + extra);
         bb.buffer.resize(fr.size);
-#if defined(_WIN32)
-        int fh = -1;
-        _sopen_s(&fh, fr.name.c_str(), _O_RDONLY | _O_BINARY, _SH_DENYNO, _S_IREAD);
-        _read(fh, &bb.buffer[0], static_cast<unsigned int>(fr.size));
-#else
-        int fh = open(fr.name.c_str(), O_RDONLY | O_SYNC, 0600);
-        auto n = read(fh, &bb.buffer[0], fr.size);
-        DIY_UNUSED(n);
-#endif
-        io::utils::close(fh);
+
+        std::vector<thread> readers;
+        size_t offset = 0;
+        for (size_t j = 0; j < fr.pieces.size(); ++j)
+        {
+          char* data = bb.buffer.data() + offset;
+          if (j + 1 < fr.pieces.size())
+            readers.emplace_back([this,data,&fr,j]() { read_piece(data, fr.pieces[j]); });
+          else
+            read_piece(data, fr.pieces[j]);
+          offset += fr.pieces[j].size;
+        }
+        for (auto& t : readers)
+          t.join();
+
         remove_file(fr);
       }
 
       virtual void   get(int i, void* x, detail::Load load) override
       {
         FileRecord fr = extract_file_record(i);
+        const FilePiece& piece = fr.pieces[0];
 
-        //int fh = open(fr.name.c_str(), O_RDONLY | O_SYNC, 0600);
-#if defined(_WIN32)
-        int fh = -1;
-        _sopen_s(&fh, fr.name.c_str(), _O_RDONLY | _O_BINARY, _SH_DENYNO, _S_IREAD);
-        detail::FileBuffer fb(_fdopen(fh, "rb"));
-#else
-        int fh = open(fr.name.c_str(), O_RDONLY, 0600);
-        detail::FileBuffer fb(fdopen(fh, "r"));
-#endif
+        auto start = Clock::now();
+        detail::FileBuffer fb(piece.name, detail::FileBuffer::Mode::read);
         load(x, fb);
-        fclose(fb.file);
+        fb.close();
+        record_read(piece, Clock::now() - start);
 
         remove_file(fr);
       }
 
       virtual void  destroy(int i) override
       {
-        FileRecord      fr;
-        {
-          CriticalMapAccessor accessor = filenames_.access();
-          fr = (*accessor)[i];
-          accessor->erase(i);
-        }
-        io::utils::remove(fr.name);
-        (*current_size_.access()) -= fr.size;
+        remove_file(extract_file_record(i));
       }
 
+      //! the pieces are written straight to a file, without buffering
+      virtual std::unique_ptr<Writer>
+                    writer(size_t) override     { return std::unique_ptr<Writer>(new FileWriter(this)); }
+
       int           count() const               { return (*count_.const_access()); }
       size_t        current_size() const        { return (*current_size_.const_access()); }
       size_t        max_size() const            { return (*max_size_.const_access()); }
 
+      //! records larger than this are striped across the filename templates
+      size_t        stripe_size() const         { return stripe_size_; }
+      void          set_stripe_size(size_t s)   { stripe_size_ = s; }
+
+      std::vector<DeviceStats>
+                    device_stats() const        { return *devices_.const_access(); }
+
                     ~FileStorage()
       {
-        for (FileRecordMap::const_iterator it =  filenames_.const_access()->begin();
-                                           it != filenames_.const_access()->end();
-                                         ++it)
-        {
-          io::utils::remove(it->second.name);
-        }
+        for (auto& x : *filenames_.const_access())
+          for (auto& piece : x.second.pieces)
+            io::utils::remove(piece.name);
       }
 
     private:
-      int           open_random(std::string& filename) const
+      struct FileWriter: public Writer
       {
-        if (filename_templates_.size() == 1)
-            filename = filename_templates_[0].c_str();
-        else
+                      FileWriter(FileStorage* storage_):
+                        storage(storage_)
+        {
+          std::vector<size_t> sizes;
+          piece.device = storage->reserve_devices(0, sizes)[0];
+          piece.size   = 0;
+          piece.name   = storage->filename_template(piece.device);
+          fh = io::utils::mkstemp(piece.name);
+        }
+
+                      ~FileWriter()
         {
-            // pick a template at random (very basic load balancing mechanism)
-            filename  = filename_templates_[static_cast<size_t>(std::rand()) % filename_templates_.size()].c_str();
+          if (fh != -1)                                 // never closed: discard the partial record
+          {
+            io::utils::close(fh);
+            io::utils::remove(piece.name);
+          }
         }
-        int fh = diy::io::utils::mkstemp(filename);
-        return fh;
+
+        void          write(const char* x, size_t count) override
+        {
+          auto start = Clock::now();
+          io::utils::Segment segment { const_cast<char*>(x), count };
+          if (fh == -1 || !io::utils::writev(fh, &segment, 1))
+            get_logger()->warn("Could not write the full buffer to {}; size = {}", piece.name, count);
+          piece.size += count;
+          elapsed    += Clock::now() - start;
+        }
+
+        int           close() override
+        {
+          io::utils::close(fh);
+          fh = -1;
+          storage->record_write(piece, 0, elapsed);
+          return storage->make_file_record(FileRecord { piece.size, { piece } });
+        }
+
+        FileStorage*    storage;
+        FilePiece       piece;
+        int             fh;
+        Clock::duration elapsed = Clock::duration::zero();
+      };
+
+      std::string   filename_template(size_t device) const  { return devices_.const_access()->at(device).filename_template; }
+
+      // choose the devices for a record of size sz and reserve the bandwidth;
+      // sizes is filled with the size of the piece for each device
+      std::vector<size_t>
+                    reserve_devices(size_t sz, std::vector<size_t>& sizes)
+      {
+        auto devices = devices_.access();
+        size_t n = devices->size();
+
+        // devices with unmeasured bandwidth are assumed to be as fast as the fastest one, so that they get tried
+        double fastest = 0;
+        for (auto& d : *devices)
+          fastest = (std::max)(fastest, d.write_bandwidth());
+        if (fastest == 0)
+          fastest = 1;
+        auto bandwidth = [fastest](const DeviceStats& d) { double bw = d.write_bandwidth(); return bw > 0 ? bw : fastest; };
+
+        std::vector<size_t> free(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+          std::string path, name;
+          io::utils::detail::splitpath((*devices)[i].filename_template, path, name);
+          free[i] = n > 1 ? io::utils::free_space(path) : (std::numeric_limits<size_t>::max)();
+        }
+
+        std::vector<size_t> result;
+        sizes.clear();
+
+        if (n > 1 && sz >= stripe_size_)
+        {
+          // stripe across the devices with enough free space, in proportion to their bandwidth
+          double total = 0;
+          for (size_t i = 0; i < n; ++i)
+            if (free[i] >= sz / n)
+            {
+              result.push_back(i);
+              total += bandwidth((*devices)[i]);
+            }
+
+          size_t assigned = 0;
+          for (size_t j = 0; j < result.size(); ++j)
+          {
+            size_t piece = static_cast<size_t>(static_cast<double>(sz) * bandwidth((*devices)[result[j]]) / total);
+            piece -= piece % 4096;                                          // page-aligned pieces
+            if (j + 1 == result.size())
+              piece = sz - assigned;
+            sizes.push_back(piece);
+            assigned += piece;
+          }
+        }
+
+        if (result.empty())
+        {
+          // pick the device expected to finish first; break ties by the number of files
+          size_t best = n;
+          double best_eta = 0;
+          for (size_t i = 0; i < n; ++i)
+          {
+            const DeviceStats& d = (*devices)[i];
+            if (free[i] < sz)
+              continue;
+            double eta = static_cast<double>(d.outstanding + sz) / bandwidth(d);
+            if (best == n || eta < best_eta || (eta == best_eta && d.files < (*devices)[best].files))
+            {
+              best = i;
+              best_eta = eta;
+            }
+          }
+          if (best == n)        // no device has enough space; try the one with most space anyway
+            best = static_cast<size_t>(std::max_element(free.begin(), free.end()) - free.begin());
+
+          result.push_back(best);
+          sizes.push_back(sz);
+        }
+
+        for (size_t j = 0; j < result.size(); ++j)
+          (*devices)[result[j]].outstanding += sizes[j];
+
+        return result;
+      }
+
+      void          write_piece(const char* data, size_t sz, size_t device, FilePiece& piece)
+      {
+        piece.device = device;
+        piece.size   = sz;
+        piece.name   = filename_template(device);
+        int fh = io::utils::mkstemp(piece.name);
+
+        auto start = Clock::now();
+        io::utils::Segment segment { const_cast<char*>(data), sz };
+        if (fh == -1 || !io::utils::writev(fh, &segment, 1))
+          get_logger()->warn("Could not write the full buffer to {}; size = {}", piece.name, sz);
+        io::utils::close(fh);
+        record_write(piece, sz, Clock::now() - start);
+      }
+
+      void          read_piece(char* data, const FilePiece& piece)
+      {
+        auto start = Clock::now();
+#if defined(_WIN32)
+        int fh = -1;
+        _sopen_s(&fh, piece.name.c_str(), _O_RDONLY | _O_BINARY, _SH_DENYNO, _S_IREAD);
+#else
+        int fh = open(piece.name.c_str(), O_RDONLY);
+#endif
+        io::utils::Segment segment { data, piece.size };
+        if (fh == -1 || io::utils::preadv(fh, &segment, 1, 0) != piece.size)
+          get_logger()->warn("Could not read the full buffer from {}; size = {}", piece.name, piece.size);
+#if defined(_WIN32)
+        _close(fh);
+#else
+        ::close(fh);
+#endif
+        record_read(piece, Clock::now() - start);
+      }
+
+      void          record_write(const FilePiece& piece, size_t reserved, Clock::duration elapsed)
+      {
+        auto devices = devices_.access();
+        DeviceStats& d = (*devices)[piece.device];
+        d.outstanding   -= reserved;
+        d.bytes_written += piece.size;
+        d.write_time    += std::chrono::duration<double>(elapsed).count();
+        d.current_size  += piece.size;
+        ++d.files;
       }
 
-      int           make_file_record(const std::string& filename, size_t sz)
+      void          record_read(const FilePiece& piece, Clock::duration elapsed)
+      {
+        auto devices = devices_.access();
+        DeviceStats& d = (*devices)[piece.device];
+        d.bytes_read += piece.size;
+        d.read_time  += std::chrono::duration<double>(elapsed).count();
+      }
+
+      int           make_file_record(FileRecord&& fr)
       {
         int res = (*count_.access())++;
-        FileRecord  fr = { sz, filename };
-        (*filenames_.access())[res] = fr;
+        size_t sz = fr.size;
+        (*filenames_.access())[res] = std::move(fr);
 
         // keep track of sizes
         critical_resource<size_t>::accessor     cur = current_size_.access();
@@ -230,14 +508,18 @@ namespace diy
       FileRecord    extract_file_record(int i)
       {
         CriticalMapAccessor accessor = filenames_.access();
-        FileRecord fr = (*accessor)[i];
+        FileRecord fr = std::move((*accessor)[i]);
         accessor->erase(i);
         return fr;
       }
 
       void          remove_file(const FileRecord& fr)
       {
-        io::utils::remove(fr.name);
+        for (auto& piece : fr.pieces)
+        {
+          io::utils::remove(piece.name);
+          (*devices_.access())[piece.device].current_size -= piece.size;
+        }
         (*current_size_.access()) -= fr.size;
       }
 
@@ -247,11 +529,443 @@ namespace diy
       typedef           CriticalMap::accessor                       CriticalMapAccessor;
 
     private:
-      std::vector<std::string>      filename_templates_;
-      CriticalMap                   filenames_;
-      critical_resource<int>        count_;
-      critical_resource<size_t>     current_size_, max_size_;
+      critical_resource<std::vector<DeviceStats>>   devices_;
+      size_t                                        stripe_size_ = 64*1024*1024;
+      CriticalMap                                   filenames_;
+      critical_resource<int>                        count_;
+      critical_resource<size_t>                     current_size_, max_size_;
+  };
+
+  //! Keeps blocks and queues in memory, compressed with a pluggable codec.
+  //! Once the compressed data exceeds `memory_limit`, new records are passed
+  //! (still compressed) to the `fallback` storage, e.g., a FileStorage.
+  class CompressedStorage: public ExternalStorage
+  {
+    public:
+      struct Stats
+      {
+        size_t      raw_bytes           = 0;    // bytes put, before compression
+        size_t      compressed_bytes    = 0;    // bytes put, after compression
+        size_t      records             = 0;
+        size_t      spilled_records     = 0;    // records passed to the fallback storage
+        size_t      spilled_bytes       = 0;
+        double      compress_time       = 0;    // seconds
+        double      decompress_time     = 0;    // seconds
+        size_t      decompressed_bytes  = 0;
+
+        double      ratio() const                   { return compressed_bytes ? static_cast<double>(raw_bytes) / static_cast<double>(compressed_bytes) : 1.; }
+        double      compress_throughput() const     { return compress_time > 0 ? static_cast<double>(raw_bytes) / compress_time : 0; }           // bytes/second
+        double      decompress_throughput() const   { return decompress_time > 0 ? static_cast<double>(decompressed_bytes) / decompress_time : 0; }
+      };
+
+    private:
+      struct Record
+      {
+        size_t                      size = 0;           // uncompressed size
+        bool                        compressed = false; // false, if compression didn't help
+        std::vector<char>           data;
+        std::vector<BinaryBlob>     blobs;              // kept as is
+        int                         external = -1;      // record id in the fallback storage
+      };
+
+    public:
+                    CompressedStorage(size_t                    memory_limit = (std::numeric_limits<size_t>::max)(),
+                                      ExternalStorage*          fallback     = 0,
+                                      std::shared_ptr<Codec>    codec        = default_codec()):
+                      memory_limit_(memory_limit), fallback_(fallback), codec_(codec),
+                      count_(0), current_size_(0), max_size_(0)         {}
+
+      virtual int   put(MemoryBuffer& bb) override
+      {
+        // like FileStorage, leave the blobs in bb
+        Record r = compress(bb.buffer.data(), bb.size());
+        bb.wipe();
+        return add(std::move(r));
+      }
+
+      virtual int   put(const void* x, detail::Save save) override
+      {
+        MemoryBuffer bb;
+        save(x, bb);
+        Record r = compress(bb.buffer.data(), bb.size());
+        r.blobs.swap(bb.blobs);
+        return add(std::move(r));
+      }
+
+      virtual void  get(int i, MemoryBuffer& bb, size_t extra) override
+      {
+        Record r = extract(i);
+        bb.buffer.reserve(r.size + extra);
+        bb.buffer.resize(r.size);
+        decompress(r, bb.buffer.data());
+        bb.reset();
+      }
+
+      virtual void  get(int i, void* x, detail::Load load) override
+      {
+        Record r = extract(i);
+        MemoryBuffer bb;
+        bb.buffer.resize(r.size);
+        decompress(r, bb.buffer.data());
+        bb.blobs.swap(r.blobs);
+        load(x, bb);
+      }
+
+      virtual void  destroy(int i) override
+      {
+        Record r;
+        {
+          auto accessor = records_.access();
+          r = std::move((*accessor)[i]);
+          accessor->erase(i);
+        }
+        if (r.external != -1)
+          fallback_->destroy(r.external);
+        else
+          (*current_size_.access()) -= r.data.size();
+      }
+
+      int           count() const               { return (*count_.const_access()); }
+      size_t        current_size() const        { return (*current_size_.const_access()); }     //!< compressed bytes held in memory
+      size_t        max_size() const            { return (*max_size_.const_access()); }
+      Stats         stats() const               { return (*stats_.const_access()); }
+
+      const Codec&  codec() const               { return *codec_; }
+
+    private:
+      Record        compress(const char* x, size_t sz)
+      {
+        Record r;
+        r.size = sz;
+
+        auto start = std::chrono::steady_clock::now();
+        codec_->compress(x, sz, r.data);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (r.data.size() < sz)
+          r.compressed = true;
+        else
+          r.data.assign(x, x + sz);     // incompressible: store as is
+        r.data.shrink_to_fit();
+
+        auto stats = stats_.access();
+        stats->raw_bytes        += sz;
+        stats->compressed_bytes += r.data.size();
+        stats->compress_time    += elapsed;
+        ++stats->records;
+
+        return r;
+      }
+
+      void          decompress(const Record& r, char* out)
+      {
+        if (!r.compressed)
+        {
+          std::copy(r.data.begin(), r.data.end(), out);
+          return;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        codec_->decompress(r.data.data(), r.data.size(), out, r.size);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        auto stats = stats_.access();
+        stats->decompress_time    += elapsed;
+        stats->decompressed_bytes += r.size;
+      }
+
+      int           add(Record&& r)
+      {
+        size_t sz = r.data.size();
+        bool spill = false;
+        {
+          critical_resource<size_t>::accessor     cur = current_size_.access();
+          if (fallback_ && *cur + sz > memory_limit_)
+            spill = true;
+          else
+          {
+            *cur += sz;
+            critical_resource<size_t>::accessor     max = max_size_.access();
+            if (*cur > *max)
+                *max = *cur;
+          }
+        }
+
+        if (spill)
+        {
+          r.external = fallback_->put(&r, &save_record);
+          r.data = std::vector<char>();
+          r.blobs.clear();
+
+          auto stats = stats_.access();
+          ++stats->spilled_records;
+          stats->spilled_bytes += sz;
+        }
+
+        int res = (*count_.access())++;
+        (*records_.access())[res] = std::move(r);
+        return res;
+      }
+
+      Record        extract(int i)
+      {
+        Record r;
+        {
+          auto accessor = records_.access();
+          r = std::move((*accessor)[i]);
+          accessor->erase(i);
+        }
+
+        if (r.external != -1)
+        {
+          int external = r.external;
+          fallback_->get(external, &r, &load_record);
+        } else
+          (*current_size_.access()) -= r.data.size();
+
+        return r;
+      }
+
+      static void   save_record(const void* x, BinaryBuffer& bb)
+      {
+        Record& r = *const_cast<Record*>(static_cast<const Record*>(x));
+        diy::save(bb, r.size);
+        diy::save(bb, r.compressed);
+        diy::save(bb, r.data);
+        diy::save(bb, r.blobs.size());
+        for (BinaryBlob& blob : r.blobs)        // hand over the ownership of the blobs
+        {
+          auto deleter = blob.pointer.get_deleter();
+          bb.save_binary_blob(blob.pointer.release(), blob.size, deleter);
+        }
+      }
+
+      static void   load_record(void* x, BinaryBuffer& bb)
+      {
+        Record& r = *static_cast<Record*>(x);
+        diy::load(bb, r.size);
+        diy::load(bb, r.compressed);
+        diy::load(bb, r.data);
+        size_t nblobs;
+        diy::load(bb, nblobs);
+        r.blobs.clear();
+        for (size_t i = 0; i < nblobs; ++i)
+          r.blobs.emplace_back(bb.load_binary_blob());
+        r.external = -1;
+      }
+
+    private:
+      size_t                                        memory_limit_;
+      ExternalStorage*                              fallback_;
+      std::shared_ptr<Codec>                        codec_;
+
+      critical_resource<std::map<int, Record>>      records_;
+      critical_resource<int>                        count_;
+      critical_resource<size_t>                     current_size_, max_size_;
+      critical_resource<Stats>                      stats_;
   };
 }
 
+int
+diy::detail::FileBuffer::
+open(const std::string& filename, Mode mode_)
+{
+  int fh = -1;
+#if defined(_WIN32)
+  if (mode_ == Mode::write)
+    _sopen_s(&fh, filename.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _SH_DENYNO, _S_IREAD | _S_IWRITE);
+  else
+    _sopen_s(&fh, filename.c_str(), _O_RDONLY | _O_BINARY, _SH_DENYNO, _S_IREAD);
+#else
+  if (mode_ == Mode::write)
+    fh = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  else
+    fh = ::open(filename.c_str(), O_RDONLY);
+#endif
+  if (fh == -1)
+    throw std::runtime_error("Cannot open file: " + filename);
+  return fh;
+}
+
+void
+diy::detail::FileBuffer::
+init()
+{
+  if (mode == Mode::write)
+  {
+    buffer.reset(new char[capacity]);
+    return;
+  }
+
+  // look for the blob index at the end of the file
+  data_end = io::utils::file_size(fd);
+  uint64_t footer[2];         // number of blobs, magic
+  if (data_end >= sizeof(footer))
+  {
+    read_at(reinterpret_cast<char*>(footer), sizeof(footer), data_end - sizeof(footer));
+    size_t index_size = static_cast<size_t>(footer[0]) * sizeof(BlobRecord);
+    if (footer[1] == magic() && sizeof(footer) + index_size <= data_end)
+    {
+      data_end -= sizeof(footer) + index_size;
+      index.resize(static_cast<size_t>(footer[0]));
+      if (!index.empty())
+        read_at(reinterpret_cast<char*>(&index[0]), index_size, data_end);
+    }
+  }
+
+  capacity = (std::min)(capacity, data_end);
+  buffer.reset(new char[capacity]);
+}
+
+void
+diy::detail::FileBuffer::
+save_binary(const char* x, size_t count)
+{
+  if (mode != Mode::write)
+    throw std::runtime_error("Cannot save to a FileBuffer opened for reading");
+
+  if (used + count <= capacity)
+  {
+    std::copy_n(x, count, &buffer[used]);
+    used += count;
+  } else
+    flush(x, count);        // write the pending data and x together, bypassing the buffer
+}
+
+void
+diy::detail::FileBuffer::
+save_binary_blob(const char* x, size_t count, Blob::Deleter deleter)
+{
+  index.emplace_back(BlobRecord { file_pos + used, count });
+  save_binary(x, count);
+  deleter(x);               // the data is in the file now
+}
+
+void
+diy::detail::FileBuffer::
+flush(const char* x, size_t count)
+{
+  Segment segments[2] = { { buffer.get(), used }, { const_cast<char*>(x), count } };
+  if (!io::utils::writev(fd, segments, count ? 2 : 1))
+    throw std::runtime_error("Could not write to a FileBuffer");
+  file_pos += used + count;
+  used = 0;
+}
+
+void
+diy::detail::FileBuffer::
+close()
+{
+  if (fd == -1)
+    return;
+
+  int fh = fd;
+  try
+  {
+    if (mode == Mode::write)
+    {
+      if (!index.empty())
+      {
+        uint64_t footer[2] = { index.size(), magic() };
+        save_binary(reinterpret_cast<const char*>(&index[0]), index.size() * sizeof(BlobRecord));
+        save_binary(reinterpret_cast<const char*>(footer), sizeof(footer));
+      }
+      if (used)
+        flush();
+    }
+  } catch (...)
+  {
+    fd = -1;
+    io::utils::close(fh);
+    throw;
+  }
+
+  fd = -1;
+#if defined(_WIN32)
+  _close(fh);
+#else
+  ::close(fh);
+#endif
+}
+
+void
+diy::detail::FileBuffer::
+load_binary(char* x, size_t count)
+{
+  while (count > 0)
+  {
+    if (cursor == used)
+    {
+      size_t direct = fill(x, count);
+      x     += direct;
+      count -= direct;
+    }
+
+    size_t n = (std::min)(count, used - cursor);
+    std::copy_n(&buffer[cursor], n, x);
+    cursor += n;
+    x      += n;
+    count  -= n;
+  }
+}
+
+// refill the read-ahead buffer, skipping over the blobs; if the request is
+// larger than the buffer, read its front directly into x, returning the
+// number of bytes so delivered
+size_t
+diy::detail::FileBuffer::
+fill(char* x, size_t count)
+{
+  for (; next_blob < index.size() && index[next_blob].offset <= file_pos; ++next_blob)
+    file_pos = (std::max)(file_pos, static_cast<size_t>(index[next_blob].offset + index[next_blob].size));
+
+  size_t segment_end = next_blob < index.size() ? static_cast<size_t>(index[next_blob].offset) : data_end;
+  if (segment_end <= file_pos)
+    throw std::runtime_error("Cannot read past the end of a FileBuffer");
+  size_t available = segment_end - file_pos;
+
+  size_t direct = count >= capacity ? (std::min)(count, available) : 0;
+  size_t ahead  = (std::min)(capacity, available - direct);
+
+  Segment segments[2] = { { x, direct }, { buffer.get(), ahead } };
+  if (io::utils::preadv(fd, direct ? segments : segments + 1, direct ? 2 : 1, file_pos) != direct + ahead)
+    throw std::runtime_error("Could not read from a FileBuffer");
+
+  file_pos += direct + ahead;
+  used      = ahead;
+  cursor    = 0;
+  return direct;
+}
+
+void
+diy::detail::FileBuffer::
+load_binary_back(char* x, size_t count)
+{
+  tail += count;
+  read_at(x, count, data_end - tail);
+}
+
+diy::BinaryBlob
+diy::detail::FileBuffer::
+load_binary_blob()
+{
+  if (blob_position >= index.size())
+    throw std::runtime_error("No more binary blobs in a FileBuffer");
+
+  const BlobRecord& record = index[blob_position++];
+  size_t count = static_cast<size_t>(record.size);
+  char* x = new char[count];
+  read_at(x, count, static_cast<size_t>(record.offset));
+  return Blob { Blob::Pointer { x, [](const char* p) { delete[] p; } }, count };
+}
+
+void
+diy::detail::FileBuffer::
+read_at(char* x, size_t count, size_t offset)
+{
+  Segment segment { x, count };
+  if (io::utils::preadv(fd, &segment, 1, offset) != count)
+    throw std::runtime_error("Could not read from a FileBuffer");
+}
+
 #endif
@@ -155,7 +155,7 @@ class fast_mutex {
         "movl $1,%%eax\n\t"
         "xchg %%eax,%0\n\t"
         "movl %%eax,%1\n\t"
-        : "=m" (mLock), "=m" (oldLock)
+        : "+m" (mLock), "=m" (oldLock)
         :
         : "%eax", "memory"
       );
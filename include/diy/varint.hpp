@@ -0,0 +1,120 @@
+#ifndef DIY_VARINT_HPP
+#define DIY_VARINT_HPP
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "serialization.hpp"
+
+namespace diy
+{
+  //! Variable-length integers: 7 bits per byte, the high bit marks that more bytes follow.
+  //! Signed values are zig-zag encoded first, so that small magnitudes of either sign stay short.
+  namespace varint
+  {
+    static const size_t max_bytes = 10;         // for 64 bits
+
+    inline uint64_t     zigzag(int64_t x)                           { return (static_cast<uint64_t>(x) << 1) ^ static_cast<uint64_t>(x >> 63); }
+    inline int64_t      unzigzag(uint64_t x)                        { return static_cast<int64_t>(x >> 1) ^ -static_cast<int64_t>(x & 1); }
+
+    //! Encode x into p (at least max_bytes long); returns the number of bytes written.
+    inline size_t       encode(uint64_t x, char* p)
+    {
+      size_t n = 0;
+      while (x >= 0x80)
+      {
+        p[n++] = static_cast<char>((x & 0x7f) | 0x80);
+        x >>= 7;
+      }
+      p[n++] = static_cast<char>(x);
+      return n;
+    }
+
+    //! Decode a value starting at p and advance p past it.
+    inline uint64_t     decode(const char*& p, const char* end)
+    {
+      uint64_t x = 0;
+      for (unsigned shift = 0; shift < 64; shift += 7)
+      {
+        if (p == end)
+          throw std::runtime_error("Truncated varint");
+        unsigned char byte = static_cast<unsigned char>(*p++);
+        x |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+          return x;
+      }
+      throw std::runtime_error("Malformed varint");
+    }
+
+    inline void         save(BinaryBuffer& bb, uint64_t x)          { char p[max_bytes]; bb.save_binary(p, encode(x, p)); }
+
+    inline uint64_t     load(BinaryBuffer& bb)
+    {
+      char p[max_bytes];
+      for (size_t n = 0; n < max_bytes; ++n)
+      {
+        bb.load_binary(p + n, 1);
+        if (!(p[n] & 0x80))
+        {
+          const char* q = p;
+          return decode(q, p + n + 1);
+        }
+      }
+      throw std::runtime_error("Malformed varint");
+    }
+
+    inline void         save_signed(BinaryBuffer& bb, int64_t x)    { save(bb, zigzag(x)); }
+    inline int64_t      load_signed(BinaryBuffer& bb)               { return unzigzag(load(bb)); }
+
+    /**
+     * \brief Save a sequence of integers: their count, the number of encoded bytes, and the zig-zag varints
+     * of the values, or of the differences between consecutive values if `delta` is set (best for sorted
+     * sequences, like gid lists). The bytes go into the buffer with a single call.
+     */
+    template<class Int, class A>
+    void                save_sequence(BinaryBuffer& bb, const std::vector<Int,A>& x, bool delta = true)
+    {
+      std::vector<char> bytes(x.size() * max_bytes);
+      size_t  n    = 0;
+      int64_t prev = 0;
+      for (Int y : x)
+      {
+        int64_t z = static_cast<int64_t>(y);
+        n += encode(zigzag(delta ? z - prev : z), &bytes[n]);
+        prev = z;
+      }
+
+      save(bb, x.size());
+      save(bb, n);
+      if (n > 0)
+        bb.save_binary(&bytes[0], n);
+    }
+
+    //! Load a sequence saved with `save_sequence()`, with the same `delta`.
+    template<class Int, class A>
+    void                load_sequence(BinaryBuffer& bb, std::vector<Int,A>& x, bool delta = true)
+    {
+      size_t count = static_cast<size_t>(load(bb));
+      size_t n     = static_cast<size_t>(load(bb));
+      std::vector<char> bytes(n);
+      if (n > 0)
+        bb.load_binary(&bytes[0], n);
+
+      x.resize(count);
+      const char* p   = bytes.data();
+      const char* end = p + n;
+      int64_t     prev = 0;
+      for (size_t i = 0; i < count; ++i)
+      {
+        int64_t z = unzigzag(decode(p, end));
+        if (delta)
+          z += prev;
+        x[i] = static_cast<Int>(z);
+        prev = z;
+      }
+    }
+  }
+}
+
+#endif
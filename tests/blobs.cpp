@@ -6,6 +6,7 @@
 #include <diy/master.hpp>
 #include <diy/assigner.hpp>
 #include <diy/serialization.hpp>
+#include <diy/storage.hpp>
 
 #include "opts.h"
 
@@ -159,6 +160,368 @@ TEST_CASE_METHOD(BlobsFixture, "Send/Recv Test", "[blobs]")
   master.foreach(&verify);
 }
 
+struct Record
+{
+  int     gid;
+  double  value;
+};
+
+TEST_CASE_METHOD(BlobsFixture, "Dequeue views", "[blobs]")
+{
+  diy::Master master(world, threads, -1, &create_block, &destroy_block);
+  diy::RoundRobinAssigner assigner(world.size(), nblocks);
+
+  std::vector<int> gids;
+  assigner.local_gids(world.rank(), gids);
+  for (int gid : gids)
+  {
+    diy::Link* link = new diy::Link;
+    diy::BlockID neighbor;
+    neighbor.gid  = (gid + 1) % nblocks;
+    neighbor.proc = assigner.rank(neighbor.gid);
+    link->add_neighbor(neighbor);
+    master.add(gid, create_block(), link);
+  }
+
+  master.foreach([](Block*, const diy::Master::ProxyWithLink& cp)
+  {
+    diy::BlockID to = cp.link()->target(0);
+    std::vector<double> values(100, cp.gid() + 0.5);
+    cp.enqueue(to, values);
+    for (int i = 0; i < 3; ++i)
+      cp.enqueue(to, Record { cp.gid(), double(i) });
+    cp.enqueue(to, 'x');
+    cp.enqueue(to, values.data(), values.size());
+  });
+  master.exchange();
+
+  master.foreach([](Block*, const diy::Master::ProxyWithLink& cp)
+  {
+    for (auto& in : *cp.incoming())
+    {
+      int from = in.first;
+      if (!cp.incoming(from).size())
+        continue;
+
+      diy::MemoryBuffer& bb = cp.incoming(from);
+
+      diy::ArrayView<double> values = cp.dequeue_view<double>(from);
+      REQUIRE(values.size() == 100);
+      CHECK(!values.copied());
+      CHECK(values.data() == reinterpret_cast<const double*>(&bb.buffer[sizeof(size_t)]));
+      for (double x : values)
+        CHECK(x == from + 0.5);
+
+      double i = 0;
+      for (auto& r : cp.dequeue_view<Record>(from, 3))
+      {
+        CHECK(r.gid == from);
+        CHECK(r.value == i++);
+      }
+
+      char c;
+      cp.dequeue(from, c);
+      CHECK(c == 'x');
+
+      // misaligned after the char, so the view holds a copy
+      diy::ArrayView<double> shifted = cp.dequeue_view<double>(from, 100);
+      CHECK(shifted.copied());
+      CHECK(std::vector<double>(shifted.begin(), shifted.end()) == std::vector<double>(100, from + 0.5));
+
+      CHECK_THROWS(cp.dequeue_view<double>(from, 1));
+    }
+  });
+}
+
+TEST_CASE_METHOD(BlobsFixture, "Multicast", "[blobs]")
+{
+  // keep one block in memory, so that the queues of the others go out of core
+  diy::FileStorage storage("./DIY.XXXXXX");
+  diy::Master master(world, threads, 1, &create_block, &destroy_block, &storage,
+                     [](const void* b, diy::BinaryBuffer& bb) { diy::save(bb, static_cast<const Block*>(b)->buffer); },
+                     [](void* b, diy::BinaryBuffer& bb)       { diy::load(bb, static_cast<Block*>(b)->buffer); });
+
+  int n = 3 * world.size();
+  diy::RoundRobinAssigner assigner(world.size(), n);
+
+  // everybody is a neighbor
+  std::vector<int> gids;
+  assigner.local_gids(world.rank(), gids);
+  for (int gid : gids)
+  {
+    diy::Link* link = new diy::Link;
+    for (int i = 0; i < n; ++i)
+      if (i != gid)
+        link->add_neighbor(diy::BlockID { i, assigner.rank(i) });
+    master.add(gid, create_block(), link);
+  }
+
+  master.foreach([](Block*, const diy::Master::ProxyWithLink& cp)
+  {
+    std::vector<std::int64_t> large(10000, cp.gid());
+    cp.enqueue_multicast(cp.link()->neighbors(), large);
+    cp.enqueue_multicast(cp.link()->neighbors(), std::string("small"));
+    for (auto& nbr : cp.link()->neighbors())
+      cp.enqueue(nbr, -cp.gid());
+  });
+  master.exchange();
+
+  master.foreach([n](Block*, const diy::Master::ProxyWithLink& cp)
+  {
+    int received = 0;
+    for (auto& in : *cp.incoming())
+    {
+      int from = in.first;
+      if (!cp.incoming(from).size())
+        continue;
+
+      std::vector<std::int64_t> large;
+      cp.dequeue_multicast(from, large);
+      CHECK(large == std::vector<std::int64_t>(10000, from));
+
+      std::string small;
+      cp.dequeue_multicast(from, small);
+      CHECK(small == "small");
+
+      int x;
+      cp.dequeue(from, x);
+      CHECK(x == -from);
+
+      ++received;
+    }
+    CHECK(received == n - 1);
+  });
+}
+
+TEST_CASE_METHOD(BlobsFixture, "Temporal deltas", "[blobs]")
+{
+  diy::Master master(world, threads, -1, &create_block, &destroy_block);
+  master.set_temporal_delta(true);
+  diy::RoundRobinAssigner assigner(world.size(), nblocks);
+
+  auto make_link = [&](int gid)
+  {
+    diy::Link* link = new diy::Link;
+    diy::BlockID neighbor;
+    neighbor.gid  = (gid + 1) % nblocks;
+    neighbor.proc = assigner.rank(neighbor.gid);
+    link->add_neighbor(neighbor);
+    return link;
+  };
+
+  std::vector<int> gids;
+  assigner.local_gids(world.rank(), gids);
+  for (int gid : gids)
+    master.add(gid, create_block(), make_link(gid));
+
+  // a slowly changing field: every step changes a few values; one step changes its size
+  auto field = [](int gid, int step)
+  {
+    std::vector<double> values(step == 3 ? 5000 : 10000, gid);
+    for (int i = 0; i <= step; ++i)
+      values[static_cast<size_t>(i * 997) % values.size()] = step + 0.5;
+    return values;
+  };
+
+  for (int step = 0; step < 7; ++step)
+  {
+    if (step == 6)
+    {
+      // the odd blocks leave, dropping the copies kept for them, and come back; their senders must start afresh
+      auto remote = [&](int gid) { return assigner.rank(gid) != world.rank(); };
+      auto records = [&](bool odd)          // payloads kept for the blocks, all of the same size
+      {
+        size_t count = 0;
+        for (int gid : gids)
+          if (odd || gid % 2 == 0)
+            count += remote((gid + 1) % nblocks) + remote((gid + nblocks - 1) % nblocks);
+        return count;
+      };
+
+      size_t memory = master.temporal_delta_memory();
+      std::vector<void*> blocks(gids.size());
+      for (size_t i = 0; i < gids.size(); ++i)
+        if (gids[i] % 2)
+          blocks[i] = master.release(gids[i]);
+      if (records(true))
+        CHECK(master.temporal_delta_memory() == memory / records(true) * records(false));
+
+      for (size_t i = 0; i < gids.size(); ++i)
+        if (gids[i] % 2)
+          master.add(gids[i], blocks[i], make_link(gids[i]));
+      master.reset_temporal_deltas();
+    }
+
+    master.foreach([&](Block*, const diy::Master::ProxyWithLink& cp)
+    {
+      cp.enqueue(cp.link()->target(0), field(cp.gid(), step));
+      cp.enqueue(cp.link()->target(0), step);
+    });
+    master.exchange();
+
+    master.foreach([&](Block*, const diy::Master::ProxyWithLink& cp)
+    {
+      for (auto& in : *cp.incoming())
+      {
+        int from = in.first;
+        if (!cp.incoming(from).size())
+          continue;
+
+        std::vector<double> values;
+        int s;
+        cp.dequeue(from, values);
+        cp.dequeue(from, s);
+        CHECK(s == step);
+        CHECK(values == field(from, step));
+      }
+    });
+  }
+
+  // the steps that keep the size of the previous one are sent as differences
+  bool remote_neighbor = false;
+  for (int gid : gids)
+    remote_neighbor |= assigner.rank((gid + 1) % nblocks) != world.rank();
+  if (remote_neighbor)
+    CHECK(master.temporal_delta_bytes_saved() > 2 * 10000 * sizeof(double));
+  else
+    CHECK(master.temporal_delta_bytes_saved() == 0);
+}
+
+TEST_CASE_METHOD(BlobsFixture, "Temporal deltas with iexchange", "[blobs]")
+{
+  diy::Master master(world, threads, -1, &create_block, &destroy_block);
+  master.set_temporal_delta(true);
+  diy::RoundRobinAssigner assigner(world.size(), nblocks);
+
+  std::vector<int> gids;
+  assigner.local_gids(world.rank(), gids);
+  for (int gid : gids)
+  {
+    diy::Link* link = new diy::Link;
+    diy::BlockID neighbor;
+    neighbor.gid  = (gid + 1) % nblocks;
+    neighbor.proc = assigner.rank(neighbor.gid);
+    link->add_neighbor(neighbor);
+    master.add(gid, create_block(), link);
+  }
+
+  auto field = [](int gid, int step)
+  {
+    std::vector<double> values(1000, gid);
+    values[static_cast<size_t>(step)] = step + 0.5;
+    return values;
+  };
+
+  auto check = [&](const diy::Master::ProxyWithLink& cp, int from, int step)
+  {
+    std::vector<double> values;
+    cp.dequeue(from, values);
+    CHECK(values == field(from, step));
+  };
+
+  // iexchange() sends plain messages between the same blocks as exchange(), which must not
+  // encode its next message against the payload sent before them
+  for (int step = 0; step < 6; ++step)
+  {
+    if (step % 3 == 2)
+    {
+      std::vector<int> sent(nblocks, 0), received(nblocks, 0);
+      master.iexchange([&](Block*, const diy::Master::ProxyWithLink& cp) -> bool
+      {
+        if (!sent[cp.gid()])
+        {
+          cp.enqueue(cp.link()->target(0), field(cp.gid(), step));
+          sent[cp.gid()] = 1;
+        }
+        for (auto& in : *cp.incoming())
+          if (cp.incoming(in.first).size())
+          {
+            check(cp, in.first, step);
+            received[cp.gid()] = 1;
+          }
+        return sent[cp.gid()] && received[cp.gid()];
+      });
+    } else
+    {
+      master.foreach([&](Block*, const diy::Master::ProxyWithLink& cp)
+      {
+        cp.enqueue(cp.link()->target(0), field(cp.gid(), step));
+      });
+      master.exchange();
+      master.foreach([&](Block*, const diy::Master::ProxyWithLink& cp)
+      {
+        for (auto& in : *cp.incoming())
+          if (cp.incoming(in.first).size())
+            check(cp, in.first, step);
+      });
+    }
+  }
+}
+
+TEST_CASE_METHOD(BlobsFixture, "Wire compression", "[blobs]")
+{
+  diy::Master master(world, threads, -1, &create_block, &destroy_block);
+  master.set_wire_compression(std::make_shared<diy::ShuffleCodec>(sizeof(float)), 1024);
+  master.set_message_chunk_size(16384);       // compressed messages are still sent in parts
+  diy::RoundRobinAssigner assigner(world.size(), nblocks);
+
+  std::vector<int> gids;
+  assigner.local_gids(world.rank(), gids);
+  for (int gid : gids)
+  {
+    diy::Link* link = new diy::Link;
+    diy::BlockID neighbor;
+    neighbor.gid  = (gid + 1) % nblocks;
+    neighbor.proc = assigner.rank(neighbor.gid);
+    link->add_neighbor(neighbor);
+    master.add(gid, create_block(), link);
+  }
+
+  auto field = [](int gid, size_t n)
+  {
+    std::vector<float> values(n);
+    for (size_t i = 0; i < n; ++i)
+      values[i] = static_cast<float>(gid) + static_cast<float>(i % 1000) * 0.25f;
+    return values;
+  };
+
+  for (size_t n : { size_t(10), size_t(100000) })
+  {
+    master.foreach([&](Block*, const diy::Master::ProxyWithLink& cp)
+    {
+      cp.enqueue(cp.link()->target(0), field(cp.gid(), n));
+    });
+    master.exchange();
+
+    master.foreach([&](Block*, const diy::Master::ProxyWithLink& cp)
+    {
+      for (auto& in : *cp.incoming())
+      {
+        int from = in.first;
+        if (!cp.incoming(from).size())
+          continue;
+
+        std::vector<float> values;
+        cp.dequeue(from, values);
+        CHECK(values == field(from, n));
+      }
+    });
+  }
+
+  // only the large messages to the other ranks are compressed
+  bool remote_neighbor = false;
+  for (int gid : gids)
+    remote_neighbor |= assigner.rank((gid + 1) % nblocks) != world.rank();
+  auto stats = master.wire_compression_stats();
+  if (remote_neighbor)
+  {
+    CHECK(stats.messages > 0);
+    CHECK(stats.ratio() > 4);
+    CHECK(stats.compress_time > 0);
+  } else
+    CHECK(stats.messages == 0);
+}
+
 int main(int argc, char* argv[])
 {
   diy::mpi::environment env(argc, argv);
@@ -26,6 +26,9 @@ int main(int argc, char* argv[])
     float                     noise_factor = 0.0;                       // multiplier for noise in predicted -> actual work
     int                       distribution = 0;                         // type of distribution for assigning work (0: uniform (default), 1: normal, 2: exponential)
     unsigned int              seed = 0;                                 // seed for random number generator (0: ignore)
+    int                       algorithm = 0;                            // balancing algorithm (0: heaviest block per proc (default), 1: lpt, 2: karmarkar-karp, 3: diffusion)
+    float                     max_migration = 1.0f;                     // fraction of the blocks allowed to move (algorithms 1-3)
+    float                     locality = 0.0f;                          // weight of the link neighbors in the choice of blocks to move
     bool                      help;
 
     using namespace opts;
@@ -38,6 +41,9 @@ int main(int argc, char* argv[])
         >> Option('n', "noise_factor",  noise_factor,   "multiplier for noise in predicted -> actual work")
         >> Option('d', "distribution",  distribution,   "distribution for assigning work (0 uniform (default), 1 normal, 2 exponential)")
         >> Option('s', "seed",          seed,           "seed for random number generator (default: 0 = ignore")
+        >> Option('a', "algorithm",     algorithm,      "balancing algorithm (0 heaviest block per proc (default), 1 lpt, 2 karmarkar-karp, 3 diffusion)")
+        >> Option('m', "max_migration", max_migration,  "fraction of the blocks allowed to move (algorithms 1-3)")
+        >> Option('l', "locality",      locality,       "weight of the link neighbors in the choice of blocks to move (default: 0)")
         ;
 
     if (!ops.parse(argc,argv) || help)
@@ -72,6 +78,7 @@ int main(int argc, char* argv[])
                        0,
                        &Block::save,
                        &Block::load);
+    master.set_balance_locality(locality);
 
     // create a regular decomposer and call its decompose function
     diy::RegularDecomposer<Bounds> decomposer(3,
@@ -141,6 +148,26 @@ int main(int argc, char* argv[])
     // dynamic assigner needs to be fully updated and sync'ed across all procs before proceeding
     world.barrier();
 
+    // heaviest process, by predicted work, which is what the balancing sees
+    auto max_proc_work = [&]()
+    {
+        diy::Work w = 0, max_w;
+        for (auto i = 0; i < master.size(); i++)
+            w += static_cast<Block*>(master.block(i))->pred_work;
+        diy::mpi::all_reduce(world, w, max_w, diy::mpi::maximum<diy::Work>());
+        return max_w;
+    };
+    diy::Work initial_max_proc_work = max_proc_work();
+
+    // link neighbors on other processes, over all the processes
+    auto remote_links = [&]()
+    {
+        size_t links = master.remote_links(), total_links;
+        diy::mpi::all_reduce(world, links, total_links, std::plus<size_t>());
+        return total_links;
+    };
+    size_t initial_remote_links = remote_links();
+
     // perform some iterative algorithm
     for (auto n = 0; n < iters; n++)
     {
@@ -162,7 +189,11 @@ int main(int argc, char* argv[])
         t0 = MPI_Wtime();
 
         // synchronous collective load balancing
-        diy::load_balance_collective(master, dynamic_assigner, &get_block_work, moved_blocks);
+        if (algorithm == 0)
+            diy::load_balance_collective(master, dynamic_assigner, &get_block_work, moved_blocks);
+        else
+            diy::load_balance_collective(master, dynamic_assigner, &get_block_work, moved_blocks,
+                                         static_cast<diy::CollectiveBalance>(algorithm - 1), max_migration);
 
         // timing
         world.barrier();
@@ -172,7 +203,7 @@ int main(int argc, char* argv[])
         int lid;
         for (auto i = 0; i < moved_blocks.size(); i++)
         {
-            if ((lid = master.lid(moved_blocks[i].move_gid) >= 0))
+            if ((lid = master.lid(moved_blocks[i].move_gid)) >= 0)
             {
                 Block* b = static_cast<Block*>(master.block(lid));
                 moved_blocks[i].pred_work = b->pred_work;
@@ -195,4 +226,37 @@ int main(int argc, char* argv[])
     if (world.rank() == 0)
         fmt::print(stderr, "Summary stats upon completion\n");
     summary_stats(master, moved_blocks);
+
+    size_t final_remote_links = remote_links();
+    if (world.rank() == 0)
+        fmt::print(stderr, "Remote links: {} before balancing, {} after\n", initial_remote_links, final_remote_links);
+
+    // no blocks lost, and the heaviest process is no heavier than before
+    int nlocal = static_cast<int>(master.size()), total;
+    diy::mpi::all_reduce(world, nlocal, total, std::plus<int>());
+    diy::Work final_max_proc_work = max_proc_work();
+    if (total != nblocks || (algorithm != 0 && final_max_proc_work > initial_max_proc_work))
+    {
+        if (world.rank() == 0)
+            fmt::print(stderr, "Error: {} blocks after balancing (expected {}), heaviest process work {} (initially {})\n",
+                       total, nblocks, final_max_proc_work, initial_max_proc_work);
+        return 1;
+    }
+
+    // LPT and Karmarkar-Karp leave a balanced assignment (3+3 | 2+2+2) alone, but fix an unbalanced one (3+3+3 | 1)
+    for (auto a : { diy::CollectiveBalance::lpt, diy::CollectiveBalance::karmarkar_karp })
+    {
+        std::vector<diy::detail::BlockWork> balanced   { {0, 0, 3, {}}, {1, 0, 3, {}}, {2, 1, 2, {}}, {3, 1, 2, {}}, {4, 1, 2, {}} };
+        std::vector<diy::detail::BlockWork> unbalanced { {0, 0, 3, {}}, {1, 0, 3, {}}, {2, 0, 3, {}}, {3, 1, 1, {}} };
+        std::vector<diy::detail::MoveInfo>  kept, fixed;
+        diy::detail::decide_moves(balanced,   2, a, 1.0f, 0.0f, kept);
+        diy::detail::decide_moves(unbalanced, 2, a, 1.0f, 0.0f, fixed);
+        if (!kept.empty() || fixed.size() != 1)
+        {
+            if (world.rank() == 0)
+                fmt::print(stderr, "Error: algorithm {} moves {} blocks of a balanced assignment, {} of an unbalanced one\n",
+                           static_cast<int>(a) + 1, kept.size(), fixed.size());
+            return 1;
+        }
+    }
 }
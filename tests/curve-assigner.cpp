@@ -0,0 +1,200 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <diy/mpi.hpp>
+#include <diy/master.hpp>
+#include <diy/assigner.hpp>
+#include <diy/decomposition.hpp>
+#include <diy/io/block.hpp>
+
+#define CATCH_CONFIG_RUNNER
+#include "catch.hpp"
+
+namespace
+{
+    using Decomposer = diy::RegularDecomposer<diy::DiscreteBounds>;
+
+    Decomposer make_decomposer(int nblocks, Decomposer::DivisionsVector divisions = Decomposer::DivisionsVector())
+    {
+        diy::DiscreteBounds domain(3);
+        for (int i = 0; i < 3; ++i)
+        {
+            domain.min[i] = 0;
+            domain.max[i] = 127;
+        }
+        return Decomposer(3, domain, nblocks, Decomposer::BoolVector(), Decomposer::BoolVector(), Decomposer::CoordinateVector(), divisions);
+    }
+
+    // every gid goes to exactly one rank, which lists it among its local gids, and the ranks differ by at most one block
+    void check_assignment(const diy::StaticAssigner& assigner)
+    {
+        std::vector<int> owner(assigner.nblocks(), -1);
+        size_t min_count = assigner.nblocks(), max_count = 0;
+        for (int rank = 0; rank < assigner.size(); ++rank)
+        {
+            std::vector<int> gids;
+            assigner.local_gids(rank, gids);
+            min_count = std::min(min_count, gids.size());
+            max_count = std::max(max_count, gids.size());
+            for (int gid : gids)
+            {
+                REQUIRE(owner[gid] == -1);
+                owner[gid] = rank;
+                REQUIRE(assigner.rank(gid) == rank);
+            }
+        }
+        for (int rank : owner)
+            REQUIRE(rank != -1);
+        REQUIRE(max_count - min_count <= 1);
+    }
+
+    // face neighbors assigned to different ranks
+    int remote_faces(const Decomposer& decomposer, const diy::Assigner& assigner)
+    {
+        int count = 0;
+        for (int gid = 0; gid < decomposer.nblocks; ++gid)
+        {
+            Decomposer::DivisionsVector coords = decomposer.gid_to_coords(gid);
+            for (size_t i = 0; i < coords.size(); ++i)
+            {
+                if (coords[i] + 1 == decomposer.divisions[i])
+                    continue;
+                ++coords[i];
+                count += assigner.rank(gid) != assigner.rank(decomposer.coords_to_gid(coords));
+                --coords[i];
+            }
+        }
+        return count;
+    }
+
+    struct Block
+    {
+        int             gid = -1;
+
+        static void*    create()                                    { return new Block; }
+        static void     destroy(void* b)                            { delete static_cast<Block*>(b); }
+        static void     save(const void* b, diy::BinaryBuffer& bb)  { diy::save(bb, static_cast<const Block*>(b)->gid); }
+        static void     load(void* b, diy::BinaryBuffer& bb)        { diy::load(bb, static_cast<Block*>(b)->gid); }
+    };
+}
+
+TEST_CASE("Hilbert curve visits neighbors", "[assigner]")
+{
+    // one block per rank: rank r holds the r-th block along the curve
+    Decomposer decomposer = make_decomposer(512);
+    diy::HilbertAssigner assigner(512, decomposer.divisions);
+    check_assignment(assigner);
+
+    for (int p = 0; p + 1 < assigner.nblocks(); ++p)
+    {
+        Decomposer::DivisionsVector a = decomposer.gid_to_coords(assigner.curve_block(p)),
+                                    b = decomposer.gid_to_coords(assigner.curve_block(p + 1));
+        int distance = 0;
+        for (size_t i = 0; i < a.size(); ++i)
+            distance += std::abs(a[i] - b[i]);
+        REQUIRE(distance == 1);
+        REQUIRE(assigner.curve_position(assigner.curve_block(p)) == p);
+    }
+}
+
+TEST_CASE("Space-filling curve assigners", "[assigner]")
+{
+    for (int nblocks : { 64, 512 })
+    {
+        Decomposer decomposer = make_decomposer(nblocks);
+        diy::ContiguousAssigner contiguous(4, nblocks);
+        diy::HilbertAssigner    hilbert(4, decomposer.divisions);
+        diy::MortonAssigner     morton(4, decomposer.divisions);
+
+        check_assignment(hilbert);
+        check_assignment(morton);
+
+        // each rank gets a prism of octants instead of a slab
+        REQUIRE(remote_faces(decomposer, hilbert) < remote_faces(decomposer, contiguous));
+        REQUIRE(remote_faces(decomposer, morton)  < remote_faces(decomposer, contiguous));
+    }
+
+    SECTION("uneven divisions")
+    {
+        Decomposer decomposer = make_decomposer(30, Decomposer::DivisionsVector { 3, 5, 2 });
+        for (int size : { 1, 4, 7, 30, 32 })
+        {
+            check_assignment(diy::HilbertAssigner(size, decomposer.divisions));
+            check_assignment(diy::MortonAssigner(size, decomposer.divisions));
+        }
+    }
+
+    SECTION("missing divisions")
+    {
+        REQUIRE_THROWS(diy::HilbertAssigner(4, Decomposer::DivisionsVector { 4, 0, 4 }));
+    }
+}
+
+TEST_CASE("Space-filling curve assigner reads blocks", "[assigner][io]")
+{
+    diy::mpi::communicator world;
+    Decomposer decomposer = make_decomposer(8 * world.size());
+    std::string filename = "curve-assigner-" + std::to_string(world.size()) + ".blocks";
+
+    // write the blocks in gid order
+    diy::ContiguousAssigner contiguous(world.size(), decomposer.nblocks);
+    diy::Master             written(world, 1, -1, &Block::create, &Block::destroy, 0, &Block::save, &Block::load);
+    decomposer.decompose(world.rank(), contiguous, [&](int gid, const diy::DiscreteBounds&, const diy::DiscreteBounds&, const diy::DiscreteBounds&, const diy::RegularGridLink& link)
+                         {
+                            Block* b = new Block;
+                            b->gid = gid;
+                            written.add(gid, b, new diy::RegularGridLink(link));
+                         });
+
+    // read them along the curve
+    diy::HilbertAssigner assigner(world.size(), decomposer.divisions);
+    diy::Master          master(world, 1, -1, &Block::create, &Block::destroy, 0, &Block::save, &Block::load);
+
+#if DIY_HAS_MPI
+    SECTION("one file")
+    {
+        diy::io::write_blocks(filename, world, written);
+        diy::io::read_blocks(filename, world, assigner, master);
+
+        world.barrier();
+        if (world.rank() == 0)
+            std::remove(filename.c_str());
+    }
+#endif
+
+    SECTION("file per block")
+    {
+        diy::io::split::write_blocks(filename, world, written);
+        world.barrier();
+        diy::io::split::read_blocks(filename, world, assigner, master);
+
+        world.barrier();
+        if (world.rank() == 0)
+        {
+            for (int gid = 0; gid < decomposer.nblocks; ++gid)
+                std::remove((filename + "/" + std::to_string(gid)).c_str());
+            std::remove((filename + "/extra").c_str());
+            std::remove(filename.c_str());
+        }
+    }
+
+    std::vector<int> gids;
+    assigner.local_gids(world.rank(), gids);
+    REQUIRE(master.size() == gids.size());
+    for (int i = 0; i < static_cast<int>(master.size()); ++i)
+    {
+        REQUIRE(assigner.rank(master.gid(i)) == world.rank());
+        REQUIRE(master.block<Block>(i)->gid == master.gid(i));
+    }
+
+    REQUIRE_NOTHROW(assigner.set_nblocks(decomposer.nblocks));
+    REQUIRE_THROWS(assigner.set_nblocks(decomposer.nblocks + 1));
+}
+
+int main(int argc, char* argv[])
+{
+    diy::mpi::environment   env(argc, argv);
+    return Catch::Session().run(argc, argv);
+}
@@ -6,6 +6,9 @@
 #include <diy/dynamic-point.hpp>
 
 #include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
 
 void  test(int gid,                                         // block global id
            const diy::ContinuousBounds&,                    // block bounds without any ghost added
@@ -70,6 +73,352 @@ TEST_CASE("RegularDecomposer", "[decomposition]")
     }
 }
 
+TEST_CASE("RegularDecomposer divisions of least cost", "[decomposition]")
+{
+    using Decomposer = diy::RegularDecomposer<diy::DiscreteBounds>;
+
+    diy::DiscreteBounds strip(2);
+    strip.min[0] = strip.min[1] = 0;
+    strip.max[0] = 599;
+    strip.max[1] = 99;
+
+    SECTION("least halo")
+    {
+        // greedy splits the long side into 100x100 squares, then cuts them in half
+        Decomposer greedy(2, strip, 12);
+        Decomposer least (2, strip, 12, Decomposer::BoolVector(), Decomposer::BoolVector(), Decomposer::CoordinateVector(),
+                          Decomposer::DivisionsVector(), Decomposer::min_halo);
+        REQUIRE(greedy.divisions == Decomposer::DivisionsVector { 6, 2 });
+        REQUIRE(least.divisions  == Decomposer::DivisionsVector { 12, 1 });
+        REQUIRE(least.halo_bytes(8) == 8 * 2200);
+        REQUIRE(least.halo_bytes() < greedy.halo_bytes());
+    }
+
+    SECTION("ghosts")
+    {
+        // wide ghosts in z: don't cut it
+        diy::DiscreteBounds cube(3);
+        for (int i = 0; i < 3; ++i)
+        {
+            cube.min[i] = 0;
+            cube.max[i] = 63;
+        }
+        Decomposer decomposer(3, cube, 8, Decomposer::BoolVector(), Decomposer::BoolVector(), Decomposer::CoordinateVector { 1, 1, 4 },
+                              Decomposer::DivisionsVector(), Decomposer::min_halo);
+        REQUIRE(decomposer.divisions[2] == 1);
+        REQUIRE(decomposer.divisions[0] * decomposer.divisions[1] == 8);
+
+        // never worse than the greedy choice
+        for (int nblocks = 1; nblocks <= 64; ++nblocks)
+        {
+            Decomposer greedy(3, cube, nblocks);
+            Decomposer least (3, cube, nblocks, Decomposer::BoolVector(), Decomposer::BoolVector(), Decomposer::CoordinateVector(),
+                              Decomposer::DivisionsVector(), Decomposer::min_halo);
+            REQUIRE(least.halo_bytes() <= greedy.halo_bytes());
+        }
+    }
+
+    SECTION("user cost and constraints")
+    {
+        auto uncut_x = [](const Decomposer&, const Decomposer::DivisionsVector& divs) { return static_cast<double>(divs[0]); };
+        Decomposer decomposer(2, strip, 12, Decomposer::BoolVector(), Decomposer::BoolVector(), Decomposer::CoordinateVector(),
+                              Decomposer::DivisionsVector(), uncut_x);
+        REQUIRE(decomposer.divisions == Decomposer::DivisionsVector { 1, 12 });
+
+        Decomposer constrained(2, strip, 12, Decomposer::BoolVector(), Decomposer::BoolVector(), Decomposer::CoordinateVector(),
+                               Decomposer::DivisionsVector { 0, 3 }, Decomposer::min_halo);
+        REQUIRE(constrained.divisions == Decomposer::DivisionsVector { 4, 3 });
+
+        // too many blocks for the cells
+        REQUIRE_THROWS(Decomposer(1, diy::interval(0, 3), 8, Decomposer::BoolVector(), Decomposer::BoolVector(), Decomposer::CoordinateVector(),
+                                  Decomposer::DivisionsVector(), Decomposer::min_halo));
+    }
+}
+
+namespace
+{
+    // the cores of the blocks tile the domain, every point goes to the block whose core contains it,
+    // and the neighbors in the links touch
+    template<class Decomposer>
+    void check_tiling(Decomposer decomposer, const std::vector<typename Decomposer::Bounds>& points)
+    {
+        using Bounds = typename Decomposer::Bounds;
+
+        std::vector<Bounds> cores(decomposer.nblocks, Bounds(decomposer.dim));
+        diy::ContiguousAssigner assigner(1, decomposer.nblocks);
+        decomposer.decompose(0, assigner, [&](int gid, const Bounds& core, const Bounds&, const Bounds&, const typename Decomposer::Link& link)
+        {
+            cores[gid] = core;
+            for (int i = 0; i < link.size(); ++i)
+            {
+                const Bounds& nbr = link.core(i);
+                for (int j = 0; j < decomposer.dim; ++j)
+                {
+                    if (link.wrap(i)[j] != 0)
+                        continue;
+                    REQUIRE(nbr.min[j] <= core.max[j] + 1);
+                    REQUIRE(core.min[j] <= nbr.max[j] + 1);
+                }
+            }
+        });
+
+        for (auto& p : points)
+        {
+            diy::DynamicPoint<typename Decomposer::Coordinate> x(decomposer.dim);
+            for (int j = 0; j < decomposer.dim; ++j)
+                x[j] = p.min[j];
+
+            int gid = decomposer.point_to_gid(x);
+            REQUIRE(gid >= 0);
+            for (int j = 0; j < decomposer.dim; ++j)
+            {
+                REQUIRE(cores[gid].min[j] <= x[j]);
+                REQUIRE(x[j] <= cores[gid].max[j]);
+            }
+
+            std::vector<int> gids;
+            decomposer.point_to_gids(gids, x);
+            REQUIRE(std::find(gids.begin(), gids.end(), gid) != gids.end());
+            REQUIRE(static_cast<int>(gids.size()) == decomposer.num_gids(x));
+        }
+    }
+}
+
+TEST_CASE("RegularDecomposer with cuts", "[decomposition]")
+{
+    using Decomposer = diy::RegularDecomposer<diy::DiscreteBounds>;
+
+    diy::DiscreteBounds domain(2);
+    domain.min[0] = domain.min[1] = 0;
+    domain.max[0] = domain.max[1] = 255;
+
+    std::vector<diy::DiscreteBounds> points;
+    for (int x = 0; x < 256; x += 5)
+        for (int y = 0; y < 256; y += 7)
+        {
+            diy::DiscreteBounds p(2);
+            p.min[0] = p.max[0] = x;
+            p.min[1] = p.max[1] = y;
+            points.push_back(p);
+        }
+
+    // the cost is concentrated in one corner of a 32x32 field
+    Decomposer::DivisionsVector shape { 32, 32 };
+    std::vector<double> cost(32*32, 1.);
+    for (int y = 0; y < 8; ++y)
+        for (int x = 0; x < 8; ++x)
+            cost[y*32 + x] = 50.;
+
+    SECTION("cost field")
+    {
+        Decomposer uniform(2, domain, 16), weighted(2, domain, 16);
+        weighted.balance_cuts(cost, shape);
+
+        auto largest = [&](const Decomposer& d) { auto c = d.block_costs(cost, shape); return *std::max_element(c.begin(), c.end()); };
+        REQUIRE(largest(weighted) * 4 < largest(uniform));
+
+        check_tiling(uniform,  points);
+        check_tiling(weighted, points);
+    }
+
+    SECTION("histogram")
+    {
+        // 3/4 of the cost in the first bin
+        Decomposer decomposer(1, diy::interval(0, 99), 4);
+        decomposer.balance_cuts(0, std::vector<double> { 30., 2., 2., 2., 2., 2. });
+        REQUIRE(decomposer.cuts[0] == Decomposer::CoordinateVector { 0, 6, 11, 17, 100 });
+
+        diy::DiscreteBounds bounds(1);
+        decomposer.fill_bounds(bounds, 3);
+        REQUIRE(bounds.min[0] == 17);
+        REQUIRE(bounds.max[0] == 99);
+    }
+
+    SECTION("shared faces, wrap, ghosts")
+    {
+        Decomposer decomposer(2, domain, 16, Decomposer::BoolVector { true, false }, Decomposer::BoolVector { false, true },
+                              Decomposer::CoordinateVector { 2, 3 });
+        decomposer.balance_cuts(cost, shape);
+        check_tiling(decomposer, points);
+    }
+
+    SECTION("continuous")
+    {
+        using ContinuousDecomposer = diy::RegularDecomposer<diy::ContinuousBounds>;
+        diy::ContinuousBounds cdomain(2);
+        cdomain.min[0] = cdomain.min[1] = 0;
+        cdomain.max[0] = cdomain.max[1] = 1;
+
+        ContinuousDecomposer decomposer(2, cdomain, 8);
+        REQUIRE(decomposer.divisions == ContinuousDecomposer::DivisionsVector { 4, 2 });
+        decomposer.set_cuts(0, ContinuousDecomposer::CoordinateVector { 0.f, .1f, .2f, .6f, 1.f });
+
+        std::vector<diy::ContinuousBounds> cpoints;
+        for (float x = 0; x <= 1; x += .0625f)
+            for (float y = 0; y <= 1; y += .05f)
+            {
+                diy::ContinuousBounds p(2);
+                p.min[0] = p.max[0] = x;
+                p.min[1] = p.max[1] = y;
+                cpoints.push_back(p);
+            }
+        check_tiling(decomposer, cpoints);
+
+        decomposer.balance_cuts(cost, shape);
+        check_tiling(decomposer, cpoints);
+    }
+
+    SECTION("bad cuts")
+    {
+        Decomposer decomposer(2, domain, 4);
+        REQUIRE_THROWS(decomposer.set_cuts(0, Decomposer::CoordinateVector { 0, 256 }));
+        REQUIRE_THROWS(decomposer.set_cuts(0, Decomposer::CoordinateVector { 0, 0, 256 }));
+        REQUIRE_THROWS(decomposer.set_cuts(0, Decomposer::CoordinateVector { 0, 10, 255 }));
+    }
+}
+
+namespace
+{
+    // random points, in columns, a little beyond the domain
+    template<class Decomposer>
+    std::vector<std::vector<typename Decomposer::Coordinate>> random_columns(const Decomposer& decomposer, size_t n)
+    {
+        using Coordinate = typename Decomposer::Coordinate;
+
+        std::mt19937 gen(0);
+        std::vector<std::vector<Coordinate>> columns(decomposer.dim, std::vector<Coordinate>(n));
+        for (int i = 0; i < decomposer.dim; ++i)
+        {
+            double lo = decomposer.domain.min[i], hi = decomposer.domain.max[i], margin = (hi - lo) / 8;
+            std::uniform_real_distribution<double> dist(lo - margin, hi + margin);
+            for (size_t k = 0; k < n; ++k)
+                columns[i][k] = static_cast<Coordinate>(dist(gen));
+
+            // and exactly on the block boundaries
+            for (size_t k = 0; k < n; k += 7)
+                columns[i][k] = decomposer.block_from(i, static_cast<int>(k % decomposer.divisions[i]));
+        }
+        return columns;
+    }
+
+    template<class Decomposer>
+    void check_batch(const Decomposer& decomposer, size_t n, int threads)
+    {
+        using Coordinate = typename Decomposer::Coordinate;
+
+        auto columns = random_columns(decomposer, n);
+        std::vector<const Coordinate*> pointers;
+        for (auto& column : columns)
+            pointers.push_back(column.data());
+        std::vector<Coordinate> interleaved(n * decomposer.dim);
+        for (size_t k = 0; k < n; ++k)
+            for (int i = 0; i < decomposer.dim; ++i)
+                interleaved[k * decomposer.dim + i] = columns[i][k];
+
+        diy::RoundRobinAssigner assigner(3, decomposer.nblocks);
+        std::vector<int> gids(n), interleaved_gids(n), ranks(n);
+        decomposer.points_to_gids(pointers.data(), n, gids.data(), assigner, ranks.data(), threads);
+        decomposer.points_to_gids(interleaved.data(), n, interleaved_gids.data(), threads);
+
+        diy::DynamicPoint<Coordinate> p(decomposer.dim);
+        for (size_t k = 0; k < n; ++k)
+        {
+            for (int i = 0; i < decomposer.dim; ++i)
+                p[i] = columns[i][k];
+            int gid = decomposer.point_to_gid(p);
+            CAPTURE(k);
+            REQUIRE(gids[k] == gid);
+            REQUIRE(interleaved_gids[k] == gid);
+            REQUIRE(ranks[k] == (gid < 0 ? -1 : assigner.rank(gid)));
+        }
+    }
+}
+
+TEST_CASE("RegularDecomposer batched point_to_gid", "[decomposition]")
+{
+    using Decomposer           = diy::RegularDecomposer<diy::DiscreteBounds>;
+    using ContinuousDecomposer = diy::RegularDecomposer<diy::ContinuousBounds>;
+
+    diy::DiscreteBounds domain(3);
+    diy::ContinuousBounds cdomain(3);
+    for (int i = 0; i < 3; ++i)
+    {
+        domain.min[i]  = -10;
+        domain.max[i]  = 100;       // 111 cells: the last block is wider
+        cdomain.min[i] = -1.f;
+        cdomain.max[i] = 2.5f;
+    }
+
+    for (bool shared : { false, true })
+        for (bool wrapped : { false, true })
+        {
+            Decomposer::BoolVector share_face(3, shared), wrap { wrapped, false, wrapped };
+            Decomposer           discrete  (3, domain,  60, share_face, wrap);
+            ContinuousDecomposer continuous(3, cdomain, 60, share_face, wrap);
+            check_batch(discrete,   1000, 1);
+            check_batch(continuous, 1000, 1);
+
+            discrete.balance_cuts(0, std::vector<double> { 5., 1., 1., 2. });
+            continuous.balance_cuts(1, std::vector<double> { 1., 1., 7. });
+            check_batch(discrete,   1000, 1);
+            check_batch(continuous, 1000, 1);
+        }
+
+    SECTION("threads")
+    {
+        Decomposer decomposer(3, domain, 64);
+        check_batch(decomposer, 4 * Decomposer::min_batch + 3, 4);
+    }
+}
+
+TEST_CASE("RegularDecomposer batched point_to_gid benchmark", "[.][decomposition][benchmark]")
+{
+    using Decomposer = diy::RegularDecomposer<diy::ContinuousBounds>;
+
+    diy::ContinuousBounds domain(3);
+    for (int i = 0; i < 3; ++i)
+    {
+        domain.min[i] = 0;
+        domain.max[i] = 1;
+    }
+    Decomposer decomposer(3, domain, 512);
+
+    size_t n = 4000000;
+    auto columns = random_columns(decomposer, n);
+    std::vector<const float*> pointers;
+    for (auto& column : columns)
+        pointers.push_back(column.data());
+
+    auto time = [](const std::function<void()>& f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::vector<int> scalar(n), batched(n), threaded(n);
+    double scalar_time = time([&]()
+    {
+        diy::DynamicPoint<float> p(3);
+        for (size_t k = 0; k < n; ++k)
+        {
+            for (int i = 0; i < 3; ++i)
+                p[i] = columns[i][k];
+            scalar[k] = decomposer.point_to_gid(p);
+        }
+    });
+    double batched_time  = time([&]() { decomposer.points_to_gids(pointers.data(), n, batched.data()); });
+    double threaded_time = time([&]() { decomposer.points_to_gids(pointers.data(), n, threaded.data(), 4); });
+
+    std::cout << n << " points, 512 blocks:\n"
+              << "  point_to_gid:              " << scalar_time   << " s\n"
+              << "  points_to_gids:            " << batched_time  << " s\n"
+              << "  points_to_gids, 4 threads: " << threaded_time << " s" << std::endl;
+
+    REQUIRE(batched  == scalar);
+    REQUIRE(threaded == scalar);
+}
+
 TEST_CASE("DynamicPoint constructors", "[dynamic-point]")
 {
     SECTION("converts between coordinate types")
@@ -1,3 +1,6 @@
+#include <chrono>
+#include <thread>
+
 #include <diy/master.hpp>
 
 #include "opts.h"
@@ -78,6 +81,51 @@ TEST_CASE_METHOD(DoubleForeachFixture, "Send/Receive", "[double-foreach]")
   });
 }
 
+TEST_CASE_METHOD(DoubleForeachFixture, "Block costs", "[double-foreach]")
+{
+  diy::Master master(world, 1, -1, 0, cpp_delete<Block>);
+  diy::RoundRobinAssigner assigner(world.size(), nblocks);
+
+  std::vector<int> gids;
+  assigner.local_gids(world.rank(), gids);
+  if (gids.empty())
+    return;
+  for (int gid : gids)
+    master.add(gid, new Block, new diy::Link);
+
+  for (int gid : gids)
+    CHECK(master.block_cost(gid) == 0);
+
+  // every foreach is timed (in immediate mode, each one is a separate execute())
+  auto sleep = [](int ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); };
+  for (unsigned i = 0; i < iter; ++i)
+      master.foreach([&](Block*, const diy::Master::ProxyWithLink& cp) { sleep(5 * (cp.gid() % 2)); });
+  master.exchange();
+
+  auto work = master.measured_work();
+  std::vector<double> first;
+  for (int gid : gids)
+  {
+    double cost = master.block_cost(gid);
+    first.push_back(cost);
+    CHECK(cost >= 0.005 * (gid % 2));
+    CHECK(work(nullptr, gid) == static_cast<diy::Work>(cost * 1e6 + .5));
+  }
+
+  // the estimate follows the measurements with the given weight
+  master.set_cost_smoothing(.5);
+  master.foreach([](Block*, const diy::Master::ProxyWithLink&) {});
+  master.exchange();
+  for (size_t i = 0; i < gids.size(); ++i)
+    if (gids[i] % 2)
+      CHECK(master.block_cost(gids[i]) < .75 * first[i]);
+
+  master.set_block_cost(gids[0], 1.);
+  CHECK(master.block_cost(gids[0]) == 1.);
+  master.destroyer()(master.release(gids[0]));
+  CHECK(master.block_cost(gids[0]) == 0);
+}
+
 int main(int argc, char* argv[])
 {
   diy::mpi::environment env(argc, argv);
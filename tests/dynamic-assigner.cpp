@@ -1,6 +1,7 @@
 #include    <iostream>
 #include    <vector>
 #include    <tuple>
+#include    <algorithm>
 
 #include    <diy/assigner.hpp>
 #include    <diy/mpi.hpp>
@@ -60,6 +61,36 @@ TEST_CASE_METHOD(SimpleFixture, "Dynamic Assigner Test", "[dynamic-assigner]")
         CAPTURE(gid);
         CHECK(rank == all_ranks[gid]);
     }
+
+    // batched lookups come from the cache now
+    std::vector<int> all_gids(nblocks);
+    for (int gid = 0; gid < nblocks; ++gid)
+        all_gids[gid] = gid;
+    CHECK(dynamic.ranks(all_gids) == all_ranks);
+
+    // reassign: setting the ranks starts a new epoch, so nobody sees the old assignment
+    unsigned epoch = dynamic.epoch();
+    std::fill(ranks.begin(), ranks.end(), 0);
+    rank_gids.clear();
+    for (int gid : gids)
+    {
+        int rank = (world.rank() + 2) % world.size();
+        rank_gids.emplace_back(rank, gid);
+        ranks[gid] = rank;
+    }
+    diy::mpi::all_reduce(world, ranks, all_ranks, std::plus<int>());
+
+    world.barrier();        // everybody is done reading the old assignment
+    dynamic.set_ranks(rank_gids);
+    CHECK(dynamic.epoch() != epoch);
+    world.barrier();
+
+    std::vector<int> reversed(all_gids.rbegin(), all_gids.rend());
+    std::vector<int> reversed_ranks = dynamic.ranks(reversed);
+    for (int i = 0; i < nblocks; ++i)
+        CHECK(reversed_ranks[i] == all_ranks[nblocks - 1 - i]);
+    for (int gid = 0; gid < nblocks; ++gid)
+        CHECK(dynamic.rank(gid) == all_ranks[gid]);
 }
 
 int main(int argc, char* argv[])
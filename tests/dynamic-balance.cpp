@@ -119,6 +119,7 @@ void test_dynamic_incoming_queue_migration(const diy::mpi::communicator& world)
     diy::BinaryBlob blob = from_eight->front().buffer().load_binary_blob();
     require_dynamic_queue_test(blob.size == sizeof(blob_data), "source 8 blob size");
     require_dynamic_queue_test(std::memcmp(blob.pointer.get(), blob_data, blob.size) == 0, "source 8 blob contents");
+    require_dynamic_queue_test(blob.pointer.get() == blob_data, "source 8 blob moved, not copied");
 
     diy::load(from_nine->front().buffer(), value);
     require_dynamic_queue_test(value == 44, "source 9 preserved read position");
@@ -127,6 +128,82 @@ void test_dynamic_incoming_queue_migration(const diy::mpi::communicator& world)
     require_dynamic_queue_test(migrated_next_blob.size == sizeof(next_blob), "source 11 next blob size");
     require_dynamic_queue_test(std::memcmp(migrated_next_blob.pointer.get(), next_blob, migrated_next_blob.size) == 0, "source 11 next blob contents");
 }
+
+// block whose payload, if any, goes into a blob that points into it
+struct BlobBlock
+{
+    std::vector<char>   payload;
+
+    static int      destroyed;
+
+    static void*    create()                                            { return new BlobBlock; }
+    static void     destroy(void* b)                                    { ++destroyed; delete static_cast<BlobBlock*>(b); }
+    static void     save(const void* b_, diy::BinaryBuffer& bb)
+    {
+        const BlobBlock* b = static_cast<const BlobBlock*>(b_);
+        diy::save(bb, b->payload.empty());
+        if (!b->payload.empty())
+            bb.save_binary_blob(b->payload.data(), b->payload.size());
+    }
+    static void     load(void* b_, diy::BinaryBuffer& bb)
+    {
+        BlobBlock* b = static_cast<BlobBlock*>(b_);
+        bool empty;
+        diy::load(bb, empty);
+        if (empty)
+            return;
+        diy::BinaryBlob blob = bb.load_binary_blob();
+        b->payload.assign(blob.pointer.get(), blob.pointer.get() + blob.size);
+    }
+};
+int BlobBlock::destroyed = 0;
+
+void test_block_migration_with_blobs(const diy::mpi::communicator& world)
+{
+    diy::Master send_master(world, 1, -1, &BlobBlock::create, &BlobBlock::destroy, 0, &BlobBlock::save, &BlobBlock::load);
+    diy::Master recv_master(world, 1, -1, &BlobBlock::create, &BlobBlock::destroy, 0, &BlobBlock::save, &BlobBlock::load);
+
+    const int gid = world.rank(), plain_gid = world.rank() + world.size();
+    BlobBlock* b = new BlobBlock;
+    b->payload.assign(100000, 'x');
+    b->payload[12345] = 'y';
+    diy::Link* link = new diy::Link;
+    link->add_neighbor(diy::BlockID { gid + 1, world.rank() });
+    send_master.add(gid, b, link);
+    send_master.add(plain_gid, new BlobBlock, new diy::Link);
+
+    diy::MemoryBuffer sent;
+    std::vector<diy::mpi::request> requests;
+    {
+        diy::detail::MigratedBlocks migrated(send_master);
+        migrated.save(gid, sent);
+        require_dynamic_queue_test(send_master.size() == 1, "block released");
+        require_dynamic_queue_test(sent.nblobs() == 1 && sent.blobs[0].pointer.get() == b->payload.data(), "block blob not copied");
+        require_dynamic_queue_test(migrated.blocks.size() == 1 && BlobBlock::destroyed == 0, "block with blob kept until sent");
+
+        migrated.save(plain_gid, sent);
+        require_dynamic_queue_test(migrated.blocks.size() == 1 && BlobBlock::destroyed == 1, "block without blobs destroyed right away");
+
+        // send the blob in several pieces
+        const size_t piece = 4096;
+        diy::detail::isend_with_blobs(world, world.rank(), 0, sent, requests, piece);
+        diy::MemoryBuffer received;
+        diy::detail::recv_with_blobs(world, world.rank(), 0, received, piece);
+        for (auto& r : requests)
+            r.wait();
+
+        diy::detail::load_migrated_block(recv_master, gid, received);
+        diy::detail::load_migrated_block(recv_master, plain_gid, received);
+    }
+    require_dynamic_queue_test(BlobBlock::destroyed == 2, "block with blob destroyed once sent");
+
+    require_dynamic_queue_test(recv_master.size() == 2, "blocks received");
+    BlobBlock* r = static_cast<BlobBlock*>(recv_master.block(recv_master.lid(gid)));
+    require_dynamic_queue_test(r->payload.size() == 100000 && r->payload[12345] == 'y', "block payload");
+    require_dynamic_queue_test(recv_master.link(recv_master.lid(gid))->size() == 1, "block link");
+    r = static_cast<BlobBlock*>(recv_master.block(recv_master.lid(plain_gid)));
+    require_dynamic_queue_test(r->payload.empty(), "block without blobs");
+}
 }
 
 int main(int argc, char* argv[])
@@ -134,6 +211,7 @@ int main(int argc, char* argv[])
     diy::mpi::environment     env(argc, argv);                          // diy equivalent of MPI_Init
     diy::mpi::communicator    world;                                    // diy equivalent of MPI communicator
     test_dynamic_incoming_queue_migration(world);
+    test_block_migration_with_blobs(world);
 
     int                       bpr = 4;                                  // blocks per rank
     int                       iters = 1;                                // number of iterations to run
@@ -145,6 +223,8 @@ int main(int argc, char* argv[])
     float                     noise_factor = 0.0;                       // multiplier for noise in predicted -> actual work
     int                       distribution = 0;                         // type of distribution for assigning work (0: uniform (default), 1: normal, 2: exponential)
     unsigned int              seed = 0;                                 // seed for random number generator (0: ignore)
+    bool                      rma = false;                              // steal work through a window instead of by sampling
+    float                     locality = 0.0f;                          // weight of the link neighbors in the choice of blocks to move
     bool                      help;
 
     using namespace opts;
@@ -160,6 +240,8 @@ int main(int argc, char* argv[])
         >> Option('n', "noise_factor",  noise_factor,   "multiplier for noise in predicted -> actual work")
         >> Option('d', "distribution",  distribution,   "distribution for assigning work (0 uniform (default), 1 normal, 2 exponential)")
         >> Option('s', "seed",          seed,           "seed for random number generator (default: 0 = ignore")
+        >> Option('r', "rma",           rma,            "steal work through a window instead of by sampling")
+        >> Option('l', "locality",      locality,       "weight of the link neighbors in the choice of blocks to move (default: 0)")
         ;
 
     if (!ops.parse(argc,argv) || help)
@@ -194,6 +276,7 @@ int main(int argc, char* argv[])
                        0,
                        &Block::save,
                        &Block::load);
+    master.set_balance_locality(locality);
 
     // create a regular decomposer and call its decompose function
     diy::RegularDecomposer<Bounds> decomposer(3,
@@ -274,6 +357,8 @@ int main(int argc, char* argv[])
         }
 
         // some block computation
+        if (rma)
+            master.set_work_stealing(diy::Master::WorkStealing::rma);
         master.dynamic_foreach(
                 [&](Block* b, const diy::Master::ProxyWithLink& cp) { b->compute(cp, max_time); },
                 &get_block_work,
@@ -320,4 +405,14 @@ int main(int argc, char* argv[])
     if (world.rank() == 0)
         fmt::print(stderr, "Summary stats upon completion\n");
     summary_stats(master, moved_blocks);
+
+    // no blocks lost
+    int nlocal = static_cast<int>(master.size()), total;
+    diy::mpi::all_reduce(world, nlocal, total, std::plus<int>());
+    if (total != nblocks)
+    {
+        if (world.rank() == 0)
+            fmt::print(stderr, "Error: {} blocks after balancing, expected {}\n", total, nblocks);
+        return 1;
+    }
 }
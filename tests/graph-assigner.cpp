@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <diy/mpi.hpp>
+#include <diy/master.hpp>
+#include <diy/assigner.hpp>
+#include <diy/decomposition.hpp>
+#include <diy/algorithms.hpp>
+#include <diy/io/block.hpp>
+
+#define CATCH_CONFIG_RUNNER
+#include "catch.hpp"
+
+namespace
+{
+    using Edges = std::vector<diy::GraphAssigner::Edge>;
+
+    // nx x ny grid, with the vertices numbered through permutation
+    Edges grid_edges(int nx, int ny, const std::vector<int>& permutation)
+    {
+        Edges edges;
+        for (int y = 0; y < ny; ++y)
+            for (int x = 0; x < nx; ++x)
+            {
+                int v = permutation[y*nx + x];
+                if (x + 1 < nx)
+                    edges.emplace_back(v, permutation[y*nx + x + 1]);
+                if (y + 1 < ny)
+                    edges.emplace_back(v, permutation[(y + 1)*nx + x]);
+            }
+        return edges;
+    }
+
+    std::vector<int> identity(int n)
+    {
+        std::vector<int> permutation(n);
+        for (int i = 0; i < n; ++i)
+            permutation[i] = i;
+        return permutation;
+    }
+
+    int cut(const diy::Assigner& assigner, const Edges& edges)
+    {
+        int count = 0;
+        for (auto& e : edges)
+            count += assigner.rank(e.first) != assigner.rank(e.second);
+        return count;
+    }
+
+    // every gid goes to exactly one rank, which lists it among its local gids, and no rank exceeds max_weight
+    void check_assignment(const diy::GraphAssigner& assigner, const std::vector<long long>& weights, long long max_weight)
+    {
+        std::vector<int> owner(assigner.nblocks(), -1);
+        for (int rank = 0; rank < assigner.size(); ++rank)
+        {
+            std::vector<int> gids;
+            assigner.local_gids(rank, gids);
+            long long weight = 0;
+            for (int gid : gids)
+            {
+                REQUIRE(owner[gid] == -1);
+                owner[gid] = rank;
+                REQUIRE(assigner.rank(gid) == rank);
+                weight += weights[gid];
+            }
+            REQUIRE(weight == assigner.weight(rank));
+            REQUIRE(weight <= max_weight);
+        }
+        for (int rank : owner)
+            REQUIRE(rank != -1);
+    }
+
+    struct Block
+    {
+        int             gid = -1;
+
+        static void*    create()                                    { return new Block; }
+        static void     destroy(void* b)                            { delete static_cast<Block*>(b); }
+        static void     save(const void* b, diy::BinaryBuffer& bb)  { diy::save(bb, static_cast<const Block*>(b)->gid); }
+        static void     load(void* b, diy::BinaryBuffer& bb)        { diy::load(bb, static_cast<Block*>(b)->gid); }
+    };
+
+    using Decomposer = diy::RegularDecomposer<diy::DiscreteBounds>;
+
+    Decomposer make_decomposer(int nblocks)
+    {
+        diy::DiscreteBounds domain(3);
+        for (int i = 0; i < 3; ++i)
+        {
+            domain.min[i] = 0;
+            domain.max[i] = 63;
+        }
+        return Decomposer(3, domain, nblocks);
+    }
+
+    std::vector<int> all_ranks(const diy::Assigner& assigner)
+    {
+        std::vector<int> ranks(assigner.nblocks());
+        for (int gid = 0; gid < assigner.nblocks(); ++gid)
+            ranks[gid] = assigner.rank(gid);
+        return ranks;
+    }
+}
+
+TEST_CASE("Graph assigner", "[assigner]")
+{
+    SECTION("grid")
+    {
+        // strips of rows would cut 3*32 edges, squares 2*32
+        Edges edges = grid_edges(32, 32, identity(1024));
+        diy::GraphAssigner assigner(4, 1024, edges);
+        check_assignment(assigner, std::vector<long long>(1024, 1), 269);
+        REQUIRE(assigner.edge_cut() == cut(assigner, edges));
+        REQUIRE(assigner.edge_cut() <= 3*32);
+    }
+
+    SECTION("shuffled grid")
+    {
+        // the gids say nothing about the neighbors
+        std::vector<int> permutation = identity(1024);
+        std::shuffle(permutation.begin(), permutation.end(), std::mt19937(0));
+        Edges edges = grid_edges(32, 32, permutation);
+
+        diy::GraphAssigner      assigner(8, 1024, edges);
+        diy::ContiguousAssigner contiguous(8, 1024);
+        check_assignment(assigner, std::vector<long long>(1024, 1), 135);
+        REQUIRE(assigner.edge_cut() == cut(assigner, edges));
+        REQUIRE(assigner.edge_cut() * 4 < cut(contiguous, edges));
+    }
+
+    SECTION("two cliques")
+    {
+        Edges edges;
+        for (int a = 0; a < 10; ++a)
+            for (int b = a + 1; b < 10; ++b)
+            {
+                edges.emplace_back(2*a, 2*b);
+                edges.emplace_back(2*a + 1, 2*b + 1);
+            }
+        edges.emplace_back(0, 1);
+
+        diy::GraphAssigner assigner(2, 20, edges);
+        check_assignment(assigner, std::vector<long long>(20, 1), 10);
+        REQUIRE(assigner.edge_cut() == 1);
+    }
+
+    SECTION("weights")
+    {
+        // a ring with a few heavy blocks
+        std::vector<long long> weights(200, 1);
+        Edges edges;
+        for (int gid = 0; gid < 200; ++gid)
+        {
+            if (gid % 20 == 0)
+                weights[gid] = 10;
+            edges.emplace_back(gid, (gid + 1) % 200);
+        }
+
+        diy::GraphAssigner assigner(5, weights, edges, 0.1f);
+        check_assignment(assigner, weights, 73);
+        REQUIRE(assigner.edge_cut() <= 10);
+    }
+
+    SECTION("more ranks than blocks")
+    {
+        Edges edges = grid_edges(2, 2, identity(4));
+        diy::GraphAssigner assigner(6, 4, edges);
+        check_assignment(assigner, std::vector<long long>(4, 1), 1);
+    }
+
+    SECTION("bad edges")
+    {
+        REQUIRE_THROWS(diy::GraphAssigner(2, 4, Edges { { 0, 4 } }));
+    }
+}
+
+TEST_CASE("Graph assigner from links", "[assigner]")
+{
+    diy::mpi::communicator world;
+    int nblocks = 8 * world.size();
+
+    // scatter the blocks, and partition their links
+    Decomposer              decomposer = make_decomposer(nblocks);
+    diy::RoundRobinAssigner round_robin(world.size(), nblocks);
+    diy::Master             master(world, 1, -1, &Block::create, &Block::destroy);
+    decomposer.decompose(world.rank(), round_robin, master);
+
+    diy::GraphAssigner assigner = diy::graph_assigner(master);
+    REQUIRE(assigner.nblocks() == nblocks);
+    REQUIRE(assigner.size() == world.size());
+
+    // every process computed the same assignment
+    std::vector<int> ranks = all_ranks(assigner), root_ranks = ranks;
+    diy::mpi::broadcast(world, root_ranks, 0);
+    REQUIRE(ranks == root_ranks);
+
+    Edges edges;
+    for (int i = 0; i < static_cast<int>(master.size()); ++i)
+        for (int j = 0; j < master.link(i)->size(); ++j)
+            edges.emplace_back(master.gid(i), master.link(i)->target(j).gid);
+    if (world.size() > 1)
+        REQUIRE(cut(assigner, edges) < cut(round_robin, edges));
+
+    // decompose anew with it
+    diy::Master placed(world, 1, -1, &Block::create, &Block::destroy);
+    decomposer.decompose(world.rank(), assigner, placed);
+    std::vector<int> gids;
+    assigner.local_gids(world.rank(), gids);
+    REQUIRE(placed.size() == gids.size());
+    for (int i = 0; i < static_cast<int>(placed.size()); ++i)
+        REQUIRE(assigner.rank(placed.gid(i)) == world.rank());
+}
+
+TEST_CASE("Graph assigner reads blocks", "[assigner][io]")
+{
+    diy::mpi::communicator world;
+    int nblocks = 8 * world.size();
+    std::string filename = "graph-assigner-" + std::to_string(world.size()) + ".blocks";
+
+    // write the blocks in gid order, one file each (collective I/O is covered in curve-assigner.cpp)
+    Decomposer decomposer = make_decomposer(nblocks);
+    {
+        diy::ContiguousAssigner assigner(world.size(), nblocks);
+        diy::Master             master(world, 1, -1, &Block::create, &Block::destroy, 0, &Block::save, &Block::load);
+        decomposer.decompose(world.rank(), assigner, [&](int gid, const diy::DiscreteBounds&, const diy::DiscreteBounds&, const diy::DiscreteBounds&, const diy::RegularGridLink& link)
+                             {
+                                Block* b = new Block;
+                                b->gid = gid;
+                                master.add(gid, b, new diy::RegularGridLink(link));
+                             });
+        diy::io::split::write_blocks(filename, world, master);
+    }
+    world.barrier();
+
+    // read them back partitioned by their graph, here a ring
+    Edges edges;
+    for (int gid = 0; gid < nblocks; ++gid)
+        edges.emplace_back(gid, (gid + 3) % nblocks);
+    diy::GraphAssigner assigner(world.size(), nblocks, edges);
+    diy::Master        master(world, 1, -1, &Block::create, &Block::destroy, 0, &Block::save, &Block::load);
+    diy::io::split::read_blocks(filename, world, assigner, master);
+
+    std::vector<int> gids;
+    assigner.local_gids(world.rank(), gids);
+    REQUIRE(master.size() == gids.size());
+    for (int i = 0; i < static_cast<int>(master.size()); ++i)
+    {
+        REQUIRE(assigner.rank(master.gid(i)) == world.rank());
+        REQUIRE(master.block<Block>(i)->gid == master.gid(i));
+    }
+
+    REQUIRE_NOTHROW(assigner.set_nblocks(nblocks));
+    REQUIRE_THROWS(assigner.set_nblocks(nblocks + 1));
+
+    world.barrier();
+    if (world.rank() == 0)
+    {
+        for (int gid = 0; gid < nblocks; ++gid)
+            std::remove((filename + "/" + std::to_string(gid)).c_str());
+        std::remove((filename + "/extra").c_str());
+        std::remove(filename.c_str());
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    diy::mpi::environment   env(argc, argv);
+    return Catch::Session().run(argc, argv);
+}
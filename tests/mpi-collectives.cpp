@@ -2,6 +2,7 @@
 
 #include    <diy/mpi.hpp>
 #include    <diy/log.hpp>
+#include    <diy/serialization.hpp>
 
 #define     CATCH_CONFIG_RUNNER
 #include    "catch.hpp"
@@ -202,6 +203,30 @@ TEST_CASE_METHOD(SimpleFixture, "MPI Collectives Test", "[mpi-collectives]")
         CHECK(all_gathered_simple_vec[j][0] == static_cast<int>(j));
     }
 
+    // gather the contents of memory buffers, allocator and all
+    diy::MemoryBuffer bb;
+    diy::save(bb, world.rank());
+    vector<diy::MemoryBuffer::Buffer> gathered_buffers;
+    mpi::gather(world, bb.buffer, gathered_buffers, 0);
+    if (world.rank() == 0)
+    {
+        REQUIRE(gathered_buffers.size() == world_size);
+        for (size_t j = 0; j < world_size; ++j)
+        {
+            diy::MemoryBuffer in;
+            in.buffer.swap(gathered_buffers[j]);
+            int rank;
+            diy::load(in, rank);
+            CHECK(rank == static_cast<int>(j));
+        }
+    }
+
+    vector<diy::MemoryBuffer::Buffer> all_gathered_buffers;
+    mpi::all_gather(world, bb.buffer, all_gathered_buffers);
+    REQUIRE(all_gathered_buffers.size() == world_size);
+    for (size_t j = 0; j < world_size; ++j)
+        CHECK(all_gathered_buffers[j].size() == sizeof(int));
+
     vector<int> empty_in;
     vector<int> empty_out;
     mpi::all_to_all(world, empty_in, empty_out, 0);
@@ -31,7 +31,6 @@ TEST_CASE_METHOD(SimpleFixture, "MPI Window Test", "[mpi-window]")
     {
         out[i] = target_rank * width + i;
         window.put(out[i], target_rank, i);
-        //window.replace(out[i], target_rank, i);
     }
     window.flush(target_rank);
 
@@ -43,7 +42,6 @@ TEST_CASE_METHOD(SimpleFixture, "MPI Window Test", "[mpi-window]")
     for (int i = 0; i < width; ++i)
     {
         window.get(values[i], source_rank, i);
-        //window.fetch(values[i], source_rank, i);
     }
     window.flush_local(source_rank);
 
@@ -53,6 +51,58 @@ TEST_CASE_METHOD(SimpleFixture, "MPI Window Test", "[mpi-window]")
     window.unlock_all();
 }
 
+TEST_CASE_METHOD(SimpleFixture, "MPI Window Atomics", "[mpi-window]")
+{
+    diy::mpi::window<int> window(world, width);
+
+    int rank        = world.rank();
+    int target_rank = (rank + 2) % world.size();
+    int source_rank = (rank + 1) % world.size();
+
+    window.lock_all(diy::mpi::nocheck);
+
+    // replace the values
+    for (int i = 0; i < width; ++i)
+        window.replace(target_rank * width + i, target_rank, i);
+    window.flush(target_rank);
+
+    world.barrier();
+
+    // fetch the values
+    std::vector<int> values(width);
+    for (int i = 0; i < width; ++i)
+        window.fetch(values[i], source_rank, i);
+    window.flush(source_rank);
+
+    for (int i = 0; i < width; ++i)
+        CHECK(values[i] == source_rank*width + i);
+
+    world.barrier();        // everyone has read the replaced values
+
+    // swap the first value, whose expected value matches
+    int swapped = -1;
+    int result  = -1;
+    window.compare_and_swap(swapped, target_rank * width, result, target_rank, 0);
+    window.flush(target_rank);
+    CHECK(result == target_rank * width);
+
+    // swap it again, now that the expected value is stale
+    result = -1;
+    window.compare_and_swap(-2, target_rank * width, result, target_rank, 0);
+    window.flush(target_rank);
+    CHECK(result == swapped);
+
+    world.barrier();
+
+    // only the successful swap left its mark
+    int first = -1;
+    window.fetch(first, source_rank, 0);
+    window.flush(source_rank);
+    CHECK(first == swapped);
+
+    window.unlock_all();
+}
+
 TEST_CASE_METHOD(SimpleFixture, "MPI Window Move", "[mpi-window-move]")
 {
     SECTION("move constructor")
@@ -29,6 +29,7 @@ int main(int argc, char* argv[])
     float                     noise_factor = 0.0;                       // multiplier for noise in predicted -> actual work
     int                       distribution = 0;                         // type of distribution for assigning work (0: uniform (default), 1: normal, 2: exponential)
     unsigned int              seed = 0;                                 // seed for random number generator (0: ignore)
+    float                     locality = 0.0f;                          // weight of the link neighbors in the choice of blocks to move
     bool                      help;
 
     using namespace opts;
@@ -43,6 +44,7 @@ int main(int argc, char* argv[])
         >> Option('n', "noise_factor",  noise_factor,   "multiplier for noise in predicted -> actual work")
         >> Option('d', "distribution",  distribution,   "distribution for assigning work (0 uniform (default), 1 normal, 2 exponential)")
         >> Option('s', "seed",          seed,           "seed for random number generator (default: 0 = ignore")
+        >> Option('l', "locality",      locality,       "weight of the link neighbors in the choice of blocks to move (default: 0)")
         ;
 
     if (!ops.parse(argc,argv) || help)
@@ -83,6 +85,7 @@ int main(int argc, char* argv[])
                        0,
                        &Block::save,
                        &Block::load);
+    master.set_balance_locality(locality);
 
     // create a regular decomposer and call its decompose function
     diy::RegularDecomposer<Bounds> decomposer(3,
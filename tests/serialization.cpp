@@ -1,9 +1,16 @@
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
 #include <memory>
 #include <map>
 #include <set>
+#include <string>
+#include <tuple>
 #include <typeinfo>
 #include <unordered_map>
 #include <unordered_set>
@@ -115,6 +122,328 @@ TEST_CASE("associative containers overwrite stale contents", "[serialization]")
     }
 }
 
+namespace
+{
+    // saves through the virtual BinaryBuffer interface and directly into a MemoryBuffer;
+    // both must produce the same bytes and load each other's output
+    template<class T>
+    void require_same_serialization(const T& x)
+    {
+        diy::MemoryBuffer virtual_bb, direct_bb;
+        diy::BinaryBuffer& bb = virtual_bb;
+        diy::save(bb, x);
+        diy::save(direct_bb, x);
+        REQUIRE(virtual_bb.buffer == direct_bb.buffer);
+        REQUIRE(diy::serialized_size(x) == direct_bb.size());
+
+        T from_virtual, from_direct;
+        direct_bb.reset();
+        diy::load(direct_bb, from_virtual);     // load the bytes with the direct path
+        virtual_bb.reset();
+        diy::BinaryBuffer& vb = virtual_bb;
+        diy::load(vb, from_direct);
+        REQUIRE(from_virtual == x);
+        REQUIRE(from_direct == x);
+    }
+
+    struct Small
+    {
+        int     i;
+        float   f;
+        bool    operator==(const Small& o) const    { return i == o.i && f == o.f; }
+    };
+}
+
+TEST_CASE("MemoryBuffer fast path", "[serialization]")
+{
+    require_same_serialization(std::map<int, double> { { 1, 1.5 }, { 2, 2.5 }, { 5, -1. } });
+    require_same_serialization(std::map<int, double> {});
+    require_same_serialization(std::map<std::string, std::vector<int>> { { "a", { 1, 2 } }, { "bc", {} } });
+    require_same_serialization(std::set<std::pair<int, char>> { { 1, 'a' }, { 1, 'b' }, { 3, 'c' } });
+    require_same_serialization(std::unordered_map<long, Small> { { 1, { 2, 3.f } }, { 7, { 8, 9.f } } });
+    require_same_serialization(std::unordered_set<std::string> { "x", "", "yz" });
+    require_same_serialization(std::vector<std::string> { "first", "", "third" });
+    require_same_serialization(std::vector<std::tuple<int, char, double>> { std::make_tuple(1, 'a', 0.5), std::make_tuple(2, 'b', 1.5) });
+    require_same_serialization(std::vector<std::pair<short, std::string>> { { 1, "one" }, { 2, "two" } });
+    require_same_serialization(std::make_tuple(1, std::string("mixed"), 2.5));
+    require_same_serialization(std::string());
+}
+
+struct Unsized { int x; };
+
+namespace diy
+{
+    template<>
+    struct Serialization<Unsized>
+    {
+        static void save(BinaryBuffer& bb, const Unsized& u)    { diy::save(bb, u.x); diy::save(bb, 'u'); }
+        static void load(BinaryBuffer& bb, Unsized& u)          { char c; diy::load(bb, u.x); diy::load(bb, c); }
+    };
+}
+
+TEST_CASE("nested vectors", "[serialization]")
+{
+    std::vector<std::vector<float>> x { { 1.f, 2.f }, {}, { 3.f, 4.f, 5.f } };
+    require_same_serialization(x);
+    require_same_serialization(std::vector<std::vector<int>> {});
+    require_same_serialization(std::vector<std::vector<std::string>> { { "a", "b" }, { "c" } });
+
+    // flattened: number of vectors, their sizes, all the elements
+    diy::MemoryBuffer bb;
+    diy::save(bb, x);
+    REQUIRE(bb.size() == 4 * sizeof(size_t) + 5 * sizeof(float));
+    REQUIRE(diy::serialized_size(x) == bb.size());
+
+    // misaligned elements are still loaded correctly
+    diy::MemoryBuffer mb;
+    diy::save(mb, 'c');
+    diy::save(mb, std::vector<double> { 0.5, 1.5 });
+    mb.reset();
+    char c;
+    std::vector<double> y { 7. };
+    diy::load(mb, c);
+    diy::load(mb, y);
+    REQUIRE(y == std::vector<double> { 0.5, 1.5 });
+
+    // types without size() are measured by saving them
+    REQUIRE(diy::serialized_size(std::vector<Unsized> { { 1 }, { 2 } }) == sizeof(size_t) + 2 * (sizeof(int) + 1));
+    REQUIRE(!diy::detail::is_sized<std::vector<Unsized>>::value);
+}
+
+struct Reflected
+{
+    int                 id;
+    float               position[3];
+    double              mass;
+    std::vector<int>    neighbors;
+    char                tag;
+    std::string         name;
+    short               level;
+
+    bool operator==(const Reflected& o) const
+    {
+        return id == o.id && std::equal(position, position + 3, o.position) && mass == o.mass &&
+               neighbors == o.neighbors && tag == o.tag && name == o.name && level == o.level;
+    }
+};
+
+DIY_SERIALIZE(Reflected, id, position, mass, neighbors, tag, name, level)
+
+TEST_CASE("DIY_SERIALIZE", "[serialization]")
+{
+    Reflected x { 3, { 1.f, 2.f, 3.f }, 0.25, { 4, 5 }, 'r', "reflected", 7 };
+    require_same_serialization(x);
+    require_same_serialization(std::vector<Reflected> { x, Reflected { 0, { 0.f, 0.f, 0.f }, 0., {}, 0, "", 0 } });
+
+    // same bytes as saving the fields one by one
+    diy::MemoryBuffer by_field;
+    diy::save(by_field, x.id);
+    diy::save(by_field, x.position);
+    diy::save(by_field, x.mass);
+    diy::save(by_field, x.neighbors);
+    diy::save(by_field, x.tag);
+    diy::save(by_field, x.name);
+    diy::save(by_field, x.level);
+
+    diy::MemoryBuffer bb;
+    diy::save(bb, x);
+    REQUIRE(bb.buffer == by_field.buffer);
+    REQUIRE(diy::Serialization<Reflected>::size(x) == bb.size());
+
+    // block callbacks for Master
+    Reflected y;
+    bb.reset();
+    diy::load_block<Reflected>(&y, bb);
+    REQUIRE(y == x);
+
+    diy::MemoryBuffer cb;
+    diy::save_block<Reflected>(&y, cb);
+    REQUIRE(cb.buffer == bb.buffer);
+}
+
+struct Particle
+{
+    long                id;
+    double              x, y;
+    std::vector<int>    hits;
+};
+
+DIY_SERIALIZE(Particle, id, x, y, hits)
+
+TEST_CASE("columns", "[serialization]")
+{
+    std::vector<Particle> particles;
+    for (int i = 0; i < 5; ++i)
+        particles.push_back(Particle { 10 + i, 0.5 * i, -0.5 * i, std::vector<int>(i, i) });
+
+    for (int virtual_buffer = 0; virtual_buffer < 2; ++virtual_buffer)
+    {
+        diy::MemoryBuffer mb;
+        diy::BinaryBuffer& bb = mb;
+        if (virtual_buffer)
+            diy::save(bb, diy::columns(particles));
+        else
+            diy::save(mb, diy::columns(particles));
+        REQUIRE(diy::serialized_size(diy::columns(particles)) == mb.size());
+
+        // count, then each field as a column
+        size_t n;
+        long ids[5];
+        std::memcpy(&n, &mb.buffer[0], sizeof(size_t));
+        std::memcpy(ids, &mb.buffer[sizeof(size_t)], sizeof(ids));
+        REQUIRE(n == particles.size());
+        for (size_t i = 0; i < n; ++i)
+            REQUIRE(ids[i] == particles[i].id);
+
+        // back into records
+        std::vector<Particle> records { Particle { 1, 1., 1., {} } };
+        auto c = diy::columns(records);
+        mb.reset();
+        if (virtual_buffer)
+            diy::load(bb, c);
+        else
+            diy::load(mb, c);
+        REQUIRE(records.size() == particles.size());
+        for (size_t i = 0; i < n; ++i)
+        {
+            REQUIRE(records[i].id == particles[i].id);
+            REQUIRE(records[i].x == particles[i].x);
+            REQUIRE(records[i].y == particles[i].y);
+            REQUIRE(records[i].hits == particles[i].hits);
+        }
+
+        // straight into separate arrays
+        std::vector<long>               id;
+        std::vector<double>             x, y;
+        std::vector<std::vector<int>>   hits;
+        auto soa = diy::column_vectors(id, x, y, hits);
+        mb.reset();
+        if (virtual_buffer)
+            diy::load(bb, soa);
+        else
+            diy::load(mb, soa);
+        REQUIRE(id.size() == n);
+        REQUIRE(hits.size() == n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            REQUIRE(id[i] == particles[i].id);
+            REQUIRE(x[i] == particles[i].x);
+            REQUIRE(y[i] == particles[i].y);
+            REQUIRE(hits[i] == particles[i].hits);
+        }
+
+        // and out of them again, in the same format
+        diy::MemoryBuffer from_soa;
+        diy::save(from_soa, soa);
+        REQUIRE(from_soa.buffer == mb.buffer);
+        REQUIRE(diy::serialized_size(soa) == mb.size());
+    }
+
+    std::vector<long> shorter(2);
+    std::vector<double> longer(3);
+    diy::MemoryBuffer mb;
+    REQUIRE_THROWS(diy::save(mb, diy::column_vectors(shorter, longer)));
+}
+
+namespace
+{
+    struct CountingResource: public diy::MemoryResource
+    {
+        void*   allocate(size_t bytes) override             { ++allocations; allocated += bytes; return ::operator new(bytes); }
+        void    deallocate(void* p, size_t bytes) override  { allocated -= bytes; ::operator delete(p); }
+
+        int     allocations = 0;
+        size_t  allocated   = 0;
+    };
+}
+
+TEST_CASE("MemoryBuffer memory resources", "[serialization]")
+{
+    CountingResource resource;
+
+    SECTION("explicit resource")
+    {
+        diy::MemoryBuffer bb(0, &resource);
+        REQUIRE(bb.resource() == &resource);
+        diy::save(bb, std::vector<int>(1000, 7));
+        REQUIRE(resource.allocations > 0);
+        REQUIRE(resource.allocated >= bb.size());
+
+        // moves carry the resource along
+        diy::MemoryBuffer moved = std::move(bb);
+        REQUIRE(moved.resource() == &resource);
+        moved.reset();
+        std::vector<int> v;
+        diy::load(moved, v);
+        REQUIRE(v == std::vector<int>(1000, 7));
+
+        moved.wipe();
+        REQUIRE(moved.resource() == &resource);
+        REQUIRE(resource.allocated == 0);
+    }
+
+    SECTION("default resource")
+    {
+        diy::MemoryResource* previous = diy::set_default_memory_resource(&resource);
+        {
+            diy::MemoryBuffer bb;
+            diy::save(bb, std::string("routed"));
+            REQUIRE(resource.allocations > 0);
+        }
+        REQUIRE(resource.allocated == 0);
+        REQUIRE(diy::set_default_memory_resource(previous) == &resource);
+        REQUIRE(diy::MemoryBuffer().resource() == previous);
+    }
+
+    SECTION("huge pages")
+    {
+        diy::HugePageResource huge(1 << 16, &resource);
+        diy::MemoryBuffer bb(0, &huge);
+        diy::save(bb, 'c');                                 // small: from upstream
+        REQUIRE(resource.allocations == 1);
+        std::vector<double> large(1 << 16, 0.5);
+        diy::save(bb, large);
+        bb.reset();
+        char c;
+        std::vector<double> v;
+        diy::load(bb, c);
+        diy::load(bb, v);
+        REQUIRE(v == large);
+    }
+}
+
+TEST_CASE("MemoryBuffer fast path benchmark", "[.][serialization][benchmark]")
+{
+    std::map<int, Small> m;
+    for (int i = 0; i < 1000000; ++i)
+        m[i] = Small { i, static_cast<float>(i) };
+
+    auto time = [](const std::function<void()>& f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    diy::MemoryBuffer virtual_bb, direct_bb;
+    diy::BinaryBuffer& vb = virtual_bb;
+    std::map<int, Small> virtual_loaded, direct_loaded;
+
+    double virtual_save = time([&]() { diy::save(vb, m); });
+    double direct_save  = time([&]() { diy::save(direct_bb, m); });
+    virtual_bb.reset();
+    direct_bb.reset();
+    double virtual_load = time([&]() { diy::load(vb, virtual_loaded); });
+    double direct_load  = time([&]() { diy::load(direct_bb, direct_loaded); });
+
+    std::cout << "map<int, {int,float}> with " << m.size() << " elements:\n"
+              << "  save: virtual " << virtual_save << " s, direct " << direct_save << " s\n"
+              << "  load: virtual " << virtual_load << " s, direct " << direct_load << " s" << std::endl;
+
+    REQUIRE(virtual_loaded == m);
+    REQUIRE(direct_loaded == m);
+}
+
 TEST_CASE("LinkFactory loads built-in link types", "[serialization][link]")
 {
     SECTION("plain link")
@@ -287,3 +616,91 @@ TEST_CASE("LinkFactory loads built-in link types", "[serialization][link]")
         REQUIRE(dynamic_cast<diy::RegularLink<diy::Bounds<long>>*>(long_integer.get()) != 0);
     }
 }
+
+namespace
+{
+    // the compact encoding must restore exactly what the regular save() writes
+    void require_compact_round_trip(const diy::Link& link)
+    {
+        diy::MemoryBuffer compact;
+        diy::LinkFactory::save(compact, &link, true);
+        compact.reset();
+        std::unique_ptr<diy::Link> loaded(diy::LinkFactory::load(compact));
+
+        diy::MemoryBuffer expected, actual;
+        link.save(expected);
+        loaded->save(actual);
+        REQUIRE(loaded->id() == link.id());
+        REQUIRE(actual.buffer == expected.buffer);
+    }
+}
+
+TEST_CASE("compact links", "[serialization][link]")
+{
+    diy::Link plain;
+    for (int gid = 1000; gid < 1100; ++gid)
+        plain.add_neighbor(diy::BlockID(gid, gid / 10));
+    plain.add_neighbor(diy::BlockID(3, 0));
+    require_compact_round_trip(plain);
+    require_compact_round_trip(diy::Link());
+
+    diy::MemoryBuffer regular, compact;
+    diy::LinkFactory::save(regular, &plain, false);
+    diy::LinkFactory::save(compact, &plain, true);
+    REQUIRE(compact.size() < regular.size() / 3);
+
+    diy::DiscreteBounds core(3), bounds(3);
+    for (int i = 0; i < 3; ++i)
+    {
+        core.min[i] = 100 * i;      core.max[i] = 100 * i + 63;
+        bounds.min[i] = core.min[i] - 2; bounds.max[i] = core.max[i] + 2;
+    }
+    diy::RegularGridLink grid(3, core, bounds);
+    for (int dir = 0; dir < 6; ++dir)
+    {
+        diy::DiscreteBounds nbr = core;
+        nbr.min[dir / 2] += dir % 2 ? 64 : -64;
+        nbr.max[dir / 2] += dir % 2 ? 64 : -64;
+        grid.add_neighbor(diy::BlockID(dir + 7, dir % 3));
+        grid.add_direction(diy::Direction(3, 1 << dir));
+        grid.add_core(nbr);
+        grid.add_bounds(nbr);
+        grid.add_wrap(diy::Direction(3, 0));
+    }
+    require_compact_round_trip(grid);
+
+    diy::ContinuousBounds fcore(2), fbounds(2);
+    fcore.min[0] = 0.5f; fcore.max[0] = 1.5f; fcore.min[1] = -1.f; fcore.max[1] = 2.f;
+    fbounds = fcore;
+    diy::RegularContinuousLink continuous(2, fcore, fbounds);
+    continuous.add_neighbor(diy::BlockID(2, 1));
+    continuous.add_direction(diy::Direction(2, DIY_Y0));
+    continuous.add_core(fcore);
+    continuous.add_bounds(fbounds);
+    require_compact_round_trip(continuous);
+
+    diy::AMRLink amr(2, 1, 2, diy::DiscreteBounds(2), diy::DiscreteBounds(2));
+    amr.add_neighbor(diy::BlockID(3, 0));
+    amr.add_bounds(2, 4, diy::DiscreteBounds(2), diy::DiscreteBounds(2));
+    require_compact_round_trip(amr);
+
+    // the default used by io::write_blocks() and block migration
+    REQUIRE(!diy::LinkFactory::compact());
+    diy::LinkFactory::set_compact(true);
+    diy::MemoryBuffer by_default;
+    diy::LinkFactory::save(by_default, &plain);
+    diy::LinkFactory::set_compact(false);
+    REQUIRE(by_default.buffer == compact.buffer);
+
+    // varints themselves
+    std::vector<long long> values { 0, 1, -1, 63, -64, 64, 1ll << 40, -(1ll << 62), std::numeric_limits<long long>::max(), std::numeric_limits<long long>::min() };
+    for (bool delta : { false, true })
+    {
+        diy::MemoryBuffer bb;
+        diy::varint::save_sequence(bb, values, delta);
+        bb.reset();
+        std::vector<long long> loaded;
+        diy::varint::load_sequence(bb, loaded, delta);
+        REQUIRE(loaded == values);
+    }
+}
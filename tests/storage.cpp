@@ -0,0 +1,330 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <diy/serialization.hpp>
+#include <diy/storage.hpp>
+
+namespace
+{
+    struct BlobBlock
+    {
+        std::vector<int>        values;
+        std::vector<char>       blob;
+        std::string             name;
+    };
+
+    void save_blob_block(const void* b_, diy::BinaryBuffer& bb)
+    {
+        const BlobBlock* b = static_cast<const BlobBlock*>(b_);
+        diy::save(bb, b->values);
+        bb.save_binary_blob(b->blob.data(), b->blob.size());
+        diy::save(bb, b->name);
+    }
+
+    void load_blob_block(void* b_, diy::BinaryBuffer& bb)
+    {
+        BlobBlock* b = static_cast<BlobBlock*>(b_);
+        diy::load(bb, b->values);
+        diy::BinaryBlob blob = bb.load_binary_blob();
+        b->blob.assign(blob.pointer.get(), blob.pointer.get() + blob.size);
+        diy::load(bb, b->name);
+    }
+
+    BlobBlock make_block(size_t n)
+    {
+        BlobBlock b;
+        b.values.resize(n);
+        std::iota(b.values.begin(), b.values.end(), 0);
+        b.blob.resize(3*n + 1);
+        for (size_t i = 0; i < b.blob.size(); ++i)
+            b.blob[i] = static_cast<char>(i % 127);
+        b.name = "block-" + std::to_string(n);
+        return b;
+    }
+
+    void require_equal(const BlobBlock& a, const BlobBlock& b)
+    {
+        REQUIRE(a.values == b.values);
+        REQUIRE(a.blob == b.blob);
+        REQUIRE(a.name == b.name);
+    }
+}
+
+TEST_CASE("FileBuffer", "[storage]")
+{
+    std::string filename = "./DIY.storage-test.XXXXXX";
+    int fh = diy::io::utils::mkstemp(filename);
+    REQUIRE(fh != -1);
+
+    // small buffer size exercises both the buffered and the direct paths
+    for (size_t buffer_size : { size_t(16), diy::detail::FileBuffer::default_buffer_size() })
+    {
+        SECTION("save and load with blobs, buffer size " + std::to_string(buffer_size))
+        {
+            BlobBlock saved = make_block(100);
+            {
+                diy::detail::FileBuffer bb(filename, diy::detail::FileBuffer::Mode::write, buffer_size);
+                save_blob_block(&saved, bb);
+                int footer = 42;
+                bb.append_binary(reinterpret_cast<const char*>(&footer), sizeof(footer));
+                REQUIRE(bb.nblobs() == 1);
+            }
+
+            BlobBlock loaded;
+            diy::detail::FileBuffer bb(filename, diy::detail::FileBuffer::Mode::read, buffer_size);
+            REQUIRE(bb.nblobs() == 1);
+
+            int footer;
+            diy::load_back(bb, footer);
+            REQUIRE(footer == 42);
+
+            load_blob_block(&loaded, bb);
+            require_equal(loaded, saved);
+        }
+    }
+
+    SECTION("files without blobs hold exactly the saved bytes")
+    {
+        std::vector<double> values(1000, 1.5);
+        {
+            diy::detail::FileBuffer bb(filename, diy::detail::FileBuffer::Mode::write, 64);
+            diy::save(bb, values);
+        }
+
+        diy::MemoryBuffer mb;
+        mb.read(filename);
+        REQUIRE(mb.size() == sizeof(size_t) + values.size() * sizeof(double));
+
+        std::vector<double> loaded;
+        diy::load(mb, loaded);
+        REQUIRE(loaded == values);
+    }
+
+    SECTION("reading past the end throws")
+    {
+        {
+            diy::detail::FileBuffer bb(filename, diy::detail::FileBuffer::Mode::write);
+            diy::save(bb, 1);
+        }
+
+        diy::detail::FileBuffer bb(filename, diy::detail::FileBuffer::Mode::read);
+        int x;
+        diy::load(bb, x);
+        REQUIRE(x == 1);
+        REQUIRE_THROWS(diy::load(bb, x));
+        REQUIRE_THROWS(bb.load_binary_blob());
+    }
+
+    diy::io::utils::close(fh);
+    diy::io::utils::remove(filename);
+}
+
+TEST_CASE("FileStorage", "[storage]")
+{
+    diy::FileStorage storage("./DIY.storage-test.XXXXXX");
+
+    SECTION("blocks with blobs")
+    {
+        std::vector<BlobBlock> saved;
+        std::vector<int> records;
+        for (size_t n : { 0, 1, 1000, 1000000 })
+        {
+            saved.push_back(make_block(n));
+            records.push_back(storage.put(&saved.back(), &save_blob_block));
+        }
+        REQUIRE(storage.current_size() > 0);
+
+        for (size_t i = 0; i < saved.size(); ++i)
+        {
+            BlobBlock loaded;
+            storage.get(records[i], &loaded, &load_blob_block);
+            require_equal(loaded, saved[i]);
+        }
+        REQUIRE(storage.current_size() == 0);
+    }
+
+    SECTION("memory buffers")
+    {
+        diy::MemoryBuffer bb;
+        diy::save(bb, std::string("queue contents"));
+        size_t sz = bb.size();
+
+        int record = storage.put(bb);
+        REQUIRE(bb.size() == 0);
+
+        storage.get(record, bb, 0);
+        REQUIRE(bb.size() == sz);
+
+        std::string s;
+        diy::load(bb, s);
+        REQUIRE(s == "queue contents");
+    }
+}
+
+TEST_CASE("FileStorage striping", "[storage]")
+{
+    std::string dir = "./DIY.storage-test-dir";
+    diy::io::utils::make_directory(dir);
+
+    diy::FileStorage storage(std::vector<std::string> { "./DIY.storage-test.XXXXXX", dir + "/DIY.XXXXXX" });
+    storage.set_stripe_size(1 << 20);
+
+    // small records alternate between the directories
+    std::vector<int> records;
+    for (int i = 0; i < 4; ++i)
+    {
+        diy::MemoryBuffer bb;
+        diy::save(bb, i);
+        records.push_back(storage.put(bb));
+    }
+    for (auto& d : storage.device_stats())
+        REQUIRE(d.files >= 1);
+
+    // large records are split across both
+    std::vector<int> values(1 << 20);
+    std::iota(values.begin(), values.end(), 0);
+    diy::MemoryBuffer bb;
+    diy::save(bb, values);
+    int large = storage.put(bb);
+
+    auto stats = storage.device_stats();
+    REQUIRE(stats.size() == 2);
+    for (auto& d : stats)
+    {
+        REQUIRE(d.files >= 2);
+        REQUIRE(d.outstanding == 0);
+        REQUIRE(d.write_bandwidth() > 0);
+    }
+    REQUIRE(stats[0].files + stats[1].files == 6);
+    REQUIRE(stats[0].current_size + stats[1].current_size == storage.current_size());
+
+    storage.get(large, bb, 0);
+    std::vector<int> loaded;
+    diy::load(bb, loaded);
+    REQUIRE(loaded == values);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        diy::MemoryBuffer small;
+        storage.get(records[i], small, 0);
+        int x;
+        diy::load(small, x);
+        REQUIRE(x == i);
+    }
+
+    REQUIRE(storage.current_size() == 0);
+    for (auto& d : storage.device_stats())
+    {
+        REQUIRE(d.current_size == 0);
+        REQUIRE(d.read_bandwidth() > 0);
+    }
+
+    diy::io::utils::remove(dir);
+}
+
+TEST_CASE("codecs", "[storage][compression]")
+{
+    std::vector<float> field(100000);
+    for (size_t i = 0; i < field.size(); ++i)
+        field[i] = 100.f + static_cast<float>(i % 1000) * 0.25f;
+
+    std::vector<char> noise(10000);
+    unsigned x = 12345;
+    for (char& c : noise)
+    {
+        x = x * 1103515245u + 12345u;
+        c = static_cast<char>(x >> 16);
+    }
+
+    const char* data  = reinterpret_cast<const char*>(field.data());
+    size_t      count = field.size() * sizeof(float);
+
+    std::vector<std::shared_ptr<diy::Codec>> codecs { std::make_shared<diy::LZCodec>(),
+                                                      std::make_shared<diy::ShuffleCodec>(sizeof(float)),
+                                                      std::make_shared<diy::ShuffleCodec>(3, false),
+                                                      diy::default_codec() };
+    for (auto& codec : codecs)
+    {
+        SECTION("round trip with " + codec->name())
+        {
+            std::vector<char> compressed;
+            codec->compress(data, count, compressed);
+            REQUIRE(compressed.size() < count / 3);
+
+            std::vector<float> restored(field.size());
+            codec->decompress(compressed.data(), compressed.size(), reinterpret_cast<char*>(restored.data()), count);
+            REQUIRE(restored == field);
+
+            compressed.clear();
+            codec->compress(noise.data(), noise.size(), compressed);
+            std::vector<char> restored_noise(noise.size());
+            codec->decompress(compressed.data(), compressed.size(), restored_noise.data(), noise.size());
+            REQUIRE(restored_noise == noise);
+
+            compressed.clear();
+            codec->compress(noise.data(), 0, compressed);
+            codec->decompress(compressed.data(), compressed.size(), restored_noise.data(), 0);
+        }
+    }
+
+    REQUIRE_THROWS_AS(diy::ShuffleCodec(0), std::invalid_argument);
+}
+
+TEST_CASE("CompressedStorage", "[storage][compression]")
+{
+    diy::FileStorage        files("./DIY.storage-test.XXXXXX");
+    diy::CompressedStorage  storage(1000, &files, std::make_shared<diy::ShuffleCodec>(sizeof(int)));
+
+    std::vector<BlobBlock> saved;
+    std::vector<int> records;
+    for (size_t n : { 0, 1, 1000, 1000000, 1000000 })
+    {
+        saved.push_back(make_block(n));
+        records.push_back(storage.put(&saved.back(), &save_blob_block));
+    }
+
+    // the large blocks don't fit under the limit
+    REQUIRE(storage.current_size() <= 1000);
+    REQUIRE(storage.stats().spilled_records > 0);
+    REQUIRE(files.count() == static_cast<int>(storage.stats().spilled_records));
+    REQUIRE(storage.stats().ratio() > 3);
+
+    diy::MemoryBuffer bb;
+    diy::save(bb, saved[2].values);
+    int queue = storage.put(bb);
+    REQUIRE(bb.size() == 0);
+
+    // records written in pieces
+    std::unique_ptr<diy::ExternalStorage::Writer> writer = storage.writer(2 * sizeof(int));
+    for (int x : { 7, 8 })
+        writer->write(reinterpret_cast<const char*>(&x), sizeof(x));
+    int pieces = writer->close();
+
+    for (size_t i = 0; i < saved.size(); ++i)
+    {
+        BlobBlock loaded;
+        storage.get(records[i], &loaded, &load_blob_block);
+        require_equal(loaded, saved[i]);
+    }
+
+    storage.get(queue, bb, 0);
+    std::vector<int> values;
+    diy::load(bb, values);
+    REQUIRE(values == saved[2].values);
+
+    diy::MemoryBuffer pb;
+    storage.get(pieces, pb, 0);
+    int x, y;
+    diy::load(pb, x);
+    diy::load(pb, y);
+    REQUIRE((x == 7 && y == 8));
+
+    REQUIRE(storage.current_size() == 0);
+    REQUIRE(files.current_size() == 0);
+    REQUIRE(storage.stats().decompress_throughput() > 0);
+}
@@ -0,0 +1,155 @@
+#include <numeric>
+#include <vector>
+
+#include <diy/mpi.hpp>
+#include <diy/master.hpp>
+#include <diy/assigner.hpp>
+#include <diy/serialization.hpp>
+#include <diy/storage.hpp>
+
+#include "opts.h"
+
+#define CATCH_CONFIG_RUNNER
+#include "catch.hpp"
+
+struct Block
+{
+    std::vector<int>    values;
+    int                 received = 0;
+};
+
+void* create_block()                      { return new Block; }
+void  destroy_block(void* b)              { delete static_cast<Block*>(b); }
+void  save_block(const void* b,
+                 diy::BinaryBuffer& bb)   { diy::save(bb, static_cast<const Block*>(b)->values); diy::save(bb, static_cast<const Block*>(b)->received); }
+void  load_block(void* b,
+                 diy::BinaryBuffer& bb)   { diy::load(bb, static_cast<Block*>(b)->values); diy::load(bb, static_cast<Block*>(b)->received); }
+
+// blobs are not copied when enqueued, so their contents must outlive the exchange
+std::vector<char> blob(1000, 'x');
+
+// counts the records that arrive in pieces
+struct CountingStorage: public diy::FileStorage
+{
+                    CountingStorage(): diy::FileStorage("./DIY.XXXXXX")     {}
+
+    std::unique_ptr<Writer>
+                    writer(size_t size) override                            { ++streamed; return diy::FileStorage::writer(size); }
+
+    int             streamed = 0;
+};
+
+struct StreamingFixture
+{
+    static int          nblocks;
+    static int          values;
+
+    diy::mpi::communicator    world;
+};
+
+int         StreamingFixture::nblocks     = 0;
+int         StreamingFixture::values      = 10000;
+
+TEST_CASE_METHOD(StreamingFixture, "Streaming incoming queues to storage", "[streaming]")
+{
+    CountingStorage           storage;
+
+    // keep one block in memory and unload all the queues, so that incoming multi-part
+    // messages for the blocks out of core go straight to storage
+    diy::Master               master(world,
+                                     1,
+                                     1,
+                                     &create_block,
+                                     &destroy_block,
+                                     &storage,
+                                     &save_block,
+                                     &load_block,
+                                     new diy::Master::QueueSizePolicy(0));
+    master.set_message_chunk_size(1000);
+    REQUIRE(master.message_chunk_size() == 1000);
+
+    int nblocks_ = nblocks > 0 ? nblocks : 2 * world.size();
+    diy::RoundRobinAssigner   assigner(world.size(), nblocks_);
+
+    std::vector<int> gids;
+    assigner.local_gids(world.rank(), gids);
+    for (int gid : gids)
+    {
+        diy::Link*   link = new diy::Link;
+        diy::BlockID neighbor;
+        neighbor.gid  = (gid + 1) % nblocks_;
+        neighbor.proc = assigner.rank(neighbor.gid);
+        link->add_neighbor(neighbor);
+
+        Block* b = new Block;
+        b->values.resize(values);
+        std::iota(b->values.begin(), b->values.end(), gid);
+        master.add(gid, b, link);
+    }
+
+    master.foreach([](Block* b, const diy::Master::ProxyWithLink& cp)
+    {
+        cp.enqueue(cp.link()->target(0), b->values);
+        cp.enqueue_blob(cp.link()->target(0), blob.data(), blob.size());
+    });
+    master.exchange();
+
+    master.foreach([](Block* b, const diy::Master::ProxyWithLink& cp)
+    {
+        for (auto& x : *cp.incoming())
+        {
+            int from = x.first;
+            if (!cp.incoming(from).size())
+                continue;
+
+            std::vector<int> in;
+            cp.dequeue(from, in);
+            std::vector<int> expected(in.size());
+            std::iota(expected.begin(), expected.end(), from);
+            CHECK(in.size() == b->values.size());
+            CHECK(in == expected);
+
+            diy::BinaryBlob in_blob = cp.dequeue_blob(from);
+            CHECK(std::vector<char>(in_blob.pointer.get(), in_blob.pointer.get() + in_blob.size) == blob);
+
+            b->received++;
+        }
+    });
+
+    master.foreach([](Block* b, const diy::Master::ProxyWithLink&) { CHECK(b->received == 1); });
+
+    // messages between different ranks for the blocks out of core were streamed
+    if (world.size() > 1 && gids.size() > 1)
+        CHECK(storage.streamed > 0);
+}
+
+int main(int argc, char* argv[])
+{
+    diy::mpi::environment     env(argc, argv);
+    diy::mpi::communicator    world;
+
+    Catch::Session session;
+
+    bool help;
+
+    using namespace opts;
+    Options ops;
+    ops
+        >> Option('b', "blocks",  StreamingFixture::nblocks,        "number of blocks (default: 2 per process)")
+        >> Option('n', "values",  StreamingFixture::values,         "number of values each block sends")
+        >> Option('h', "help",    help,                             "show help")
+        ;
+
+    if (!ops.parse(argc,argv) || help)
+    {
+        if (world.rank() == 0)
+        {
+            std::cout << "Usage: " << argv[0] << " [OPTIONS]\n";
+            std::cout << "Streams large incoming messages to external storage.\n";
+            std::cout << ops;
+        }
+        return 1;
+    }
+
+    return session.run();
+}